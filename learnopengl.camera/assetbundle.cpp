@@ -0,0 +1,358 @@
+#include "assetbundle.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// positions remembered per hash of four bytes while compressing
+const GLuint LZ4_HASH_BITS = 16;
+// shortest match the format can code, and how far back one can reach
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_MAX_OFFSET = 65535;
+// the format wants a block's last 5 bytes as literals, and its last match to start 12 bytes from the end
+const size_t LZ4_LAST_LITERALS = 5;
+const size_t LZ4_MATCH_LIMIT = 12;
+
+AssetBundle assetBundle;
+
+static GLuint64 AlignUp(GLuint64 offset)
+{
+	return (offset + ASSET_BUNDLE_ALIGNMENT - 1) / ASSET_BUNDLE_ALIGNMENT * ASSET_BUNDLE_ALIGNMENT;
+}
+
+// orders entries as the table is sorted
+static int CompareEntry(const char* name, GLuint type, const AssetBundleEntry& entry)
+{
+	int order = std::strncmp(name, entry.Name, ASSET_NAME_LENGTH);
+	if (order != 0) {
+		return order;
+	}
+	return type < entry.Type ? -1 : (type > entry.Type ? 1 : 0);
+}
+
+std::string GetAssetName(const char* path)
+{
+	return std::strncmp(path, "./", 2) == 0 ? std::string(path + 2) : std::string(path);
+}
+
+AssetBundle::AssetBundle()
+	: Entries(nullptr), EntryCount(0)
+{
+}
+
+bool AssetBundle::Open(const char* path)
+{
+	this->Close();
+	if (!this->File.Open(path)) {
+		return false;
+	}
+
+	const unsigned char* data = this->File.GetData();
+	size_t size = this->File.GetSize();
+	AssetBundleHeader header;
+	if (size < sizeof(header)) {
+		std::cout << "ERROR::ASSET_BUNDLE::TRUNCATED\n" << path << std::endl;
+		this->Close();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.Magic != ASSET_BUNDLE_MAGIC || header.Version != ASSET_BUNDLE_VERSION || header.Alignment != ASSET_BUNDLE_ALIGNMENT) {
+		std::cout << "ERROR::ASSET_BUNDLE::BAD_HEADER\n" << path << std::endl;
+		this->Close();
+		return false;
+	}
+	if (sizeof(header) + (size_t)header.EntryCount * sizeof(AssetBundleEntry) > size) {
+		std::cout << "ERROR::ASSET_BUNDLE::TRUNCATED\n" << path << std::endl;
+		this->Close();
+		return false;
+	}
+
+	// the table is used where it's mapped; it follows the 16 byte header, so its 8 byte fields are aligned
+	const AssetBundleEntry* entries = (const AssetBundleEntry*)(data + sizeof(header));
+	for (GLuint i = 0; i < header.EntryCount; i++) {
+		const AssetBundleEntry& entry = entries[i];
+		if (entry.Name[ASSET_NAME_LENGTH - 1] != '\0' || entry.Type >= ASSET_TYPE_COUNT || entry.Codec > ASSET_CODEC_LZ4 ||
+			entry.Offset % ASSET_BUNDLE_ALIGNMENT != 0 || entry.Offset > size || entry.Bytes > size - entry.Offset ||
+			(entry.Codec == ASSET_CODEC_RAW && entry.Bytes != entry.UnpackedBytes)) {
+			std::cout << "ERROR::ASSET_BUNDLE::BAD_ENTRY\n" << path << " entry " << i << std::endl;
+			this->Close();
+			return false;
+		}
+	}
+	this->Entries = entries;
+	this->EntryCount = header.EntryCount;
+	return true;
+}
+
+void AssetBundle::Close()
+{
+	this->File.Close();
+	this->Entries = nullptr;
+	this->EntryCount = 0;
+}
+
+bool AssetBundle::IsOpen()
+{
+	return this->Entries != nullptr;
+}
+
+const AssetBundleEntry* AssetBundle::Find(const char* path, AssetType type)
+{
+	if (this->Entries == nullptr) {
+		return nullptr;
+	}
+
+	// the cooker sorted the table, so it's searched as it lies
+	std::string name = GetAssetName(path);
+	GLuint low = 0;
+	GLuint high = this->EntryCount;
+	while (low < high) {
+		GLuint middle = low + (high - low) / 2;
+		int order = CompareEntry(name.c_str(), type, this->Entries[middle]);
+		if (order == 0) {
+			return &this->Entries[middle];
+		}
+		if (order < 0) {
+			high = middle;
+		}
+		else {
+			low = middle + 1;
+		}
+	}
+	return nullptr;
+}
+
+const unsigned char* AssetBundle::GetData(const AssetBundleEntry& entry, std::vector<unsigned char>& unpacked)
+{
+	const unsigned char* stored = this->File.GetData() + entry.Offset;
+	if (entry.Codec == ASSET_CODEC_RAW) {
+		return stored;
+	}
+
+	unpacked.resize((size_t)entry.UnpackedBytes);
+	if (!DecompressLZ4(stored, (size_t)entry.Bytes, unpacked.data(), unpacked.size())) {
+		std::cout << "ERROR::ASSET_BUNDLE::BAD_LZ4_BLOCK\n" << entry.Name << std::endl;
+		unpacked.clear();
+		return nullptr;
+	}
+	return unpacked.data();
+}
+
+GLuint AssetBundle::GetEntryCount()
+{
+	return this->EntryCount;
+}
+
+bool WriteAssetBundle(const char* path, std::vector<CookedAsset>& assets, bool compress, AssetBundleStats* stats)
+{
+	std::sort(assets.begin(), assets.end(), [](const CookedAsset& a, const CookedAsset& b) {
+		return a.Name != b.Name ? a.Name < b.Name : a.Type < b.Type;
+	});
+
+	AssetBundleHeader header;
+	header.Magic = ASSET_BUNDLE_MAGIC;
+	header.Version = ASSET_BUNDLE_VERSION;
+	header.EntryCount = (GLuint)assets.size();
+	header.Alignment = ASSET_BUNDLE_ALIGNMENT;
+
+	std::memset(stats, 0, sizeof(*stats));
+	std::vector<AssetBundleEntry> entries(assets.size());
+	std::vector<std::vector<unsigned char>> packed(assets.size());
+	GLuint64 offset = AlignUp(sizeof(header) + entries.size() * sizeof(AssetBundleEntry));
+	for (size_t i = 0; i < assets.size(); i++) {
+		const CookedAsset& asset = assets[i];
+		if (asset.Name.size() >= ASSET_NAME_LENGTH) {
+			std::cout << "ERROR::ASSET_BUNDLE::NAME_TOO_LONG\n" << asset.Name << std::endl;
+			return false;
+		}
+		if (i > 0 && asset.Name == assets[i - 1].Name && asset.Type == assets[i - 1].Type) {
+			std::cout << "ERROR::ASSET_BUNDLE::DUPLICATE_ENTRY\n" << asset.Name << std::endl;
+			return false;
+		}
+
+		AssetBundleEntry& entry = entries[i];
+		std::memset(&entry, 0, sizeof(entry));
+		std::memcpy(entry.Name, asset.Name.c_str(), asset.Name.size());
+		entry.Type = asset.Type;
+		entry.Codec = ASSET_CODEC_RAW;
+		entry.Flags = asset.Flags;
+		entry.Offset = offset;
+		entry.Bytes = asset.Data.size();
+		entry.UnpackedBytes = asset.Data.size();
+		entry.Key = asset.Key;
+		if (compress && !asset.Data.empty()) {
+			packed[i] = CompressLZ4(asset.Data.data(), asset.Data.size());
+			if (packed[i].size() <= asset.Data.size() * (1.0f - ASSET_LZ4_MIN_SAVING)) {
+				entry.Codec = ASSET_CODEC_LZ4;
+				entry.Bytes = packed[i].size();
+				stats->PackedEntries++;
+			}
+			else {
+				packed[i].clear();
+			}
+		}
+		stats->UnpackedBytes += entry.UnpackedBytes;
+		stats->StoredBytes += entry.Bytes;
+		offset = AlignUp(offset + entry.Bytes);
+	}
+	stats->FileBytes = offset;
+
+	// written under another name and renamed, so a reader never maps a half written bundle
+	std::string partialPath = std::string(path) + ".partial";
+	{
+		std::ofstream file(partialPath.c_str(), std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(AssetBundleEntry)));
+		std::vector<char> padding(ASSET_BUNDLE_ALIGNMENT, 0);
+		GLuint64 written = sizeof(header) + entries.size() * sizeof(AssetBundleEntry);
+		for (size_t i = 0; i < assets.size(); i++) {
+			file.write(padding.data(), (std::streamsize)(entries[i].Offset - written));
+			const std::vector<unsigned char>& data = entries[i].Codec == ASSET_CODEC_LZ4 ? packed[i] : assets[i].Data;
+			file.write((const char*)data.data(), (std::streamsize)data.size());
+			written = entries[i].Offset + data.size();
+		}
+		// the last entry is padded out too, so its final page is whole
+		file.write(padding.data(), (std::streamsize)(offset - written));
+		if (!file) {
+			std::cout << "ERROR::ASSET_BUNDLE::NOT_WRITTEN\n" << path << std::endl;
+			return false;
+		}
+	}
+	std::remove(path);
+	if (std::rename(partialPath.c_str(), path) != 0) {
+		std::cout << "ERROR::ASSET_BUNDLE::NOT_WRITTEN\n" << path << std::endl;
+		std::remove(partialPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static GLuint ReadWord(const unsigned char* data)
+{
+	GLuint word;
+	std::memcpy(&word, data, sizeof(word));
+	return word;
+}
+
+// lengths past a token's 15 go on as bytes of 255, ended by one below
+static void WriteLength(std::vector<unsigned char>& out, size_t length)
+{
+	for (; length >= 255; length -= 255) {
+		out.push_back(255);
+	}
+	out.push_back((unsigned char)length);
+}
+
+static void WriteSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength - LZ4_MIN_MATCH;
+	out.push_back((unsigned char)((std::min(literalCount, (size_t)15) << 4) | (matchLength != 0 ? std::min(matchCode, (size_t)15) : 0)));
+	if (literalCount >= 15) {
+		WriteLength(out, literalCount - 15);
+	}
+	out.insert(out.end(), literals, literals + literalCount);
+	if (matchLength == 0) {
+		// the last sequence is literals only
+		return;
+	}
+	out.push_back((unsigned char)(offset & 0xFF));
+	out.push_back((unsigned char)(offset >> 8));
+	if (matchCode >= 15) {
+		WriteLength(out, matchCode - 15);
+	}
+}
+
+std::vector<unsigned char> CompressLZ4(const unsigned char* data, size_t size)
+{
+	std::vector<unsigned char> out;
+	out.reserve(size / 2 + 16);
+	// each slot holds a position plus one, so 0 is empty
+	std::vector<GLuint> table((size_t)1 << LZ4_HASH_BITS, 0);
+	size_t anchor = 0;
+	size_t position = 0;
+	size_t limit = size > LZ4_MATCH_LIMIT ? size - LZ4_MATCH_LIMIT : 0;
+	while (position < limit) {
+		GLuint word = ReadWord(data + position);
+		GLuint hash = (word * 2654435761u) >> (32 - LZ4_HASH_BITS);
+		size_t candidate = table[hash];
+		table[hash] = (GLuint)(position + 1);
+		if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET || ReadWord(data + candidate - 1) != word) {
+			position++;
+			continue;
+		}
+		candidate--;
+
+		size_t length = LZ4_MIN_MATCH;
+		while (position + length < size - LZ4_LAST_LITERALS && data[candidate + length] == data[position + length]) {
+			length++;
+		}
+		WriteSequence(out, data + anchor, position - anchor, position - candidate, length);
+		position += length;
+		anchor = position;
+	}
+	WriteSequence(out, data + anchor, size - anchor, 0, 0);
+	return out;
+}
+
+static bool ReadLength(const unsigned char* data, size_t size, size_t& in, size_t& length)
+{
+	unsigned char byte;
+	do {
+		if (in == size) {
+			return false;
+		}
+		byte = data[in++];
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool DecompressLZ4(const unsigned char* data, size_t size, unsigned char* out, size_t outSize)
+{
+	size_t in = 0;
+	size_t written = 0;
+	while (in < size) {
+		unsigned char token = data[in++];
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLength(data, size, in, literalCount)) {
+			return false;
+		}
+		if (literalCount > size - in || literalCount > outSize - written) {
+			return false;
+		}
+		std::memcpy(out + written, data + in, literalCount);
+		in += literalCount;
+		written += literalCount;
+		if (in == size) {
+			break;
+		}
+
+		if (size - in < 2) {
+			return false;
+		}
+		size_t offset = data[in] | ((size_t)data[in + 1] << 8);
+		in += 2;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(data, size, in, matchLength)) {
+			return false;
+		}
+		matchLength += LZ4_MIN_MATCH;
+		if (offset == 0 || offset > written || matchLength > outSize - written) {
+			return false;
+		}
+		// a match may run into bytes it's copying itself, which repeats them
+		const unsigned char* match = out + written - offset;
+		if (offset >= matchLength) {
+			std::memcpy(out + written, match, matchLength);
+		}
+		else {
+			for (size_t i = 0; i < matchLength; i++) {
+				out[written + i] = match[i];
+			}
+		}
+		written += matchLength;
+	}
+	return written == outSize;
+}
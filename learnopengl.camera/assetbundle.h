@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mappedfile.h"
+
+// "LBDL", little-endian
+const GLuint ASSET_BUNDLE_MAGIC = 0x4C44424C;
+const GLuint ASSET_BUNDLE_VERSION = 1;
+// entries start on a page boundary, so each one's pages are its own and a raw one is used right where it's mapped
+const GLuint ASSET_BUNDLE_ALIGNMENT = 4096;
+// longest name an entry can have, terminator included
+const GLuint ASSET_NAME_LENGTH = 64;
+// written by assetcook; the samples look in it before the loose files
+const char* const ASSET_BUNDLE_PATH = "./assets.bundle";
+// an entry stored packed has to be this much smaller for the unpacking to be worth it
+const GLfloat ASSET_LZ4_MIN_SAVING = 0.125f;
+
+// what an entry holds; each is the format the loose file would have, so the same parsers read both
+enum AssetType {
+	// an RGBA8 mip chain as the mip cache has it, in upload layout
+	ASSET_MIP_CHAIN,
+	// a block-compressed texture file, as texconvert writes it
+	ASSET_TEXTURE_FILE,
+	// a mesh file, as meshconvert writes it
+	ASSET_MESH_FILE,
+	// shader source
+	ASSET_SHADER_SOURCE,
+	ASSET_TYPE_COUNT
+};
+const char* const ASSET_TYPE_NAMES[] = { "mip chain", "texture file", "mesh file", "shader source" };
+
+enum AssetCodec {
+	ASSET_CODEC_RAW = 0,
+	// an LZ4 block, unpacked on the way out
+	ASSET_CODEC_LZ4 = 1
+};
+
+// mip chains were filtered as color
+const GLuint ASSET_FLAG_SRGB = 1;
+
+// the file starts with this, followed by EntryCount AssetBundleEntries sorted by name, then type
+struct AssetBundleHeader
+{
+	GLuint Magic;
+	GLuint Version;
+	GLuint EntryCount;
+	GLuint Alignment;
+};
+
+struct AssetBundleEntry
+{
+	// the path it was cooked from, without a leading ./
+	char Name[ASSET_NAME_LENGTH];
+	GLuint Type;
+	GLuint Codec;
+	GLuint Flags;
+	GLuint Reserved;
+	// where the stored bytes are, how many, and how many they unpack to
+	GLuint64 Offset;
+	GLuint64 Bytes;
+	GLuint64 UnpackedBytes;
+	// mip chains: the hash of the image and settings the chain came from, as the mip cache keys it
+	GLuint64 Key;
+};
+
+static_assert(sizeof(AssetBundleHeader) == 16, "AssetBundleHeader must have no padding");
+static_assert(sizeof(AssetBundleEntry) == 112, "AssetBundleEntry must have no padding");
+
+// a bundle mapped into memory. the table of contents is searched where it's mapped, and raw entries are handed out
+// straight from the mapping; nothing is read until it's touched
+class AssetBundle
+{
+public:
+	AssetBundle();
+
+	AssetBundle(const AssetBundle&) = delete;
+	AssetBundle& operator=(const AssetBundle&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen();
+
+	// the entry of type cooked from path, or nullptr. safe from any thread once Open has returned
+	const AssetBundleEntry* Find(const char* path, AssetType type);
+	// the entry's UnpackedBytes: straight from the mapping if it's stored raw, otherwise unpacked into unpacked
+	const unsigned char* GetData(const AssetBundleEntry& entry, std::vector<unsigned char>& unpacked);
+	GLuint GetEntryCount();
+
+private:
+	MappedFile File;
+	const AssetBundleEntry* Entries;
+	GLuint EntryCount;
+};
+
+// the bundle every loader looks in first; closed unless something opened it
+extern AssetBundle assetBundle;
+
+// path as entries are named: without a leading ./
+std::string GetAssetName(const char* path);
+
+// one asset ready to go into a bundle
+struct CookedAsset
+{
+	std::string Name;
+	AssetType Type;
+	GLuint Flags;
+	GLuint64 Key;
+	std::vector<unsigned char> Data;
+};
+
+// what writing a bundle took, for reporting
+struct AssetBundleStats
+{
+	GLuint PackedEntries;
+	// every entry's bytes as they are, as stored, and the file's size with the table and padding
+	GLuint64 UnpackedBytes;
+	GLuint64 StoredBytes;
+	GLuint64 FileBytes;
+};
+
+// writes assets as a bundle; with compress, each is stored as LZ4 if that saves at least ASSET_LZ4_MIN_SAVING of it
+bool WriteAssetBundle(const char* path, std::vector<CookedAsset>& assets, bool compress, AssetBundleStats* stats);
+
+// the LZ4 block format: greedy matching through a hash of the next four bytes
+std::vector<unsigned char> CompressLZ4(const unsigned char* data, size_t size);
+// false if data isn't an LZ4 block that unpacks to exactly outSize bytes
+bool DecompressLZ4(const unsigned char* data, size_t size, unsigned char* out, size_t outSize);
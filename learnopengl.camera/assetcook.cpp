@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <SOIL.h>
+
+#include "assetbundle.h"
+#include "meshfile.h"
+#include "mipchain.h"
+#include "pixelconvert.h"
+#include "texturefile.h"
+
+static bool HasExtension(const std::string& path, const char* extension)
+{
+	size_t length = std::strlen(extension);
+	return path.size() > length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+static bool ReadWhole(const char* path, std::vector<unsigned char>& data)
+{
+	MappedFile file;
+	if (!file.Open(path)) {
+		std::cout << "ERROR::ASSETCOOK::NOT_READ\n" << path << std::endl;
+		return false;
+	}
+	data.assign(file.GetData(), file.GetData() + file.GetSize());
+	return true;
+}
+
+// decodes the image into upload layout, resized to size square unless size is 0, and filters its chain as the
+// texture loader would; the key is the one the loader's mip cache would give it
+static bool CookImage(const char* path, GLuint size, bool srgb, CookedAsset& asset)
+{
+	MappedFile source;
+	if (!source.Open(path)) {
+		std::cout << "ERROR::ASSETCOOK::NOT_READ\n" << path << std::endl;
+		return false;
+	}
+	int width, height, channels;
+	unsigned char* pixels = SOIL_load_image_from_memory(source.GetData(), (int)source.GetSize(), &width, &height, &channels, SOIL_LOAD_AUTO);
+	if (pixels != nullptr && channels < 3) {
+		SOIL_free_image_data(pixels);
+		pixels = SOIL_load_image_from_memory(source.GetData(), (int)source.GetSize(), &width, &height, &channels, SOIL_LOAD_RGBA);
+		channels = 4;
+	}
+	if (pixels == nullptr) {
+		std::cout << "ERROR::ASSETCOOK::LOAD_FAILED\n" << path << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> image((size_t)width * height * 4);
+	ConvertToUploadLayout(pixels, width, height, channels, image.data());
+	SOIL_free_image_data(pixels);
+
+	MipChain mips;
+	if (size != 0 && (width != (int)size || height != (int)size)) {
+		std::vector<unsigned char> resized((size_t)size * size * 4);
+		ResizeImage(image.data(), width, height, size, size, MIP_FILTER_KAISER, srgb, resized.data());
+		mips.Generate(resized.data(), size, size, MIP_FILTER_KAISER, srgb);
+	}
+	else {
+		mips.Generate(image.data(), width, height, MIP_FILTER_KAISER, srgb);
+	}
+
+	asset.Type = ASSET_MIP_CHAIN;
+	asset.Flags = srgb ? ASSET_FLAG_SRGB : 0;
+	asset.Key = HashMipSource(source.GetData(), source.GetSize(), MIP_FILTER_KAISER, srgb, size, size);
+	std::ostringstream chain;
+	mips.Write(chain, asset.Key);
+	std::string bytes = chain.str();
+	asset.Data.assign(bytes.begin(), bytes.end());
+	return true;
+}
+
+// drops comments but keeps every newline, so line numbers in the cooked source match the file's
+static std::string StripComments(const std::string& code)
+{
+	std::string stripped;
+	stripped.reserve(code.size());
+	size_t i = 0;
+	while (i < code.size()) {
+		if (code.compare(i, 2, "//") == 0) {
+			i = code.find('\n', i);
+			i = i == std::string::npos ? code.size() : i;
+		}
+		else if (code.compare(i, 2, "/*") == 0) {
+			size_t end = code.find("*/", i + 2);
+			end = end == std::string::npos ? code.size() : end + 2;
+			stripped.append((size_t)std::count(code.begin() + i, code.begin() + end, '\n'), '\n');
+			// a comment separates tokens either side of it
+			stripped += ' ';
+			i = end;
+		}
+		else {
+			stripped += code[i++];
+		}
+	}
+
+	// and the whitespace the comments leave at the ends of lines
+	std::string trimmed;
+	trimmed.reserve(stripped.size());
+	for (char c : stripped) {
+		if (c == '\n') {
+			while (!trimmed.empty() && (trimmed.back() == ' ' || trimmed.back() == '\t' || trimmed.back() == '\r')) {
+				trimmed.pop_back();
+			}
+		}
+		trimmed += c;
+	}
+	return trimmed;
+}
+
+// cooks the samples' assets into one bundle they map at startup, in place of the loose files
+int main(int argc, char** argv)
+{
+	bool compress = false;
+	bool srgb = true;
+	GLuint size = 0;
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (std::strcmp(argv[arg], "-z") == 0) {
+			compress = true;
+		}
+		else if (std::strcmp(argv[arg], "-l") == 0) {
+			srgb = false;
+		}
+		else if (std::strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+			size = (GLuint)std::strtoul(argv[++arg], nullptr, 10);
+		}
+		else {
+			break;
+		}
+		arg++;
+	}
+
+	if (argc - arg < 2) {
+		std::cout << "usage: assetcook [-z] [-s size] [-l] output.bundle input...\n"
+			"  images (.png .jpg .tga .bmp) go in as RGBA8 mip chains, texture files (.ctex) and mesh files (.mesh) as they\n"
+			"  are, shaders (.vert .frag .glsl) with their comments stripped\n"
+			"  -z  store each entry as LZ4 where that saves enough to be worth unpacking\n"
+			"  -s  resize images to size square first, as texture arrays of that size do\n"
+			"  -l  images hold data rather than color, so their mips are filtered as they are" << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	const char* bundlePath = argv[arg++];
+	std::vector<CookedAsset> assets;
+	for (; arg < argc; arg++) {
+		std::string path = argv[arg];
+		CookedAsset asset;
+		asset.Name = GetAssetName(path.c_str());
+		asset.Flags = 0;
+		asset.Key = 0;
+		if (HasExtension(path, ".png") || HasExtension(path, ".jpg") || HasExtension(path, ".jpeg") || HasExtension(path, ".tga") ||
+			HasExtension(path, ".bmp")) {
+			if (!CookImage(path.c_str(), size, srgb, asset)) {
+				return 1;
+			}
+		}
+		else if (HasExtension(path, ".ctex")) {
+			// checked before it's trusted to the bundle, which the runtime doesn't check again
+			TextureFile file;
+			if (!file.Load(path.c_str()) || !ReadWhole(path.c_str(), asset.Data)) {
+				return 1;
+			}
+			asset.Type = ASSET_TEXTURE_FILE;
+		}
+		else if (HasExtension(path, ".mesh")) {
+			MeshFile file;
+			if (!file.Load(path.c_str()) || !ReadWhole(path.c_str(), asset.Data)) {
+				return 1;
+			}
+			asset.Type = ASSET_MESH_FILE;
+		}
+		else if (HasExtension(path, ".vert") || HasExtension(path, ".frag") || HasExtension(path, ".glsl")) {
+			std::vector<unsigned char> source;
+			if (!ReadWhole(path.c_str(), source)) {
+				return 1;
+			}
+			std::string code = StripComments(std::string(source.begin(), source.end()));
+			asset.Data.assign(code.begin(), code.end());
+			asset.Type = ASSET_SHADER_SOURCE;
+		}
+		else {
+			std::cout << "ERROR::ASSETCOOK::UNKNOWN_TYPE\n" << path << std::endl;
+			return 1;
+		}
+		std::cout << "INFO: " << asset.Name << ": " << ASSET_TYPE_NAMES[asset.Type] << ", " << asset.Data.size() / 1024.0 << " KB" << std::endl;
+		assets.push_back(std::move(asset));
+	}
+
+	AssetBundleStats stats;
+	if (!WriteAssetBundle(bundlePath, assets, compress, &stats)) {
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "INFO: " << bundlePath << ": " << assets.size() << " entries, " << stats.PackedEntries << " LZ4, " << stats.UnpackedBytes / 1024
+		<< " KB -> " << stats.StoredBytes / 1024 << " KB stored, " << stats.FileBytes / 1024 << " KB with the table and padding, cooked in "
+		<< seconds * 1000.0 << " ms" << std::endl;
+	return 0;
+}
@@ -0,0 +1,287 @@
+#include "blockcompress.h"
+
+#include <cstring>
+
+#include "simd.h"
+
+GLenum GetBlockInternalFormat(BlockFormat format)
+{
+	const GLenum internalFormats[] = {
+		GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+		GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+		GL_COMPRESSED_RED_RGTC1,
+		GL_COMPRESSED_RG_RGTC2
+	};
+	return internalFormats[format];
+}
+
+GLuint GetBlockBytes(BlockFormat format)
+{
+	return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16;
+}
+
+size_t GetCompressedSize(BlockFormat format, GLuint width, GLuint height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format);
+}
+
+static GLushort To565(const unsigned char* color)
+{
+	return (GLushort)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+// back to 8 bits the way the decoder does it, by repeating the top bits
+static void From565(GLushort packed, unsigned char* color)
+{
+	GLuint r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (unsigned char)((r << 3) | (r >> 2));
+	color[1] = (unsigned char)((g << 2) | (g >> 4));
+	color[2] = (unsigned char)((b << 3) | (b >> 2));
+	color[3] = 0;
+}
+
+// index of the nearest of the four palette colors, for each texel; alpha is ignored
+static void MatchPalette(const unsigned char* texels, const unsigned char palette[4][4], GLuint* indices)
+{
+#ifdef SIMD_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+	__m128i colors[4];
+	for (GLuint c = 0; c < 4; c++) {
+		GLuint packed;
+		std::memcpy(&packed, palette[c], 4);
+		colors[c] = _mm_unpacklo_epi8(_mm_set1_epi32((int)packed), zero);
+	}
+
+	// four texels at a time: widen to 16 bits, square the differences and sum them per texel
+	for (GLuint i = 0; i < 16; i += 4) {
+		__m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(texels + i * 4)), rgbMask);
+		__m128i low = _mm_unpacklo_epi8(pixels, zero);
+		__m128i high = _mm_unpackhi_epi8(pixels, zero);
+
+		__m128i distances[4];
+		for (GLuint c = 0; c < 4; c++) {
+			__m128i dLow = _mm_sub_epi16(low, colors[c]);
+			__m128i dHigh = _mm_sub_epi16(high, colors[c]);
+			// madd leaves r*r + g*g and b*b + a*a per texel; fold the pairs together
+			__m128 sumLow = _mm_castsi128_ps(_mm_madd_epi16(dLow, dLow));
+			__m128 sumHigh = _mm_castsi128_ps(_mm_madd_epi16(dHigh, dHigh));
+			distances[c] = _mm_add_epi32(
+				_mm_castps_si128(_mm_shuffle_ps(sumLow, sumHigh, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm_castps_si128(_mm_shuffle_ps(sumLow, sumHigh, _MM_SHUFFLE(3, 1, 3, 1))));
+		}
+
+		// running minimum; sums fit comfortably in 31 bits, so signed compares are safe
+		__m128i best = distances[0];
+		__m128i index = zero;
+		for (GLuint c = 1; c < 4; c++) {
+			__m128i closer = _mm_cmplt_epi32(distances[c], best);
+			best = _mm_or_si128(_mm_and_si128(closer, distances[c]), _mm_andnot_si128(closer, best));
+			index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int)c)), _mm_andnot_si128(closer, index));
+		}
+		_mm_storeu_si128((__m128i*)(indices + i), index);
+	}
+#else
+	for (GLuint i = 0; i < 16; i++) {
+		GLuint bestDistance = 0xFFFFFFFF;
+		for (GLuint c = 0; c < 4; c++) {
+			GLuint distance = 0;
+			for (GLuint channel = 0; channel < 3; channel++) {
+				int d = (int)texels[i * 4 + channel] - (int)palette[c][channel];
+				distance += (GLuint)(d * d);
+			}
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				indices[i] = c;
+			}
+		}
+	}
+#endif
+}
+
+static void GetBounds(const unsigned char* texels, unsigned char* minColor, unsigned char* maxColor)
+{
+#ifdef SIMD_SSE2
+	__m128i minimum = _mm_loadu_si128((const __m128i*)texels);
+	__m128i maximum = minimum;
+	for (GLuint i = 1; i < 4; i++) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(texels + i * 16));
+		minimum = _mm_min_epu8(minimum, pixels);
+		maximum = _mm_max_epu8(maximum, pixels);
+	}
+	// fold the four texels in each register down to one
+	minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 8));
+	minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 4));
+	maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 8));
+	maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 4));
+	GLuint packedMin = (GLuint)_mm_cvtsi128_si32(minimum);
+	GLuint packedMax = (GLuint)_mm_cvtsi128_si32(maximum);
+	std::memcpy(minColor, &packedMin, 4);
+	std::memcpy(maxColor, &packedMax, 4);
+#else
+	std::memcpy(minColor, texels, 4);
+	std::memcpy(maxColor, texels, 4);
+	for (GLuint i = 1; i < 16; i++) {
+		for (GLuint channel = 0; channel < 4; channel++) {
+			unsigned char value = texels[i * 4 + channel];
+			minColor[channel] = value < minColor[channel] ? value : minColor[channel];
+			maxColor[channel] = value > maxColor[channel] ? value : maxColor[channel];
+		}
+	}
+#endif
+}
+
+void CompressBlockBC1(const unsigned char* texels, unsigned char* out)
+{
+	unsigned char minColor[4], maxColor[4];
+	GetBounds(texels, minColor, maxColor);
+
+	// the box's main diagonal only fits when the channels rise together; flip red or blue when they run against green
+	int center[3] = { (minColor[0] + maxColor[0]) / 2, (minColor[1] + maxColor[1]) / 2, (minColor[2] + maxColor[2]) / 2 };
+	int covarianceRG = 0, covarianceBG = 0;
+	for (GLuint i = 0; i < 16; i++) {
+		int g = texels[i * 4 + 1] - center[1];
+		covarianceRG += (texels[i * 4] - center[0]) * g;
+		covarianceBG += (texels[i * 4 + 2] - center[2]) * g;
+	}
+	if (covarianceRG < 0) {
+		unsigned char swap = minColor[0];
+		minColor[0] = maxColor[0];
+		maxColor[0] = swap;
+	}
+	if (covarianceBG < 0) {
+		unsigned char swap = minColor[2];
+		minColor[2] = maxColor[2];
+		maxColor[2] = swap;
+	}
+
+	// pull the ends in by a sixteenth of the range; the extremes are usually outliers the palette can't afford
+	for (GLuint channel = 0; channel < 3; channel++) {
+		int inset = (maxColor[channel] - minColor[channel]) / 16;
+		maxColor[channel] = (unsigned char)(maxColor[channel] - inset);
+		minColor[channel] = (unsigned char)(minColor[channel] + inset);
+	}
+
+	GLushort color0 = To565(maxColor);
+	GLushort color1 = To565(minColor);
+	GLuint indexBits = 0;
+	if (color0 != color1) {
+		// color0 > color1 selects the four-color mode
+		if (color0 < color1) {
+			GLushort swap = color0;
+			color0 = color1;
+			color1 = swap;
+		}
+
+		unsigned char palette[4][4];
+		From565(color0, palette[0]);
+		From565(color1, palette[1]);
+		for (GLuint channel = 0; channel < 3; channel++) {
+			palette[2][channel] = (unsigned char)((2 * palette[0][channel] + palette[1][channel] + 1) / 3);
+			palette[3][channel] = (unsigned char)((palette[0][channel] + 2 * palette[1][channel] + 1) / 3);
+		}
+		palette[2][3] = palette[3][3] = 0;
+
+		GLuint indices[16];
+		MatchPalette(texels, palette, indices);
+		for (GLuint i = 0; i < 16; i++) {
+			indexBits |= indices[i] << (i * 2);
+		}
+	}
+
+	out[0] = (unsigned char)(color0 & 0xFF);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xFF);
+	out[3] = (unsigned char)(color1 >> 8);
+	for (GLuint i = 0; i < 4; i++) {
+		out[4 + i] = (unsigned char)(indexBits >> (i * 8));
+	}
+}
+
+void CompressBlockBC4(const unsigned char* values, unsigned char* out)
+{
+	unsigned char minimum = values[0], maximum = values[0];
+	for (GLuint i = 1; i < 16; i++) {
+		minimum = values[i] < minimum ? values[i] : minimum;
+		maximum = values[i] > maximum ? values[i] : maximum;
+	}
+
+	// value 0 is the maximum and 1 the minimum, which selects the eight-step mode
+	out[0] = maximum;
+	out[1] = minimum;
+	std::memset(out + 2, 0, 6);
+	if (maximum == minimum) {
+		return;
+	}
+
+	// each value's step from the minimum, 0 to 7, is how many of the seven midpoints it reaches
+	int range = maximum - minimum;
+	unsigned char steps[16];
+#ifdef SIMD_SSE2
+	__m128i block = _mm_loadu_si128((const __m128i*)values);
+	__m128i step = _mm_setzero_si128();
+	for (int k = 1; k < 8; k++) {
+		__m128i threshold = _mm_set1_epi8((char)(minimum + ((2 * k - 1) * range + 13) / 14));
+		// unsigned >=, as max(v, t) == v; the all-ones mask counts as -1
+		__m128i reached = _mm_cmpeq_epi8(_mm_max_epu8(block, threshold), block);
+		step = _mm_sub_epi8(step, reached);
+	}
+	_mm_storeu_si128((__m128i*)steps, step);
+#else
+	for (GLuint i = 0; i < 16; i++) {
+		steps[i] = 0;
+		for (int k = 1; k < 8; k++) {
+			steps[i] += values[i] >= minimum + ((2 * k - 1) * range + 13) / 14 ? 1 : 0;
+		}
+	}
+#endif
+
+	// steps 7 and 0 are the endpoints, codes 0 and 1; the rest count down from the maximum as codes 2 to 7
+	GLuint64 indexBits = 0;
+	for (GLuint i = 0; i < 16; i++) {
+		GLuint code = steps[i] == 7 ? 0 : (steps[i] == 0 ? 1 : 8 - steps[i]);
+		indexBits |= (GLuint64)code << (i * 3);
+	}
+	for (GLuint i = 0; i < 6; i++) {
+		out[2 + i] = (unsigned char)(indexBits >> (i * 8));
+	}
+}
+
+void CompressImage(BlockFormat format, const unsigned char* rgba, GLuint width, GLuint height, unsigned char* out)
+{
+	GLuint blockBytes = GetBlockBytes(format);
+	unsigned char texels[64];
+	unsigned char channel[16];
+
+	for (GLuint blockY = 0; blockY < height; blockY += 4) {
+		for (GLuint blockX = 0; blockX < width; blockX += 4) {
+			for (GLuint y = 0; y < 4; y++) {
+				GLuint sourceY = blockY + y < height ? blockY + y : height - 1;
+				for (GLuint x = 0; x < 4; x++) {
+					GLuint sourceX = blockX + x < width ? blockX + x : width - 1;
+					std::memcpy(&texels[(y * 4 + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+				}
+			}
+
+			if (format == BLOCK_BC1) {
+				CompressBlockBC1(texels, out);
+			}
+			else if (format == BLOCK_BC3) {
+				for (GLuint i = 0; i < 16; i++) {
+					channel[i] = texels[i * 4 + 3];
+				}
+				CompressBlockBC4(channel, out);
+				CompressBlockBC1(texels, out + 8);
+			}
+			else {
+				for (GLuint c = 0; c < (format == BLOCK_BC4 ? 1u : 2u); c++) {
+					for (GLuint i = 0; i < 16; i++) {
+						channel[i] = texels[i * 4 + c];
+					}
+					CompressBlockBC4(channel, out + c * 8);
+				}
+			}
+			out += blockBytes;
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// the block-compressed formats we encode; every 4x4 texel block becomes 8 or 16 bytes
+enum BlockFormat {
+	// RGB at 4 bits per texel
+	BLOCK_BC1,
+	// RGB plus separately coded alpha, 8 bits per texel
+	BLOCK_BC3,
+	// red only, 4 bits per texel
+	BLOCK_BC4,
+	// red and green, 8 bits per texel
+	BLOCK_BC5,
+	BLOCK_FORMAT_COUNT
+};
+const char* const BLOCK_FORMAT_NAMES[] = { "BC1", "BC3", "BC4", "BC5" };
+
+GLenum GetBlockInternalFormat(BlockFormat format);
+GLuint GetBlockBytes(BlockFormat format);
+size_t GetCompressedSize(BlockFormat format, GLuint width, GLuint height);
+
+// compresses an RGBA8 image, rows tightly packed, into GetCompressedSize bytes of blocks in the same row order.
+// blocks hanging over the right or bottom edge repeat the last column or row
+void CompressImage(BlockFormat format, const unsigned char* rgba, GLuint width, GLuint height, unsigned char* out);
+
+// one block each; texels are 16 RGBA8 values, row by row, values 16 bytes of one channel
+void CompressBlockBC1(const unsigned char* texels, unsigned char* out);
+void CompressBlockBC4(const unsigned char* values, unsigned char* out);
@@ -0,0 +1,182 @@
+#include "bufferarena.h"
+
+#include <iostream>
+#include <iterator>
+
+#include "glstate.h"
+
+static GLintptr AlignUp(GLintptr offset, GLsizeiptr alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+BufferArena::BufferArena(GLsizeiptr capacity, GLenum usage)
+	: Capacity(capacity)
+{
+	// GL_COPY_WRITE_BUFFER isn't used for drawing, so binding to it never disturbs a VAO
+	glGenBuffers(1, &this->BufferId);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, usage);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	this->FreeRanges[0] = capacity;
+}
+
+BufferArena::~BufferArena()
+{
+	glState.DeleteBuffers(1, &this->BufferId);
+}
+
+GLintptr BufferArena::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	// best fit: the range that leaves the least behind once aligned
+	auto best = this->FreeRanges.end();
+	GLsizeiptr bestLeftover = 0;
+	for (auto range = this->FreeRanges.begin(); range != this->FreeRanges.end(); ++range) {
+		GLintptr start = AlignUp(range->first, alignment);
+		GLsizeiptr needed = (start - range->first) + size;
+		if (needed > range->second) {
+			continue;
+		}
+		GLsizeiptr leftover = range->second - needed;
+		if (best == this->FreeRanges.end() || leftover < bestLeftover) {
+			best = range;
+			bestLeftover = leftover;
+		}
+	}
+
+	if (best == this->FreeRanges.end()) {
+		return INVALID_OFFSET;
+	}
+
+	GLintptr rangeStart = best->first;
+	GLsizeiptr rangeSize = best->second;
+	GLintptr start = AlignUp(rangeStart, alignment);
+	this->FreeRanges.erase(best);
+
+	// whatever alignment skipped and whatever is left over both stay free
+	if (start > rangeStart) {
+		this->FreeRanges[rangeStart] = start - rangeStart;
+	}
+	if (start + size < rangeStart + rangeSize) {
+		this->FreeRanges[start + size] = rangeStart + rangeSize - (start + size);
+	}
+
+	Allocation allocation = { size, alignment };
+	this->Allocations[start] = allocation;
+	return start;
+}
+
+void BufferArena::Free(GLintptr offset)
+{
+	auto allocation = this->Allocations.find(offset);
+	if (allocation == this->Allocations.end()) {
+		std::cout << "ERROR::BUFFER_ARENA::INVALID_FREE\n" << offset << std::endl;
+		return;
+	}
+
+	GLsizeiptr size = allocation->second.Size;
+	this->Allocations.erase(allocation);
+	this->AddFreeRange(offset, size);
+}
+
+void BufferArena::Upload(GLintptr offset, GLsizeiptr size, const void* data)
+{
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void BufferArena::Defragment(const MoveHook& onMove)
+{
+	std::map<GLintptr, Allocation> packed;
+	this->FreeRanges.clear();
+
+	GLintptr cursor = 0;
+	for (const auto& allocation : this->Allocations) {
+		GLintptr to = AlignUp(cursor, allocation.second.Alignment);
+		if (to > cursor) {
+			this->FreeRanges[cursor] = to - cursor;
+		}
+		if (to != allocation.first) {
+			this->CopyRange(allocation.first, to, allocation.second.Size);
+			onMove(allocation.first, to);
+		}
+		packed[to] = allocation.second;
+		cursor = to + allocation.second.Size;
+	}
+	if (cursor < this->Capacity) {
+		this->FreeRanges[cursor] = this->Capacity - cursor;
+	}
+
+	this->Allocations.swap(packed);
+}
+
+GLuint BufferArena::GetBufferId()
+{
+	return this->BufferId;
+}
+
+BufferArena::Stats BufferArena::GetStats()
+{
+	Stats stats = { this->Capacity, 0, 0, (GLuint)this->Allocations.size(), (GLuint)this->FreeRanges.size(), 0.0f };
+
+	for (const auto& allocation : this->Allocations) {
+		stats.Used += allocation.second.Size;
+	}
+
+	GLsizeiptr free = 0;
+	for (const auto& range : this->FreeRanges) {
+		free += range.second;
+		if (range.second > stats.LargestFree) {
+			stats.LargestFree = range.second;
+		}
+	}
+	if (free > 0) {
+		stats.Fragmentation = 1.0f - (GLfloat)stats.LargestFree / free;
+	}
+
+	return stats;
+}
+
+void BufferArena::AddFreeRange(GLintptr offset, GLsizeiptr size)
+{
+	auto next = this->FreeRanges.lower_bound(offset);
+
+	// merge with the range that ends where this one starts
+	if (next != this->FreeRanges.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			this->FreeRanges.erase(previous);
+		}
+	}
+
+	// and with the one that starts where this one ends
+	if (next != this->FreeRanges.end() && offset + size == next->first) {
+		size += next->second;
+		this->FreeRanges.erase(next);
+	}
+
+	this->FreeRanges[offset] = size;
+}
+
+void BufferArena::CopyRange(GLintptr from, GLintptr to, GLsizeiptr size)
+{
+	// copies within one buffer mustn't overlap, so a move shorter than the range goes in chunks of at most
+	// the distance moved. Defragment only moves ranges down, so walking forwards no chunk reads bytes an earlier one wrote
+	GLsizeiptr chunk = from > to ? from - to : to - from;
+	if (chunk > size) {
+		chunk = size;
+	}
+
+	glState.BindBuffer(GL_COPY_READ_BUFFER, this->BufferId);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+	for (GLsizeiptr done = 0; done < size; done += chunk) {
+		GLsizeiptr length = size - done < chunk ? size - done : chunk;
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from + done, to + done, length);
+	}
+	glState.BindBuffer(GL_COPY_READ_BUFFER, 0);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <map>
+
+#include <GL/glew.h>
+
+// one large GL buffer carved into sub-ranges, so meshes share a handful of buffers instead of owning one each.
+// free space is an offset-ordered list; allocation is best fit and freeing coalesces with both neighbours
+class BufferArena
+{
+public:
+	// returned by Allocate when nothing fits
+	static const GLintptr INVALID_OFFSET = -1;
+
+	struct Stats
+	{
+		GLsizeiptr Capacity;
+		GLsizeiptr Used;
+		GLsizeiptr LargestFree;
+		GLuint Allocations;
+		GLuint FreeRanges;
+		// 0 when all free space is one range, approaching 1 as it splinters
+		GLfloat Fragmentation;
+	};
+
+	// called once per allocation Defragment moves, so owners can patch their offsets
+	typedef std::function<void(GLintptr from, GLintptr to)> MoveHook;
+
+	BufferArena(GLsizeiptr capacity, GLenum usage = GL_STATIC_DRAW);
+	~BufferArena();
+
+	// alignment needn't be a power of two; vertex ranges align to their stride so base vertices come out whole
+	GLintptr Allocate(GLsizeiptr size, GLsizeiptr alignment = 4);
+	void Free(GLintptr offset);
+	void Upload(GLintptr offset, GLsizeiptr size, const void* data);
+
+	// slides every allocation down towards offset 0 with GPU-side copies, leaving one free range at the end
+	void Defragment(const MoveHook& onMove);
+
+	GLuint GetBufferId();
+	Stats GetStats();
+
+private:
+	struct Allocation
+	{
+		GLsizeiptr Size;
+		GLsizeiptr Alignment;
+	};
+
+	GLuint BufferId;
+	GLsizeiptr Capacity;
+	// offset -> size
+	std::map<GLintptr, GLsizeiptr> FreeRanges;
+	std::map<GLintptr, Allocation> Allocations;
+
+	void AddFreeRange(GLintptr offset, GLsizeiptr size);
+	void CopyRange(GLintptr from, GLintptr to, GLsizeiptr size);
+};
@@ -0,0 +1,8 @@
+// screen-door crossfade between an object's mesh and its impostor: the two draw complementary pixel sets,
+// so neither needs blending or sorting
+
+// interleaved gradient noise, in [0, 1)
+float FadeThreshold()
+{
+	return fract(52.9829189f * fract(dot(gl_FragCoord.xy, vec2(0.06711056f, 0.00583715f))));
+}
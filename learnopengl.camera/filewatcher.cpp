@@ -0,0 +1,117 @@
+#include "filewatcher.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+// how long the watcher sleeps between checks for shutdown or (without inotify) file changes
+const int WATCH_INTERVAL_MS = 100;
+// editors often write a file in several steps, so wait for them to settle before reporting
+const int WATCH_SETTLE_MS = 50;
+
+FileWatcher::FileWatcher(const std::vector<std::string>& paths, std::function<void()> onChange)
+	: Paths(paths),
+	OnChange(onChange),
+	Running(true)
+{
+	this->Thread = std::thread(&FileWatcher::Run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+	this->Running = false;
+	this->Thread.join();
+}
+
+#ifdef __linux__
+
+void FileWatcher::Run()
+{
+	int fd = inotify_init1(IN_NONBLOCK);
+	if (fd == -1) {
+		std::cout << "ERROR::FILEWATCHER::INOTIFY_INIT_FAILED" << std::endl;
+		return;
+	}
+
+	// watch the containing directories rather than the files, since many editors save by
+	// writing a new file and renaming it over the old one, which would orphan a file watch
+	std::vector<int> watches;
+	std::vector<std::string> fileNames;
+	for (const std::string& path : this->Paths) {
+		size_t slash = path.find_last_of('/');
+		std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+		fileNames.push_back(slash == std::string::npos ? path : path.substr(slash + 1));
+		watches.push_back(inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE));
+	}
+
+	alignas(struct inotify_event) char buffer[4096];
+	while (this->Running) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, WATCH_INTERVAL_MS) <= 0) {
+			continue;
+		}
+
+		bool changed = false;
+		ssize_t length;
+		while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+			for (char* ptr = buffer; ptr < buffer + length; ) {
+				const struct inotify_event* event = (const struct inotify_event*)ptr;
+				for (size_t i = 0; i < watches.size(); i++) {
+					if (event->wd == watches[i] && event->len > 0 && fileNames[i] == event->name) {
+						changed = true;
+					}
+				}
+				ptr += sizeof(struct inotify_event) + event->len;
+			}
+		}
+
+		if (changed) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_SETTLE_MS));
+			this->OnChange();
+		}
+	}
+
+	close(fd);
+}
+
+#else
+
+void FileWatcher::Run()
+{
+	// no inotify; fall back to comparing modification times
+	std::vector<time_t> modifiedTimes(this->Paths.size(), 0);
+	for (size_t i = 0; i < this->Paths.size(); i++) {
+		struct stat info;
+		if (stat(this->Paths[i].c_str(), &info) == 0) {
+			modifiedTimes[i] = info.st_mtime;
+		}
+	}
+
+	while (this->Running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+
+		bool changed = false;
+		for (size_t i = 0; i < this->Paths.size(); i++) {
+			struct stat info;
+			if (stat(this->Paths[i].c_str(), &info) == 0 && info.st_mtime != modifiedTimes[i]) {
+				modifiedTimes[i] = info.st_mtime;
+				changed = true;
+			}
+		}
+
+		if (changed) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_SETTLE_MS));
+			this->OnChange();
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// watches a set of files from a background thread and calls OnChange (on that thread)
+// whenever any of them is rewritten; uses inotify on Linux and mtime polling elsewhere
+class FileWatcher
+{
+public:
+	FileWatcher(const std::vector<std::string>& paths, std::function<void()> onChange);
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+private:
+	std::vector<std::string> Paths;
+	std::function<void()> OnChange;
+	std::atomic<bool> Running;
+	std::thread Thread;
+
+	void Run();
+};
@@ -0,0 +1,210 @@
+#include "glstate.h"
+
+GLState glState;
+
+GLState::GLState()
+{
+	this->Current.Issued = this->Current.Elided = 0;
+	this->Last = this->Current;
+	Invalidate();
+}
+
+void GLState::UseProgram(GLuint programId)
+{
+	if (Elide(this->ProgramId == programId)) {
+		return;
+	}
+	this->ProgramId = programId;
+	glUseProgram(programId);
+}
+
+void GLState::BindVertexArray(GLuint vaoId)
+{
+	if (Elide(this->VaoId == vaoId)) {
+		return;
+	}
+	this->VaoId = vaoId;
+	// the element array binding is part of the VAO, so we no longer know what it is
+	this->ElementArrayBufferId = UNKNOWN;
+	glBindVertexArray(vaoId);
+}
+
+void GLState::BindBuffer(GLenum target, GLuint bufferId)
+{
+	GLuint* shadow = nullptr;
+	if (target == GL_ARRAY_BUFFER) {
+		shadow = &this->ArrayBufferId;
+	}
+	else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+		shadow = &this->ElementArrayBufferId;
+	}
+
+	if (shadow != nullptr) {
+		if (Elide(*shadow == bufferId)) {
+			return;
+		}
+		*shadow = bufferId;
+	}
+	else {
+		this->Current.Issued++;
+	}
+	glBindBuffer(target, bufferId);
+}
+
+void GLState::ActiveTexture(GLuint unit)
+{
+	if (Elide(this->ActiveUnit == unit)) {
+		return;
+	}
+	this->ActiveUnit = unit;
+	glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint textureId)
+{
+	if (unit < MAX_TRACKED_TEXTURE_UNITS) {
+		if (Elide(this->TextureIds[unit] == textureId && this->TextureTargets[unit] == target)) {
+			return;
+		}
+		this->TextureIds[unit] = textureId;
+		this->TextureTargets[unit] = target;
+	}
+	else {
+		this->Current.Issued++;
+	}
+
+	ActiveTexture(unit);
+	glBindTexture(target, textureId);
+}
+
+void GLState::Enable(GLenum capability)
+{
+	GLuint* shadow = FindCapability(capability);
+	if (shadow != nullptr) {
+		if (Elide(*shadow == GL_TRUE)) {
+			return;
+		}
+		*shadow = GL_TRUE;
+	}
+	else {
+		this->Current.Issued++;
+	}
+	glEnable(capability);
+}
+
+void GLState::Disable(GLenum capability)
+{
+	GLuint* shadow = FindCapability(capability);
+	if (shadow != nullptr) {
+		if (Elide(*shadow == GL_FALSE)) {
+			return;
+		}
+		*shadow = GL_FALSE;
+	}
+	else {
+		this->Current.Issued++;
+	}
+	glDisable(capability);
+}
+
+void GLState::DeleteTextures(GLsizei count, const GLuint* textureIds)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		// 0 is never deleted, and GL rebinds 0 wherever a deleted texture was bound
+		for (GLuint unit = 0; textureIds[i] != 0 && unit < MAX_TRACKED_TEXTURE_UNITS; unit++) {
+			if (this->TextureIds[unit] == textureIds[i]) {
+				this->TextureIds[unit] = 0;
+			}
+		}
+	}
+	glDeleteTextures(count, textureIds);
+}
+
+void GLState::DeleteBuffers(GLsizei count, const GLuint* bufferIds)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		if (bufferIds[i] == 0) {
+			continue;
+		}
+		if (this->ArrayBufferId == bufferIds[i]) {
+			this->ArrayBufferId = 0;
+		}
+		if (this->ElementArrayBufferId == bufferIds[i]) {
+			this->ElementArrayBufferId = 0;
+		}
+	}
+	glDeleteBuffers(count, bufferIds);
+}
+
+void GLState::DeleteVertexArray(GLuint vaoId)
+{
+	if (vaoId != 0 && this->VaoId == vaoId) {
+		// back to the default VAO, whose element array binding we never tracked
+		this->VaoId = 0;
+		this->ElementArrayBufferId = UNKNOWN;
+	}
+	glDeleteVertexArrays(1, &vaoId);
+}
+
+void GLState::DeleteProgram(GLuint programId)
+{
+	// a program in use stays in use until something else is, so the next UseProgram has to reach GL whatever it names
+	if (programId != 0 && this->ProgramId == programId) {
+		this->ProgramId = UNKNOWN;
+	}
+	glDeleteProgram(programId);
+}
+
+void GLState::Invalidate()
+{
+	this->ProgramId = UNKNOWN;
+	this->VaoId = UNKNOWN;
+	this->ArrayBufferId = UNKNOWN;
+	this->ElementArrayBufferId = UNKNOWN;
+	this->ActiveUnit = UNKNOWN;
+	for (GLuint i = 0; i < MAX_TRACKED_TEXTURE_UNITS; i++) {
+		this->TextureIds[i] = UNKNOWN;
+		this->TextureTargets[i] = GL_NONE;
+	}
+	this->DepthTest = UNKNOWN;
+	this->Blend = UNKNOWN;
+	this->CullFace = UNKNOWN;
+}
+
+GLState::FrameStats GLState::EndFrame()
+{
+	this->Last = this->Current;
+	this->Current.Issued = this->Current.Elided = 0;
+	return this->Last;
+}
+
+GLState::FrameStats GLState::GetLastFrameStats()
+{
+	return this->Last;
+}
+
+GLuint* GLState::FindCapability(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST:
+		return &this->DepthTest;
+	case GL_BLEND:
+		return &this->Blend;
+	case GL_CULL_FACE:
+		return &this->CullFace;
+	default:
+		return nullptr;
+	}
+}
+
+bool GLState::Elide(bool unchanged)
+{
+	if (unchanged) {
+		this->Current.Elided++;
+	}
+	else {
+		this->Current.Issued++;
+	}
+	return unchanged;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// the most texture units we shadow; binds past this go straight to GL
+const GLuint MAX_TRACKED_TEXTURE_UNITS = 16;
+
+// shadows the bits of GL state we touch every frame and drops calls that wouldn't change anything.
+// everything that binds programs, VAOs, buffers or textures should go through here, otherwise the
+// shadow goes stale; call Invalidate() after handing the context to code that doesn't. the same goes for deleting
+// them: GL unbinds a deleted object and may hand its name out again, which a stale shadow would then elide binds of
+class GLState
+{
+public:
+	struct FrameStats
+	{
+		GLuint Issued;
+		GLuint Elided;
+	};
+
+	GLState();
+
+	void UseProgram(GLuint programId);
+	void BindVertexArray(GLuint vaoId);
+	void BindBuffer(GLenum target, GLuint bufferId);
+	void ActiveTexture(GLuint unit);
+	// makes unit active (if it isn't) and binds the texture to it
+	void BindTexture(GLuint unit, GLenum target, GLuint textureId);
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+
+	// delete through GL, then forget any binding of the deleted names
+	void DeleteTextures(GLsizei count, const GLuint* textureIds);
+	void DeleteBuffers(GLsizei count, const GLuint* bufferIds);
+	void DeleteVertexArray(GLuint vaoId);
+	void DeleteProgram(GLuint programId);
+
+	// forget everything we think we know, so the next call of each kind always reaches GL
+	void Invalidate();
+
+	// closes out the frame's counters; returns the stats of the frame just finished
+	FrameStats EndFrame();
+	FrameStats GetLastFrameStats();
+
+private:
+	// GL names are never 0xFFFFFFFF, so it marks "unknown"
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	GLuint ProgramId;
+	GLuint VaoId;
+	GLuint ArrayBufferId;
+	GLuint ElementArrayBufferId;
+	GLuint ActiveUnit;
+	GLuint TextureIds[MAX_TRACKED_TEXTURE_UNITS];
+	GLenum TextureTargets[MAX_TRACKED_TEXTURE_UNITS];
+	// tri-state per capability: UNKNOWN, GL_TRUE or GL_FALSE
+	GLuint DepthTest;
+	GLuint Blend;
+	GLuint CullFace;
+
+	FrameStats Current;
+	FrameStats Last;
+
+	GLuint* FindCapability(GLenum capability);
+	bool Elide(bool unchanged);
+};
+
+// the one context we render with
+extern GLState glState;
@@ -0,0 +1,139 @@
+#include "impostor.h"
+
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "glstate.h"
+
+ImpostorAtlas::ImpostorAtlas()
+	: Radius(0.0f), Baked(GL_FALSE)
+{
+	GLsizei width = IMPOSTOR_YAW_VIEWS * IMPOSTOR_VIEW_SIZE;
+	GLsizei height = IMPOSTOR_PITCH_VIEWS * IMPOSTOR_VIEW_SIZE;
+
+	// stop the mips before a view shrinks to a few texels, or neighbouring views bleed into each other
+	GLint levels = 1;
+	while ((IMPOSTOR_VIEW_SIZE >> levels) >= 8) {
+		levels++;
+	}
+
+	glGenTextures(1, &this->TextureId);
+	glState.BindTexture(0, GL_TEXTURE_2D, this->TextureId);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glState.BindTexture(0, GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &this->DepthId);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->DepthId);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &this->FramebufferId);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->FramebufferId);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->TextureId, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->DepthId);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+	glDeleteFramebuffers(1, &this->FramebufferId);
+	glDeleteRenderbuffers(1, &this->DepthId);
+	glState.DeleteTextures(1, &this->TextureId);
+}
+
+bool ImpostorAtlas::Bake(GLfloat radius, const DrawView& drawView)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, this->FramebufferId);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::IMPOSTOR::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// alpha 0 marks texels the mesh never covered
+	glViewport(0, 0, IMPOSTOR_YAW_VIEWS * IMPOSTOR_VIEW_SIZE, IMPOSTOR_PITCH_VIEWS * IMPOSTOR_VIEW_SIZE);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// whatever alpha the mesh's shader writes, every covered texel stores 1
+	glState.Enable(GL_BLEND);
+	glBlendColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glBlendFuncSeparate(GL_ONE, GL_ZERO, GL_CONSTANT_ALPHA, GL_ZERO);
+
+	// an orthographic box just around the bounds, looking in from each view direction
+	glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+	for (GLuint pitch = 0; pitch < IMPOSTOR_PITCH_VIEWS; pitch++) {
+		for (GLuint yaw = 0; yaw < IMPOSTOR_YAW_VIEWS; yaw++) {
+			glm::mat4 view = glm::lookAt(GetViewDirection(yaw, pitch) * (2.0f * radius), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			glViewport(yaw * IMPOSTOR_VIEW_SIZE, pitch * IMPOSTOR_VIEW_SIZE, IMPOSTOR_VIEW_SIZE, IMPOSTOR_VIEW_SIZE);
+			drawView(view, projection);
+		}
+	}
+
+	// cleanup
+	glState.Disable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glState.BindTexture(0, GL_TEXTURE_2D, this->TextureId);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glState.BindTexture(0, GL_TEXTURE_2D, 0);
+
+	this->Radius = radius;
+	this->Baked = GL_TRUE;
+	return true;
+}
+
+GLboolean ImpostorAtlas::IsBaked()
+{
+	return this->Baked;
+}
+
+void ImpostorAtlas::Apply(Shader& shader, GLuint unit)
+{
+	glState.BindTexture(unit, GL_TEXTURE_2D, this->TextureId);
+	shader.Set(UNIFORM("impostorAtlas"), (GLint)unit);
+	shader.Set(UNIFORM("impostorRadius"), this->Radius);
+	shader.Set(UNIFORM("impostorYawViews"), (GLint)IMPOSTOR_YAW_VIEWS);
+	shader.Set(UNIFORM("impostorPitchViews"), (GLint)IMPOSTOR_PITCH_VIEWS);
+}
+
+GLfloat ImpostorAtlas::GetFadeStart(GLfloat pixelsPerUnit)
+{
+	// the distance at which the bounds' diameter covers IMPOSTOR_PIXELS
+	return 2.0f * this->Radius * pixelsPerUnit / IMPOSTOR_PIXELS;
+}
+
+GLfloat ImpostorAtlas::GetFadeEnd(GLfloat pixelsPerUnit)
+{
+	return this->GetFadeStart(pixelsPerUnit) * (1.0f + IMPOSTOR_FADE_BAND);
+}
+
+GLuint ImpostorAtlas::GetTextureId()
+{
+	return this->TextureId;
+}
+
+GLfloat ImpostorAtlas::GetRadius()
+{
+	return this->Radius;
+}
+
+glm::vec3 ImpostorAtlas::GetViewDirection(GLuint yaw, GLuint pitch)
+{
+	// yaw views start on +x; pitch bands are centred, so no view looks straight down the vertical axis
+	const GLfloat pi = 3.14159265f;
+	GLfloat yawAngle = 2.0f * pi * yaw / IMPOSTOR_YAW_VIEWS;
+	GLfloat pitchAngle = ((pitch + 0.5f) / IMPOSTOR_PITCH_VIEWS - 0.5f) * pi;
+	return glm::vec3(std::cos(pitchAngle) * std::cos(yawAngle), std::sin(pitchAngle), std::cos(pitchAngle) * std::sin(yawAngle));
+}
@@ -0,0 +1,26 @@
+#version 400 core
+
+in vec3 ourColor;
+in vec2 ourTexCoord;
+in float fade;
+
+out vec4 color;
+
+uniform sampler2D impostorAtlas;
+
+#include "fade.glsl"
+
+void main()
+{
+	// the mesh keeps these pixels
+	if (fade <= FadeThreshold()) {
+		discard;
+	}
+
+	// alpha is coverage: 1 wherever the mesh was drawn during baking
+	color = texture(impostorAtlas, ourTexCoord);
+	if (color.a < 0.5f) {
+		discard;
+	}
+	color = vec4(color.rgb * ourColor, 1.0f);
+}
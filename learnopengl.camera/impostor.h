@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// views baked per mesh: evenly around the vertical axis, times bands from below to above
+const GLuint IMPOSTOR_YAW_VIEWS = 8;
+const GLuint IMPOSTOR_PITCH_VIEWS = 4;
+// pixels per side of one view in the atlas
+const GLsizei IMPOSTOR_VIEW_SIZE = 128;
+// objects covering fewer pixels than this swap to their impostor, crossfading over the next IMPOSTOR_FADE_BAND of distance
+const GLfloat IMPOSTOR_PIXELS = 32.0f;
+const GLfloat IMPOSTOR_FADE_BAND = 0.25f;
+
+// one mesh rendered from every view direction into a single texture, for impostor.vert/impostor.frag to draw
+// far-off instances as textured cards instead of geometry
+class ImpostorAtlas
+{
+public:
+	// draws the mesh (at the origin, unrotated) with these matrices
+	typedef std::function<void(const glm::mat4& view, const glm::mat4& projection)> DrawView;
+
+	ImpostorAtlas();
+	~ImpostorAtlas();
+
+	// renders every view into its cell of the atlas; radius must bound the mesh about its origin.
+	// leaves the default framebuffer bound and the viewport as it found it
+	bool Bake(GLfloat radius, const DrawView& drawView);
+	GLboolean IsBaked();
+
+	// binds the atlas to unit and points the impostor program at it
+	void Apply(Shader& shader, GLuint unit);
+
+	// where instances start fading to the impostor, given MeshPool::GetPixelsPerUnit
+	GLfloat GetFadeStart(GLfloat pixelsPerUnit);
+	GLfloat GetFadeEnd(GLfloat pixelsPerUnit);
+
+	GLuint GetTextureId();
+	GLfloat GetRadius();
+
+	// the direction from the mesh towards the camera that view (yaw, pitch) was baked from; impostor.vert mirrors this
+	static glm::vec3 GetViewDirection(GLuint yaw, GLuint pitch);
+
+private:
+	GLuint TextureId;
+	GLuint FramebufferId;
+	GLuint DepthId;
+	GLfloat Radius;
+	GLboolean Baked;
+
+	ImpostorAtlas(const ImpostorAtlas&);
+	ImpostorAtlas& operator=(const ImpostorAtlas&);
+};
@@ -0,0 +1,45 @@
+#version 400 core
+
+// a camera-facing card per instance, textured with whichever baked view of the mesh is nearest the camera.
+// the quad's corners come from gl_VertexID, so the only attributes are the instance ones
+
+out vec3 ourColor;
+out vec2 ourTexCoord;
+out float fade;
+
+#include "perframe.glsl"
+#include "instance.glsl"
+
+// mirrors ImpostorAtlas: the mesh's bounding radius and how its views are laid out
+uniform float impostorRadius;
+uniform int impostorYawViews;
+uniform int impostorPitchViews;
+
+const float PI = 3.14159265f;
+
+void main()
+{
+	mat4 model = InstanceModel();
+	vec3 center = model[3].xyz;
+
+	// the camera as seen from the object's own frame picks the view; model is rotation and translation only
+	vec3 toEye = transpose(mat3(model)) * normalize(cameraPosition - center);
+	int yaw = int(round(atan(toEye.z, toEye.x) / (2.0f * PI) * impostorYawViews));
+	yaw = (yaw % impostorYawViews + impostorYawViews) % impostorYawViews;
+	int pitch = clamp(int(floor((asin(clamp(toEye.y, -1.0f, 1.0f)) / PI + 0.5f) * impostorPitchViews)), 0, impostorPitchViews - 1);
+
+	// rebuild the baking camera for that view (as glm::lookAt does), so the card sits exactly where the view was captured
+	float yawAngle = 2.0f * PI * yaw / impostorYawViews;
+	float pitchAngle = ((pitch + 0.5f) / impostorPitchViews - 0.5f) * PI;
+	vec3 forward = -vec3(cos(pitchAngle) * cos(yawAngle), sin(pitchAngle), cos(pitchAngle) * sin(yawAngle));
+	vec3 right = normalize(cross(forward, vec3(0.0f, 1.0f, 0.0f)));
+	vec3 up = cross(right, forward);
+
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0f - 1.0f;
+	vec3 position = (right * corner.x + up * corner.y) * impostorRadius;
+	gl_Position = projection * view * model * vec4(position, 1.0f);
+
+	ourColor = instanceTint.rgb;
+	ourTexCoord = (vec2(yaw, pitch) + corner * 0.5f + 0.5f) / vec2(impostorYawViews, impostorPitchViews);
+	fade = ImpostorFade(center);
+}
@@ -0,0 +1,110 @@
+#include "indirectdraw.h"
+
+#include "glstate.h"
+
+IndirectBatch::IndirectBatch(MeshPool& pool)
+	: Pool(pool), BufferId(0), Dirty(GL_TRUE), InstanceBufferId(0), InstanceStride(0), ApplyInstanceLayout(nullptr)
+{
+	if (IsMultiDrawSupported()) {
+		glGenBuffers(1, &this->BufferId);
+	}
+}
+
+IndirectBatch::~IndirectBatch()
+{
+	if (this->BufferId != 0) {
+		glState.DeleteBuffers(1, &this->BufferId);
+	}
+}
+
+void IndirectBatch::SetInstanceSource(GLuint bufferId, GLsizei stride, void (*applyFrom)(GLsizei, size_t, GLuint))
+{
+	this->InstanceBufferId = bufferId;
+	this->InstanceStride = stride;
+	this->ApplyInstanceLayout = applyFrom;
+}
+
+void IndirectBatch::Clear()
+{
+	this->Commands.clear();
+	this->Dirty = GL_TRUE;
+}
+
+void IndirectBatch::Add(GLuint meshId, GLuint instanceCount, GLuint baseInstance, GLuint lod)
+{
+	const MeshPool::Mesh& mesh = this->Pool.GetMesh(meshId);
+	DrawElementsIndirectCommand command = { (GLuint)mesh.Lods[lod].IndexCount, instanceCount, mesh.Lods[lod].FirstIndex, mesh.BaseVertex, baseInstance };
+	this->Commands.push_back(command);
+	this->Dirty = GL_TRUE;
+}
+
+GLuint IndirectBatch::Submit()
+{
+	if (this->Commands.empty()) {
+		return 0;
+	}
+	if (this->BufferId == 0) {
+		return this->SubmitLoop();
+	}
+
+	// the draw indirect binding isn't part of VAO state, so it's safe to leave bound
+	glState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, this->BufferId);
+	if (this->Dirty) {
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, this->Commands.size() * sizeof(DrawElementsIndirectCommand), this->Commands.data(), GL_STATIC_DRAW);
+		this->Dirty = GL_FALSE;
+	}
+
+	glState.BindVertexArray(this->Pool.GetVertexArrayId());
+	glMultiDrawElementsIndirect(GL_TRIANGLES, this->Pool.GetIndexType(), 0, (GLsizei)this->Commands.size(), sizeof(DrawElementsIndirectCommand));
+	return 1;
+}
+
+GLuint IndirectBatch::GetCommandCount()
+{
+	return (GLuint)this->Commands.size();
+}
+
+bool IndirectBatch::IsMultiDrawSupported()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+bool IndirectBatch::IsBaseInstanceSupported()
+{
+	return GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+}
+
+GLuint IndirectBatch::SubmitLoop()
+{
+	GLenum indexType = this->Pool.GetIndexType();
+	GLsizeiptr indexSize = indexType == GL_UNSIGNED_BYTE ? 1 : (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+	bool baseInstance = IsBaseInstanceSupported();
+	bool repoint = !baseInstance && this->ApplyInstanceLayout != nullptr;
+
+	glState.BindVertexArray(this->Pool.GetVertexArrayId());
+	if (repoint) {
+		glState.BindBuffer(GL_ARRAY_BUFFER, this->InstanceBufferId);
+	}
+
+	for (const DrawElementsIndirectCommand& command : this->Commands) {
+		GLvoid* indices = (GLvoid*)(command.FirstIndex * indexSize);
+		if (baseInstance) {
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.Count, indexType, indices, command.InstanceCount, command.BaseVertex, command.BaseInstance);
+			continue;
+		}
+
+		// without base instance, start the instance attributes at this draw's first instance instead
+		if (repoint) {
+			this->ApplyInstanceLayout(this->InstanceStride, command.BaseInstance * this->InstanceStride, 1);
+		}
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.Count, indexType, indices, command.InstanceCount, command.BaseVertex);
+	}
+
+	// leave the VAO reading from the first instance, as every other draw expects
+	if (repoint) {
+		this->ApplyInstanceLayout(this->InstanceStride, 0, 1);
+		glState.BindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	return (GLuint)this->Commands.size();
+}
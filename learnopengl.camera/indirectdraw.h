@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "meshpool.h"
+
+// the record glMultiDrawElementsIndirect reads; the layout is fixed by GL
+struct DrawElementsIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+
+// a bucket of draws from one MeshPool, submitted with a single glMultiDrawElementsIndirect where the context
+// has it (GL 4.3 or ARB_multi_draw_indirect) and as a loop of direct draws where it doesn't. per-draw data
+// reaches the shader through each draw's base instance, i.e. through divisor-1 instance attributes
+class IndirectBatch
+{
+public:
+	IndirectBatch(MeshPool& pool);
+	~IndirectBatch();
+
+	// the instance attributes to re-point at each draw's base instance when GL can't offset them itself
+	// (no ARB_base_instance); applyFrom is a VertexLayout's ApplyFrom
+	void SetInstanceSource(GLuint bufferId, GLsizei stride, void (*applyFrom)(GLsizei, size_t, GLuint));
+
+	void Clear();
+	// lod picks which of the mesh's detail levels the command draws
+	void Add(GLuint meshId, GLuint instanceCount = 1, GLuint baseInstance = 0, GLuint lod = 0);
+
+	// uploads the commands if they changed and draws them all; returns the number of GL draw calls it took
+	GLuint Submit();
+
+	GLuint GetCommandCount();
+	static bool IsMultiDrawSupported();
+	static bool IsBaseInstanceSupported();
+
+private:
+	MeshPool& Pool;
+	std::vector<DrawElementsIndirectCommand> Commands;
+	GLuint BufferId;
+	GLboolean Dirty;
+
+	GLuint InstanceBufferId;
+	GLsizei InstanceStride;
+	void (*ApplyInstanceLayout)(GLsizei, size_t, GLuint);
+
+	GLuint SubmitLoop();
+};
@@ -0,0 +1,39 @@
+// per-instance attributes of the cube field, advanced once per object rather than once per vertex; mirrors CubeInstance in main.cpp
+
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in vec4 instanceTint;
+layout (location = 9) in float instanceSpin;
+// texture array layers: the base in x, the one mixed over it in y
+layout (location = 10) in vec4 instanceLayers;
+
+// objects fade from mesh to impostor between these distances; both 0 while impostors are off
+uniform float impostorFadeStart;
+uniform float impostorFadeEnd;
+
+// same matrix glm::rotate builds; axis must be normalized
+mat4 Rotate(float angle, vec3 axis)
+{
+	float c = cos(angle);
+	float s = sin(angle);
+	vec3 t = (1.0f - c) * axis;
+	return mat4(
+		vec4(t.x * axis.x + c,          t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y, 0.0f),
+		vec4(t.y * axis.x - s * axis.z, t.y * axis.y + c,          t.y * axis.z + s * axis.x, 0.0f),
+		vec4(t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, t.z * axis.z + c,          0.0f),
+		vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+// spinning happens here so the instance buffer never has to be rewritten
+mat4 InstanceModel()
+{
+	return instanceModel * Rotate(time * instanceSpin, normalize(vec3(1.0f, 0.3f, 0.5f)));
+}
+
+// 0 where the mesh is drawn alone, 1 where the impostor is
+float ImpostorFade(vec3 center)
+{
+	if (impostorFadeEnd <= impostorFadeStart) {
+		return 0.0f;
+	}
+	return clamp((distance(cameraPosition, center) - impostorFadeStart) / (impostorFadeEnd - impostorFadeStart), 0.0f, 1.0f);
+}
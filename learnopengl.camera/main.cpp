@@ -4,23 +4,89 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <SOIL.h>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
 
 #include "shader.h"
 #include "camera.h"
+#include "glstate.h"
+#include "uniformbuffer.h"
+#include "mesh.h"
+#include "vertexlayout.h"
+#include "meshpool.h"
+#include "indirectdraw.h"
+#include "meshfile.h"
+#include "impostor.h"
+#include "textureloader.h"
+#include "assetbundle.h"
 
 int InitGLFWwindow();
 int InitGLEW();
 
+// one cube of the field; Model holds everything but the spin, which the instanced shader applies itself
+struct CubeInstance
+{
+	glm::mat4 Model;
+	GLubyte Tint[4];
+	GLfloat Spin;
+	// texture array layers, base then overlay; the other two keep the instance a whole number of words
+	GLubyte Layers[4];
+};
+
+typedef VertexLayout<
+	MatrixAttribute<INSTANCE_MODEL>,
+	VertexAttribute<INSTANCE_TINT, 4, GL_UNSIGNED_BYTE, GL_TRUE>,
+	VertexAttribute<INSTANCE_SPIN, 1, GL_FLOAT>,
+	VertexAttribute<INSTANCE_LAYERS, 4, GL_UNSIGNED_BYTE>> CubeInstanceLayout;
+
+static_assert(sizeof(CubeInstance) == CubeInstanceLayout::Stride, "CubeInstance must match its vertex layout");
+
+const GLuint MIN_CUBE_COUNT = 10;
+const GLuint MAX_CUBE_COUNT = 1000000;
+
+// how the field is submitted: a uniform and a draw per cube, one instanced draw, or one indirect command per cube
+enum CubeDrawMode {
+	CUBE_DRAW_LOOPED,
+	CUBE_DRAW_INSTANCED,
+	CUBE_DRAW_INDIRECT,
+	CUBE_DRAW_MODE_COUNT
+};
+const char* const CUBE_DRAW_MODE_NAMES[] = { "looped", "instanced", "indirect" };
+
+// how much of each frame may go on uploading textures that finished decoding
+const GLdouble TEXTURE_UPLOAD_BUDGET = 0.002;
+// the side every cube texture is resized to, so they can all share one texture array
+const GLuint CUBE_TEXTURE_SIZE = 512;
+// video memory the texture loader may fill before it starts evicting the least recently bound textures
+const GLuint64 TEXTURE_BUDGET = 256 * 1024 * 1024;
+
+// how far the camera moves before the instanced field picks its LODs again
+const GLfloat LOD_REFRESH_DISTANCE = 1.0f;
+
 // object creation
-void CreateTriangle(GLuint* id, GLfloat* vertices, GLuint size);
-void CreateCube(GLuint* id, GLfloat* vertices, GLuint size);
-void CreateRect(GLuint* id, GLfloat* vertices, GLuint* indices, GLuint sizeVertices, GLuint sizeIndices);
-void CreateTexture(GLuint *textureId, char* filename, GLenum wrapType, GLenum texFilterType);
-void DrawTriangle(GLuint* id);
-void DrawCube(GLuint* id);
-void DrawRect(GLuint* id);
+void CreateTriangle(GLuint* id, MeshPool& pool, GLfloat* vertices, GLuint size);
+void CreateCube(GLuint* id, MeshPool& pool, const IndexedMesh& mesh);
+void CreateRect(GLuint* id, MeshPool& pool, const IndexedMesh& mesh);
+void CreateLodSphere(GLuint* id, MeshPool& pool);
+void BakeImpostor(ImpostorAtlas* atlas, GLuint* id, MeshPool& pool, Shader& shader, UniformBuffer<PerFrameUniforms>& perFrameUniformBuffer,
+	TextureLoader& textures, TextureLoader::Handle textureArray, glm::vec2 layers);
+void LogPackedSize(const char* name, const IndexedMesh& mesh, GLsizei packedStride);
+void DrawTriangle(GLuint* id, MeshPool& pool);
+void DrawCube(GLuint* id, MeshPool& pool, GLuint lod = 0);
+void DrawRect(GLuint* id, MeshPool& pool);
+GLfloat GenerateCubeField(GLuint count, GLubyte baseLayer, GLubyte overlayLayer, std::vector<CubeInstance>& instances);
+void CreateCubeInstances(GLuint vaoId, GLuint* instanceVboId);
+void UploadCubeInstances(GLuint instanceVboId, const std::vector<CubeInstance>& instances);
+GLuint BucketFieldByLod(MeshPool& pool, GLuint meshId, const std::vector<CubeInstance>& instances, glm::vec3 eye, GLfloat pixelsPerUnit,
+	GLfloat impostorStart, GLfloat meshEnd, std::vector<CubeInstance>& bucketed, GLuint* lodCounts, std::vector<CubeInstance>& impostors);
+GLfloat GetNearestInstanceDistance(const std::vector<CubeInstance>& instances, glm::vec3 eye);
 
 // function callbacks
 void KeyPressCB(GLFWwindow* window, int key, int scancode, int action, int mode);
@@ -49,8 +115,48 @@ GLfloat lastFrame = 0.0f;
 
 GLboolean firstMouse = true;
 
-int main()
+// when the GL state stats were last shown
+GLfloat lastStatsTime = 0.0f;
+
+// the cube field; I cycles the draw mode, +/- scale the count by 10
+GLuint cubeCount = MIN_CUBE_COUNT;
+GLuint cubeDrawMode = CUBE_DRAW_INSTANCED;
+GLboolean cubeFieldDirty = GL_TRUE;
+
+// L picks a detail level per object by its size on screen, M swaps the cubes for spheres with a real LOD chain.
+// the field's instance buffer is sorted by level while LOD is on; fieldOrderDirty asks for it to be rebuilt
+GLboolean lodEnabled = GL_TRUE;
+GLboolean sphereField = GL_FALSE;
+// P swaps distant objects for impostors while LOD is on
+GLboolean impostorsEnabled = GL_TRUE;
+GLboolean fieldOrderDirty = GL_TRUE;
+
+// CPU time spent submitting the field since the stats were last shown
+GLdouble submitTime = 0.0;
+GLuint submitFrames = 0;
+// and the whole frame, to weigh LOD on against LOD off
+GLdouble frameTime = 0.0;
+
+int main(int argc, char** argv)
 {
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// the number of cubes to start with can be given on the command line, and --loose ignores the asset bundle
+	bool loose = false;
+	for (int arg = 1; arg < argc; arg++) {
+		if (std::strcmp(argv[arg], "--loose") == 0) {
+			loose = true;
+			continue;
+		}
+		unsigned long requested = std::strtoul(argv[arg], nullptr, 10);
+		cubeCount = requested < MIN_CUBE_COUNT ? MIN_CUBE_COUNT : (requested > MAX_CUBE_COUNT ? MAX_CUBE_COUNT : (GLuint)requested);
+	}
+
+	// every loader looks in the bundle assetcook wrote before the loose files, if there is one
+	if (!loose && assetBundle.Open(ASSET_BUNDLE_PATH)) {
+		std::cout << "INFO: " << ASSET_BUNDLE_PATH << " mapped, " << assetBundle.GetEntryCount() << " entries" << std::endl;
+	}
+
 	GLfloat trigAVertices[] = {
 		 // positions		// colors
 		 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f,
@@ -115,246 +221,615 @@ int main()
 	GLuint trigAId;
 	GLuint rectAId;
 	GLuint cubeAId;
-	GLuint containerTexId;
-	GLuint awesomefaceTexId;
 
 	// boilerplate setup for GLFW window context and GLEW extension seeking
 	if (InitGLFWwindow() == -1 || InitGLEW() == -1) {
 		return -1;
 	}
-	
-	// setup our shader for use
-	Shader shader("./shader.vert", "./shader.frag");
-
-	// setup viewport width and height based on retrieved values from GLFW
-	int width, height;
-	glfwGetFramebufferSize(window, &width, &height);
-	glViewport(0, 0, width, height);
-
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	// Give a callback for handling keypresses
-	glfwSetKeyCallback(window, KeyPressCB);
-	glfwSetCursorPosCallback(window, MouseMovementCB);
-	glfwSetScrollCallback(window, ScrollCB);
-
-	// generate triangle VAOs
-	CreateTriangle(&trigAId, trigAVertices, sizeof(trigAVertices));
-
-	// generate rect VAO
-	CreateRect(&rectAId, rectAVertices, indices, sizeof(rectAVertices), sizeof(indices));
-
-	// generate cube VAO
-	CreateCube(&cubeAId, cubeAVertices, sizeof(cubeAVertices));
-
-	// setup textures
-	CreateTexture(&containerTexId, "./container.jpg", GL_REPEAT, GL_LINEAR);
-	CreateTexture(&awesomefaceTexId, "./awesomeface.png", GL_REPEAT, GL_LINEAR);
-
-	while (!glfwWindowShouldClose(window)) {
-		// calc deltaTime
-		GLfloat currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-
-		// check for events, such as a keypress
-		glfwPollEvents();
-		PerformKeyActions();
-
-		// Rendering commands here
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		shader.Use();
-
-		// set uniform mix value for the textures
-		glUniform1f(glGetUniformLocation(shader.GetProgramId(), "mixValue"), mixValue);
-
-		// setup multiple textures
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, containerTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture0"), 0);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, awesomefaceTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture1"), 1);
-
-		// setup cube positions
-		glm::vec3 cubePositions[] = {
-			glm::vec3( 0.0f,  0.0f,  0.0f),
-			glm::vec3( 2.0f,  5.0f, -15.0f),
-			glm::vec3(-3.8f, -2.0f, -12.3f),
-			glm::vec3(-1.5f, -2.2f, -2.5f),			
-			glm::vec3( 2.4f, -0.4f, -3.5f),
-			glm::vec3( 1.5f,  2.0f, -2.5f),
-			glm::vec3(-1.7f,  3.0f, -7.5f),
-			glm::vec3( 1.3f, -2.0f, -2.5f),
-			glm::vec3( 1.5f,  0.2f, -1.5f),
-			glm::vec3(-1.3f,  1.0f, -1.5f)
-		};
-
-		// setup projection transform
-		glm::mat4 projectionTransform;
-		projectionTransform = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width/height, 0.1f, 100.0f);
-
-		glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "view"), 1, GL_FALSE, glm::value_ptr(camera.GetViewMatrix()));
-		glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "projection"), 1, GL_FALSE, glm::value_ptr(projectionTransform));
-
-		// custom draw iteration for each position
-		glBindVertexArray(cubeAId);
-		for (GLuint i = 0; i < 10; i++) {
-			glm::mat4 modelTransform;
-			modelTransform = glm::translate(modelTransform, cubePositions[i]);
-			GLfloat angle = glm::radians(20.0f * (i + 1));
-			if (i % 2 == 0) {
-				modelTransform = glm::rotate(modelTransform, (GLfloat)glfwGetTime() * angle, glm::vec3(1.0f, 0.3f, 0.5f));
+
+	// everything that owns GL objects lives in here, so it's destroyed while there's still a context to destroy them in
+	{
+		// setup textures; they decode on the loader's workers while we build everything else, showing a placeholder until then
+		TextureLoader textureLoader;
+		textureLoader.SetBudget(TEXTURE_BUDGET);
+		// both cube textures are layers of one array, so cubes showing either draw together, off a single bind
+		TextureLoader::Handle cubeTextures = textureLoader.CreateArray(CUBE_TEXTURE_SIZE, 2, GL_REPEAT, GL_LINEAR);
+		GLubyte containerLayer = (GLubyte)textureLoader.LoadLayer(cubeTextures, "./container.jpg");
+		GLubyte awesomefaceLayer = (GLubyte)textureLoader.LoadLayer(cubeTextures, "./awesomeface.png");
+		std::cout << "INFO: decoding textures on " << textureLoader.GetWorkerCount() << " threads" << std::endl;
+
+		// view/projection live in one uniform buffer shared by every program
+		Shader::SetUniformBlockBinding(PER_FRAME_UNIFORM_BLOCK, PER_FRAME_UNIFORM_BINDING);
+		UniformBuffer<PerFrameUniforms> perFrameUniformBuffer(PER_FRAME_UNIFORM_BINDING);
+		// everything rewritten each frame is streamed through here
+		StreamBuffer frameStream(64 * 1024);
+
+		// submit our shader for compilation; it builds in the background while we load everything else
+		ShaderPermutations shaderPermutations("./shader.vert", "./shader.frag", GL_TRUE);
+		// pick up edits to shader.vert/shader.frag while we're running
+		shaderPermutations.Watch();
+		// the cubes have no color attribute, so they use the variants without USE_VERTEX_COLOR
+		Shader& shader = shaderPermutations.Get();
+		Shader& instancedShader = shaderPermutations.Get({ "USE_INSTANCING" });
+		// distant instances as cards textured from an atlas of baked views
+		ShaderPermutations impostorPermutations("./impostor.vert", "./impostor.frag", GL_TRUE);
+		impostorPermutations.Watch();
+		Shader& impostorShader = impostorPermutations.Get();
+
+		// setup viewport width and height based on retrieved values from GLFW
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		glViewport(0, 0, width, height);
+
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		// Give a callback for handling keypresses
+		glfwSetKeyCallback(window, KeyPressCB);
+		glfwSetCursorPosCallback(window, MouseMovementCB);
+		glfwSetScrollCallback(window, ScrollCB);
+
+		// one pool per vertex layout; every mesh in a pool shares its vertex buffer, index buffer and VAO
+		MeshPool coloredMeshes(ColoredVertex::Stride, &ColoredVertex::Apply, 64 * 1024, 16 * 1024);
+		MeshPool texturedMeshes(PackedTexturedVertex::Stride, &PackedTexturedVertex::Apply, 1024 * 1024, 256 * 1024);
+		MeshPool coloredTexturedMeshes(PackedColoredTexturedVertex::Stride, &PackedColoredTexturedVertex::Apply, 64 * 1024, 16 * 1024);
+
+		// generate triangle
+		CreateTriangle(&trigAId, coloredMeshes, trigAVertices, sizeof(trigAVertices));
+
+		// weld the literal vertex lists into indexed, cache-ordered meshes
+		IndexedMesh rectAMesh = OptimizeMesh("rect", rectAVertices, sizeof(rectAVertices) / (8 * sizeof(GLfloat)), 8, indices, sizeof(indices) / sizeof(GLuint));
+		IndexedMesh cubeAMesh = OptimizeMesh("cube", cubeAVertices, sizeof(cubeAVertices) / (5 * sizeof(GLfloat)), 5);
+
+		// generate rect
+		CreateRect(&rectAId, coloredTexturedMeshes, rectAMesh);
+
+		// generate cube, plus the per-instance buffer that feeds it the field
+		// cube.mesh (written by meshconvert from cube.obj) goes straight from the mapping into the pool
+		MeshFile cubeFile;
+		GLdouble loadStart = glfwGetTime();
+		if (cubeFile.Load("./cube.mesh") && cubeFile.Matches<PackedTexturedVertex>()) {
+			GLdouble uploadStart = glfwGetTime();
+			const MeshFileHeader& header = cubeFile.GetHeader();
+			texturedMeshes.AddPacked(&cubeAId, cubeFile.GetVertices(), header.VertexCount, cubeFile.GetIndices(), header.IndexCount, header.IndexType);
+			glm::vec3 extent;
+			for (GLuint c = 0; c < 3; c++) {
+				extent[c] = std::fabs(header.BoundsMin[c]) > std::fabs(header.BoundsMax[c]) ? std::fabs(header.BoundsMin[c]) : std::fabs(header.BoundsMax[c]);
 			}
-			else {
-				modelTransform = glm::rotate(modelTransform, angle, glm::vec3(1.0f, 0.3f, 0.5f));
+			texturedMeshes.SetRadius(cubeAId, glm::length(extent));
+			std::cout << "INFO: cube.mesh loaded in " << (uploadStart - loadStart) * 1000.0 << " ms, uploaded in " << (glfwGetTime() - uploadStart) * 1000.0 << " ms" << std::endl;
+		}
+		else {
+			CreateCube(&cubeAId, texturedMeshes, cubeAMesh);
+		}
+		GLuint cubeInstancesId;
+		CreateCubeInstances(texturedMeshes.GetVertexArrayId(), &cubeInstancesId);
+
+		// generate a sphere and its LOD chain; M puts it in the field in place of the cube
+		GLuint sphereId;
+		CreateLodSphere(&sphereId, texturedMeshes);
+
+		// an atlas per field mesh, baked once the programs are ready; the quads need no vertices, only the instances
+		ImpostorAtlas cubeImpostors;
+		ImpostorAtlas sphereImpostors;
+		GLuint impostorVaoId;
+		glGenVertexArrays(1, &impostorVaoId);
+		GLuint impostorInstancesId;
+		CreateCubeInstances(impostorVaoId, &impostorInstancesId);
+		// the atlases hold the textures as mixed when they were baked; the mix last frame says whether it's still changing
+		GLfloat impostorMixValue = -1.0f;
+		GLfloat lastMixValue = mixValue;
+
+		coloredMeshes.LogStats("colored");
+		texturedMeshes.LogStats("textured");
+		coloredTexturedMeshes.LogStats("colored textured");
+		std::vector<CubeInstance> cubeInstances;
+		GLfloat cubeFieldExtent = 0.0f;
+		// the field sorted by LOD, where each level starts in it, and what it all adds up to
+		std::vector<CubeInstance> lodInstances;
+		std::vector<CubeInstance> impostorInstances;
+		GLuint lodCounts[MAX_MESH_LODS];
+		GLuint fieldTriangles = 0;
+		glm::vec3 lodEye;
+		GLfloat lodZoom = 0.0f;
+		GLboolean lodImpostors = GL_FALSE;
+		// the closest any instance is to detailEye, which sets how much texture detail the field needs
+		glm::vec3 detailEye;
+		GLfloat nearestInstance = 0.0f;
+		GLboolean detailDirty = GL_TRUE;
+
+		// one command per cube, each picking its instance data by base instance
+		IndirectBatch cubeBatch(texturedMeshes);
+		cubeBatch.SetInstanceSource(cubeInstancesId, CubeInstanceLayout::Stride, &CubeInstanceLayout::ApplyFrom);
+		// one command per level for the instanced field while LOD is on, each covering a run of the sorted instances
+		IndirectBatch lodBatch(texturedMeshes);
+		lodBatch.SetInstanceSource(cubeInstancesId, CubeInstanceLayout::Stride, &CubeInstanceLayout::ApplyFrom);
+		std::cout << "INFO: indirect draws " << (IndirectBatch::IsMultiDrawSupported() ? "use glMultiDrawElementsIndirect" : "fall back to a loop of direct draws") << std::endl;
+
+		GLboolean cubeLayoutValidated = GL_FALSE;
+		GLboolean startupReported = GL_FALSE;
+
+		while (!glfwWindowShouldClose(window)) {
+			// calc deltaTime
+			GLfloat currentFrame = glfwGetTime();
+			deltaTime = currentFrame - lastFrame;
+			lastFrame = currentFrame;
+
+			// check for events, such as a keypress
+			glfwPollEvents();
+			PerformKeyActions();
+
+			// Rendering commands here
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			// bring up whatever the workers have finished decoding, a slice of it per frame
+			GLuint texturesLoaded = textureLoader.Update(TEXTURE_UPLOAD_BUDGET);
+
+			// keep presenting cleared frames until the programs have finished building
+			if (!shader.IsReady() || !instancedShader.IsReady() || !impostorShader.IsReady()) {
+				glfwSwapBuffers(window);
+				continue;
 			}
-			glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "model"), 1, GL_FALSE, glm::value_ptr(modelTransform));
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
+			// how long it took to have everything loaded, bundle or not; a second run shows it with the files cached
+			if (!startupReported && textureLoader.GetPendingCount() == 0) {
+				GLdouble startup = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - startTime).count();
+				std::cout << "INFO: everything loaded " << startup * 1000.0 << " ms after start, from " << (assetBundle.IsOpen() ? ASSET_BUNDLE_PATH : "loose files") << std::endl;
+				startupReported = GL_TRUE;
+			}
+
+			// swap in edited programs that finished compiling since last frame
+			bool shadersUpdated = shaderPermutations.Update();
+			impostorPermutations.Update();
+			if (shadersUpdated || !cubeLayoutValidated) {
+				// the programs' attributes are only known once they have linked
+				shader.ValidateVertexArray(texturedMeshes.GetVertexArrayId(), "textured mesh VAO");
+				instancedShader.ValidateVertexArray(texturedMeshes.GetVertexArrayId(), "instanced textured mesh VAO");
+				impostorShader.ValidateVertexArray(impostorVaoId, "impostor VAO");
+				cubeLayoutValidated = GL_TRUE;
+			}
+
+			// bake the impostors with the same program and textures as the meshes, again whenever either changes. a new mix
+			// waits until it has stopped changing, so holding UP/DOWN doesn't rebake both atlases every frame
+			bool mixSettled = mixValue == lastMixValue;
+			lastMixValue = mixValue;
+			if (shadersUpdated || (impostorMixValue != mixValue && mixSettled) || texturesLoaded > 0) {
+				// the field beyond the named cubes all wears the container, and only it gets far enough away for impostors
+				glm::vec2 fieldLayers(containerLayer, awesomefaceLayer);
+				BakeImpostor(&cubeImpostors, &cubeAId, texturedMeshes, shader, perFrameUniformBuffer, textureLoader, cubeTextures, fieldLayers);
+				BakeImpostor(&sphereImpostors, &sphereId, texturedMeshes, shader, perFrameUniformBuffer, textureLoader, cubeTextures, fieldLayers);
+				impostorMixValue = mixValue;
+			}
+
+			// regenerate the field only when its size changes
+			if (cubeFieldDirty) {
+				cubeFieldExtent = GenerateCubeField(cubeCount, containerLayer, awesomefaceLayer, cubeInstances);
+				cubeFieldDirty = GL_FALSE;
+				fieldOrderDirty = GL_TRUE;
+				detailDirty = GL_TRUE;
+			}
+
+			GLuint fieldMeshId = sphereField ? sphereId : cubeAId;
+			GLfloat pixelsPerUnit = MeshPool::GetPixelsPerUnit(glm::radians(camera.Zoom), height);
+
+			// the nearest instance sets the detail every cube's textures are streamed at; its diameter is a little more than
+			// a face, and it's taken LOD_REFRESH_DISTANCE nearer than it was, so the estimate errs sharp between refreshes
+			if (detailDirty || glm::length(camera.Position - detailEye) > LOD_REFRESH_DISTANCE) {
+				detailEye = camera.Position;
+				nearestInstance = GetNearestInstanceDistance(cubeInstances, detailEye);
+				detailDirty = GL_FALSE;
+			}
+			GLfloat detailDistance = std::max(nearestInstance - LOD_REFRESH_DISTANCE, 0.1f);
+			textureLoader.RequestDetail(cubeTextures, texturedMeshes.GetMesh(fieldMeshId).Radius * 2.0f * pixelsPerUnit / detailDistance);
+
+			// impostors ride on the LOD sort, so they only replace instances in the instanced and indirect modes
+			ImpostorAtlas& fieldImpostors = sphereField ? sphereImpostors : cubeImpostors;
+			GLboolean impostorsActive = impostorsEnabled && lodEnabled && cubeDrawMode != CUBE_DRAW_LOOPED && fieldImpostors.IsBaked();
+			GLfloat fadeStart = impostorsActive ? fieldImpostors.GetFadeStart(pixelsPerUnit) : 0.0f;
+			GLfloat fadeEnd = impostorsActive ? fieldImpostors.GetFadeEnd(pixelsPerUnit) : 0.0f;
+
+			// the GPU side of the field: sorted by LOD and drawn a level at a time, or in field order with everything at LOD 0.
+			// sorting means re-uploading every instance, so it only happens once the view has moved on far enough to matter
+			if (lodEnabled && cubeDrawMode != CUBE_DRAW_LOOPED &&
+				(fieldOrderDirty || glm::length(camera.Position - lodEye) > LOD_REFRESH_DISTANCE || camera.Zoom != lodZoom || impostorsActive != lodImpostors)) {
+				lodEye = camera.Position;
+				lodZoom = camera.Zoom;
+				lodImpostors = impostorsActive;
+				// the shaders crossfade by the live camera position, which may be up to LOD_REFRESH_DISTANCE from lodEye,
+				// so both sides of the band are widened by that much; otherwise objects could drop out of both
+				GLfloat impostorStart = impostorsActive ? fadeStart - LOD_REFRESH_DISTANCE : 0.0f;
+				GLfloat meshEnd = impostorsActive ? fadeEnd + LOD_REFRESH_DISTANCE : 0.0f;
+				fieldTriangles = BucketFieldByLod(texturedMeshes, fieldMeshId, cubeInstances, lodEye, pixelsPerUnit, impostorStart, meshEnd,
+					lodInstances, lodCounts, impostorInstances);
+				UploadCubeInstances(cubeInstancesId, lodInstances);
+				UploadCubeInstances(impostorInstancesId, impostorInstances);
+				fieldTriangles += (GLuint)impostorInstances.size() * 2;
+
+				lodBatch.Clear();
+				cubeBatch.Clear();
+				GLuint first = 0;
+				for (GLuint lod = 0; lod < MAX_MESH_LODS; lod++) {
+					if (lodCounts[lod] == 0) {
+						continue;
+					}
+					lodBatch.Add(fieldMeshId, lodCounts[lod], first, lod);
+					for (GLuint i = first; i < first + lodCounts[lod]; i++) {
+						cubeBatch.Add(fieldMeshId, 1, i, lod);
+					}
+					first += lodCounts[lod];
+				}
+				fieldOrderDirty = GL_FALSE;
+			}
+			else if (!lodEnabled && fieldOrderDirty) {
+				UploadCubeInstances(cubeInstancesId, cubeInstances);
+				cubeBatch.Clear();
+				for (GLuint i = 0; i < cubeCount; i++) {
+					cubeBatch.Add(fieldMeshId, 1, i);
+				}
+				fieldTriangles = cubeCount * (texturedMeshes.GetMesh(fieldMeshId).Lods[0].IndexCount / 3);
+				impostorInstances.clear();
+				fieldOrderDirty = GL_FALSE;
+			}
+
+			Shader& cubeShader = cubeDrawMode == CUBE_DRAW_LOOPED ? shader : instancedShader;
+			cubeShader.Use();
 
-		// deactivate shader program
-		glUseProgram(0);
+			// set uniform mix value for the textures
+			cubeShader.Set(UNIFORM("mixValue"), mixValue);
+			if (cubeDrawMode != CUBE_DRAW_LOOPED) {
+				cubeShader.Set(UNIFORM("impostorFadeStart"), fadeStart);
+				cubeShader.Set(UNIFORM("impostorFadeEnd"), fadeEnd);
+			}
 
-		// display results of rendering
-		glfwSwapBuffers(window);
+			// every cube's textures, whichever layers it picks
+			textureLoader.Bind(0, cubeTextures);
+			cubeShader.Set(UNIFORM("ourTextures"), 0);
+
+			// setup projection transform; the far plane grows with the field so big fields stay visible
+			glm::mat4 projectionTransform;
+			GLfloat farPlane = cubeFieldExtent * 2.0f > 100.0f ? cubeFieldExtent * 2.0f : 100.0f;
+			projectionTransform = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width/height, 0.1f, farPlane);
+
+			// one buffer write per frame, however many programs read it
+			PerFrameUniforms perFrame;
+			perFrame.View = camera.GetViewMatrix();
+			perFrame.Projection = projectionTransform;
+			perFrame.CameraPosition = camera.Position;
+			perFrame.Time = currentFrame;
+			frameStream.BeginFrame();
+			perFrameUniformBuffer.Update(perFrame, frameStream);
+			frameStream.Flush();
+
+			GLdouble submitStart = glfwGetTime();
+			GLuint drawCalls = 1;
+			GLuint triangles = fieldTriangles;
+			if (cubeDrawMode == CUBE_DRAW_INSTANCED && lodEnabled) {
+				// one instanced draw per level in use
+				drawCalls = lodBatch.Submit();
+			}
+			else if (cubeDrawMode == CUBE_DRAW_INSTANCED) {
+				// the whole field in one call, whatever its size
+				texturedMeshes.DrawInstanced(fieldMeshId, cubeCount);
+			}
+			else if (cubeDrawMode == CUBE_DRAW_INDIRECT) {
+				// still one draw per cube as far as the GPU is concerned, but one call from us
+				drawCalls = cubeBatch.Submit();
+			}
+			else {
+				drawCalls = cubeCount;
+				triangles = 0;
+				// custom draw iteration for each position; kept to compare against
+				for (GLuint i = 0; i < cubeCount; i++) {
+					glm::mat4 modelTransform = cubeInstances[i].Model;
+					if (cubeInstances[i].Spin != 0.0f) {
+						modelTransform = glm::rotate(modelTransform, currentFrame * cubeInstances[i].Spin, glm::vec3(1.0f, 0.3f, 0.5f));
+					}
+					shader.Set(UNIFORM("model"), modelTransform);
+					shader.Set(UNIFORM("textureLayers"), glm::vec2(cubeInstances[i].Layers[0], cubeInstances[i].Layers[1]));
+
+					GLuint lod = 0;
+					if (lodEnabled) {
+						lod = texturedMeshes.SelectLod(fieldMeshId, glm::length(glm::vec3(cubeInstances[i].Model[3]) - camera.Position), pixelsPerUnit);
+					}
+					triangles += texturedMeshes.GetMesh(fieldMeshId).Lods[lod].IndexCount / 3;
+					DrawCube(&fieldMeshId, texturedMeshes, lod);
+				}
+			}
+			if (impostorsActive && !impostorInstances.empty()) {
+				// every far object in one more call, however many there are
+				impostorShader.Use();
+				fieldImpostors.Apply(impostorShader, 2);
+				impostorShader.Set(UNIFORM("impostorFadeStart"), fadeStart);
+				impostorShader.Set(UNIFORM("impostorFadeEnd"), fadeEnd);
+				glState.BindVertexArray(impostorVaoId);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)impostorInstances.size());
+				drawCalls++;
+			}
+			submitTime += glfwGetTime() - submitStart;
+			submitFrames++;
+			frameTime += deltaTime;
+			frameStream.EndFrame();
+
+			// display results of rendering
+			glfwSwapBuffers(window);
+
+			// report how much redundant state the cache dropped, once a second
+			GLState::FrameStats stats = glState.EndFrame();
+			if (currentFrame - lastStatsTime >= 1.0f) {
+				lastStatsTime = currentFrame;
+				StreamBuffer::Stats streamStats = frameStream.GetStats();
+				TextureLoader::Stats textureStats = textureLoader.GetStats();
+				char title[512];
+				snprintf(title, sizeof(title), "LearnOpenGL - %u %s (%s, %u draw calls, LOD %s, %u impostors, %u triangles), submit %.3f ms, frame %.2f ms - GL state calls issued: %u, elided: %u - stream stalls: %u (%.2f ms) - textures: %.1f of %.0f MB, %u hits, %u misses, %u evictions, %u streamed in, %u out",
+					cubeCount, sphereField ? "spheres" : "cubes", CUBE_DRAW_MODE_NAMES[cubeDrawMode], drawCalls, lodEnabled ? "on" : "off",
+					impostorsActive ? (GLuint)impostorInstances.size() : 0, triangles,
+					submitTime * 1000.0 / submitFrames, frameTime * 1000.0 / submitFrames, stats.Issued, stats.Elided,
+					streamStats.Stalls, streamStats.StallTime * 1000.0, textureStats.ResidentBytes / (1024.0 * 1024.0), textureStats.Budget / (1024.0 * 1024.0),
+					textureStats.PathHits + textureStats.ContentHits, textureStats.Misses, textureStats.LevelsEvicted + textureStats.Unloads,
+					textureStats.StreamIns, textureStats.StreamOuts);
+				glfwSetWindowTitle(window, title);
+				submitTime = 0.0;
+				frameTime = 0.0;
+				submitFrames = 0;
+				frameStream.ResetStats();
+			}
+		}
 	}
 
 	glfwTerminate();
 	return 0;
 }
 
-void CreateTexture(GLuint *textureId, char* filename, GLenum wrapType, GLenum texFilterType)
+void CreateTriangle(GLuint* id, MeshPool& pool, GLfloat* vertices, GLuint size)
 {
-	glGenTextures(1, textureId);
-	glBindTexture(GL_TEXTURE_2D, *textureId);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapType);	// Set texture wrapping to GL_REPEAT (usually basic wrapping method)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapType);
-	// Set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texFilterType);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texFilterType);
-
-	int texWidth, texHeight;
-	unsigned char* image = SOIL_load_image(filename, &texWidth, &texHeight, 0, SOIL_LOAD_RGB);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	SOIL_free_image_data(image);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// a plain triangle list; index it in order so it can live in the pool with everything else
+	IndexedMesh mesh;
+	mesh.FloatsPerVertex = 6;
+	mesh.Vertices.assign(vertices, vertices + size / sizeof(GLfloat));
+	for (GLuint i = 0; i < mesh.GetVertexCount(); i++) {
+		mesh.Indices.push_back(i);
+	}
+
+	// position and color attributes, straight from the float array
+	std::vector<unsigned char> packedVertices;
+	ColoredVertex::Pack(mesh, { { POSITION, 0, 3 }, { COLOR, 3, 3 } }, packedVertices);
+	pool.Add(id, mesh, packedVertices);
 }
 
-void CreateTriangle(GLuint* id, GLfloat* vertices, GLuint size)
+void CreateCube(GLuint* id, MeshPool& pool, const IndexedMesh& mesh)
 {
-	glGenVertexArrays(1, id);
-
-	// we first need to bind the VAO
-	glBindVertexArray(*id);
-
-	// now generate, bind, and attribute our VBO
-	GLuint vboId;
-	glGenBuffers(1, &vboId);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+	// half positions and unorm16 texcoords; there's no color, so location 1 is simply left disabled
+	// (Shader::ValidateVertexArray checks this against the program once it has linked)
+	std::vector<unsigned char> packedVertices;
+	if (!PackedTexturedVertex::Pack(mesh, { { POSITION, 0, 3 }, { TEXCOORD, 3, 2 } }, packedVertices)) {
+		std::cout << "ERROR::MESH::PACK_FAILED\ncube" << std::endl;
+	}
+	LogPackedSize("cube", mesh, PackedTexturedVertex::Stride);
+	pool.Add(id, mesh, packedVertices);
+}
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+void CreateRect(GLuint* id, MeshPool& pool, const IndexedMesh& mesh)
+{
+	// half positions, unorm8 colors and unorm16 texcoords
+	std::vector<unsigned char> packedVertices;
+	if (!PackedColoredTexturedVertex::Pack(mesh, { { POSITION, 0, 3 }, { COLOR, 3, 3 }, { TEXCOORD, 6, 2 } }, packedVertices)) {
+		std::cout << "ERROR::MESH::PACK_FAILED\nrect" << std::endl;
+	}
+	LogPackedSize("rect", mesh, PackedColoredTexturedVertex::Stride);
+	pool.Add(id, mesh, packedVertices);
+}
 
-	// color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
+// a 64x32 UV sphere with its LOD chain, packed the same way as the cube
+void CreateLodSphere(GLuint* id, MeshPool& pool)
+{
+	IndexedMesh mesh = GenerateSphere(64, 32);
+	std::vector<MeshLod> lods = BuildLodChain(mesh);
+	for (GLuint lod = 0; lod < lods.size(); lod++) {
+		std::cout << "INFO: sphere LOD " << lod << ": " << lods[lod].Indices.size() / 3 << " triangles, error " << lods[lod].Error << std::endl;
+	}
 
-	// cleanup
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	std::vector<unsigned char> packedVertices;
+	if (!PackedTexturedVertex::Pack(mesh, { { POSITION, 0, 3 }, { TEXCOORD, 3, 2 } }, packedVertices)) {
+		std::cout << "ERROR::MESH::PACK_FAILED\nsphere" << std::endl;
+	}
+	LogPackedSize("sphere", mesh, PackedTexturedVertex::Stride);
+	pool.AddLods(id, mesh, lods, packedVertices);
+}
 
+// renders the mesh into every view of atlas with the plain textured program, sized to the mesh's bounds
+void BakeImpostor(ImpostorAtlas* atlas, GLuint* id, MeshPool& pool, Shader& shader, UniformBuffer<PerFrameUniforms>& perFrameUniformBuffer,
+	TextureLoader& textures, TextureLoader::Handle textureArray, glm::vec2 layers)
+{
+	shader.Use();
+	shader.Set(UNIFORM("mixValue"), mixValue);
+	shader.Set(UNIFORM("model"), glm::mat4());
+	textures.Bind(0, textureArray);
+	shader.Set(UNIFORM("ourTextures"), 0);
+	shader.Set(UNIFORM("textureLayers"), layers);
+
+	GLfloat radius = pool.GetMesh(*id).Radius;
+	atlas->Bake(radius > 0.0f ? radius : 1.0f, [&](const glm::mat4& view, const glm::mat4& projection) {
+		PerFrameUniforms perFrame;
+		perFrame.View = view;
+		perFrame.Projection = projection;
+		perFrame.CameraPosition = glm::vec3(0.0f);
+		perFrame.Time = 0.0f;
+		perFrameUniformBuffer.Update(perFrame);
+		pool.Draw(*id);
+	});
 }
 
-void CreateCube(GLuint* id, GLfloat* vertices, GLuint size)
+// fills instances with count cubes: the original ten, then a jittered grid behind them. every other named cube swaps
+// which texture layer is the base, to show the textures differing per instance within a draw.
+// returns roughly how far the field reaches from the origin
+GLfloat GenerateCubeField(GLuint count, GLubyte baseLayer, GLubyte overlayLayer, std::vector<CubeInstance>& instances)
 {
-	glGenVertexArrays(1, id);
+	const glm::vec3 cubePositions[] = {
+		glm::vec3( 0.0f,  0.0f,  0.0f),
+		glm::vec3( 2.0f,  5.0f, -15.0f),
+		glm::vec3(-3.8f, -2.0f, -12.3f),
+		glm::vec3(-1.5f, -2.2f, -2.5f),
+		glm::vec3( 2.4f, -0.4f, -3.5f),
+		glm::vec3( 1.5f,  2.0f, -2.5f),
+		glm::vec3(-1.7f,  3.0f, -7.5f),
+		glm::vec3( 1.3f, -2.0f, -2.5f),
+		glm::vec3( 1.5f,  0.2f, -1.5f),
+		glm::vec3(-1.3f,  1.0f, -1.5f)
+	};
+	const GLuint namedCubes = sizeof(cubePositions) / sizeof(cubePositions[0]);
+	const GLfloat spacing = 2.0f;
 
-	// we first need to bind the VAO
-	glBindVertexArray(*id);
+	GLuint side = 1;
+	while (side * side * side < count) {
+		side++;
+	}
 
-	// now generate, bind, and attribute our VBO
-	GLuint vboId;
-	glGenBuffers(1, &vboId);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+	instances.resize(count);
+	GLuint seed = 2166136261u;
+	for (GLuint i = 0; i < count; i++) {
+		glm::vec3 position;
+		if (i < namedCubes) {
+			position = cubePositions[i];
+		}
+		else {
+			// fixed seed, so the same count always gives the same field
+			GLuint cell = i - namedCubes;
+			seed = seed * 1664525u + 1013904223u;
+			glm::vec3 jitter = glm::vec3((seed & 0xFF) / 255.0f, ((seed >> 8) & 0xFF) / 255.0f, ((seed >> 16) & 0xFF) / 255.0f) - glm::vec3(0.5f);
+			position = glm::vec3(
+				((GLfloat)(cell % side) - side * 0.5f) * spacing,
+				((GLfloat)((cell / side) % side) - side * 0.5f) * spacing,
+				-20.0f - (GLfloat)(cell / (side * side)) * spacing) + jitter;
+		}
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+		// even cubes spin, odd ones sit at a fixed angle, as in the original ten
+		GLfloat angle = glm::radians(20.0f * ((i % namedCubes) + 1));
+		CubeInstance& instance = instances[i];
+		instance.Model = glm::translate(glm::mat4(), position);
+		if (i % 2 == 0) {
+			instance.Spin = angle;
+		}
+		else {
+			instance.Model = glm::rotate(instance.Model, angle, glm::vec3(1.0f, 0.3f, 0.5f));
+			instance.Spin = 0.0f;
+		}
 
-	// texture attribute; jump straight to 2 since we're omitting color but still targeting the same attribute location
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
+		// the named cubes stay untinted; the rest get a light random tint
+		for (GLuint c = 0; c < 3; c++) {
+			instance.Tint[c] = i < namedCubes ? 255 : (GLubyte)(160 + (seed >> (24 - c * 8)) % 96);
+		}
+		instance.Tint[3] = 255;
 
-	// cleanup
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GLboolean swapped = i < namedCubes && i % 2 == 1;
+		instance.Layers[0] = swapped ? overlayLayer : baseLayer;
+		instance.Layers[1] = swapped ? baseLayer : overlayLayer;
+		instance.Layers[2] = 0;
+		instance.Layers[3] = 0;
+	}
+
+	return 20.0f + side * spacing;
 }
 
-void CreateRect(GLuint* id, GLfloat* vertices, GLuint* indices, GLuint sizeVertices, GLuint sizeIndices)
+// attaches an instance buffer to the cube's VAO; one CubeInstance per instance.
+// every mesh in the same pool sees it too, which only matters to shaders that read it
+void CreateCubeInstances(GLuint vaoId, GLuint* instanceVboId)
 {
-	glGenVertexArrays(1, id);
+	glState.BindVertexArray(vaoId);
 
-	// we first need to bind the VAO
-	glBindVertexArray(*id);
+	glGenBuffers(1, instanceVboId);
+	glState.BindBuffer(GL_ARRAY_BUFFER, *instanceVboId);
+	CubeInstanceLayout::Apply(1);
 
-	// now generate, bind, and attribute our VBO
-	GLuint vboId;
-	glGenBuffers(1, &vboId);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferData(GL_ARRAY_BUFFER, sizeVertices, vertices, GL_STATIC_DRAW);
+	// cleanup
+	glState.BindVertexArray(0);
+	glState.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	GLuint eboId;
-	glGenBuffers(1, &eboId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeIndices, indices, GL_STATIC_DRAW);
+void UploadCubeInstances(GLuint instanceVboId, const std::vector<CubeInstance>& instances)
+{
+	glState.BindBuffer(GL_ARRAY_BUFFER, instanceVboId);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CubeInstance), instances.data(), GL_STATIC_DRAW);
+	glState.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+// sorts instances into bucketed by the LOD each one gets from eye, finest first, counting each level into lodCounts.
+// with meshEnd past impostorStart, instances from impostorStart on also go to impostors and those from meshEnd on
+// only go there. returns the triangles the meshes add up to
+GLuint BucketFieldByLod(MeshPool& pool, GLuint meshId, const std::vector<CubeInstance>& instances, glm::vec3 eye, GLfloat pixelsPerUnit,
+	GLfloat impostorStart, GLfloat meshEnd, std::vector<CubeInstance>& bucketed, GLuint* lodCounts, std::vector<CubeInstance>& impostors)
+{
+	// lods[i] == MAX_MESH_LODS marks an instance drawn only as an impostor
+	std::vector<GLubyte> lods(instances.size());
+	GLuint firsts[MAX_MESH_LODS];
+	for (GLuint lod = 0; lod < MAX_MESH_LODS; lod++) {
+		lodCounts[lod] = 0;
+	}
+	GLboolean useImpostors = meshEnd > impostorStart;
+	impostors.clear();
+	GLuint meshCount = 0;
+	for (size_t i = 0; i < instances.size(); i++) {
+		GLfloat distance = glm::length(glm::vec3(instances[i].Model[3]) - eye);
+		if (useImpostors && distance >= impostorStart) {
+			impostors.push_back(instances[i]);
+		}
+		if (useImpostors && distance >= meshEnd) {
+			lods[i] = MAX_MESH_LODS;
+			continue;
+		}
+		lods[i] = (GLubyte)pool.SelectLod(meshId, distance, pixelsPerUnit);
+		lodCounts[lods[i]]++;
+		meshCount++;
+	}
 
-	// color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
+	const MeshPool::Mesh& mesh = pool.GetMesh(meshId);
+	GLuint triangles = 0;
+	GLuint first = 0;
+	for (GLuint lod = 0; lod < MAX_MESH_LODS; lod++) {
+		firsts[lod] = first;
+		first += lodCounts[lod];
+		if (lod < mesh.LodCount) {
+			triangles += lodCounts[lod] * (mesh.Lods[lod].IndexCount / 3);
+		}
+	}
 
-	// texture attribute
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
+	bucketed.resize(meshCount);
+	for (size_t i = 0; i < instances.size(); i++) {
+		if (lods[i] < MAX_MESH_LODS) {
+			bucketed[firsts[lods[i]]++] = instances[i];
+		}
+	}
+	return triangles;
+}
 
-	// cleanup
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+GLfloat GetNearestInstanceDistance(const std::vector<CubeInstance>& instances, glm::vec3 eye)
+{
+	GLfloat nearest = std::numeric_limits<GLfloat>::max();
+	for (const CubeInstance& instance : instances) {
+		nearest = std::min(nearest, glm::length(glm::vec3(instance.Model[3]) - eye));
+	}
+	return nearest;
+}
 
+void LogPackedSize(const char* name, const IndexedMesh& mesh, GLsizei packedStride)
+{
+	size_t floatBytes = mesh.Vertices.size() * sizeof(GLfloat);
+	size_t packedBytes = (size_t)mesh.GetVertexCount() * packedStride;
+	std::cout << "INFO: " << name << " vertices " << floatBytes << " -> " << packedBytes << " bytes" << std::endl;
 }
 
-void DrawTriangle(GLuint* id)
+void DrawTriangle(GLuint* id, MeshPool& pool)
 {
-	glBindVertexArray(*id);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
-	glBindVertexArray(0);
+	// no unbind afterwards; the next draw rebinds only if it needs a different pool
+	pool.Draw(*id);
 }
 
-void DrawCube(GLuint* id)
+void DrawCube(GLuint* id, MeshPool& pool, GLuint lod)
 {
-	glBindVertexArray(*id);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	pool.Draw(*id, lod);
 }
 
-void DrawRect(GLuint* id)
+void DrawRect(GLuint* id, MeshPool& pool)
 {
-	glBindVertexArray(*id);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	pool.Draw(*id);
 }
 
 int InitGLEW()
@@ -367,18 +842,31 @@ int InitGLEW()
 
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
 
-	glEnable(GL_DEPTH_TEST);
+	// let the driver compile shaders on as many threads as it likes
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+	glState.Enable(GL_DEPTH_TEST);
+	return 0;
 }
 
 int InitGLFWwindow()
 {
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
-	window = glfwCreateWindow(800, 600, "LearnOpenGL", nullptr, nullptr);
+	// 4.3 gives us multi-draw indirect; 4.0 is all the samples strictly need (and all some drivers offer)
+	const int contextVersions[][2] = { { 4, 3 }, { 4, 0 } };
+	for (const auto& version : contextVersions) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+		window = glfwCreateWindow(800, 600, "LearnOpenGL", nullptr, nullptr);
+		if (window != nullptr) {
+			break;
+		}
+	}
 	if (window == nullptr) {
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -387,6 +875,7 @@ int InitGLFWwindow()
 
 
 	glfwMakeContextCurrent(window);
+	return 0;
 }
 
 void ScrollCB(GLFWwindow* window, double xoffset, double yoffset) {
@@ -413,6 +902,31 @@ void KeyPressCB(GLFWwindow* window, int key, int scancode, int action, int mode)
 {
 	if (action == GLFW_PRESS) {
 		keys[key] = true;
+
+		// one step per press rather than per frame
+		if (key == GLFW_KEY_I) {
+			cubeDrawMode = (cubeDrawMode + 1) % CUBE_DRAW_MODE_COUNT;
+		}
+		else if (key == GLFW_KEY_L) {
+			lodEnabled = !lodEnabled;
+			fieldOrderDirty = GL_TRUE;
+		}
+		else if (key == GLFW_KEY_M) {
+			sphereField = !sphereField;
+			fieldOrderDirty = GL_TRUE;
+		}
+		else if (key == GLFW_KEY_P) {
+			impostorsEnabled = !impostorsEnabled;
+			fieldOrderDirty = GL_TRUE;
+		}
+		else if ((key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) && cubeCount < MAX_CUBE_COUNT) {
+			cubeCount = cubeCount * 10 > MAX_CUBE_COUNT ? MAX_CUBE_COUNT : cubeCount * 10;
+			cubeFieldDirty = GL_TRUE;
+		}
+		else if ((key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) && cubeCount > MIN_CUBE_COUNT) {
+			cubeCount = cubeCount / 10 < MIN_CUBE_COUNT ? MIN_CUBE_COUNT : cubeCount / 10;
+			cubeFieldDirty = GL_TRUE;
+		}
 	}
 	else if (action == GLFW_RELEASE) {
 		keys[key] = false;
@@ -0,0 +1,138 @@
+#include "mappedfile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+	: Data(nullptr), Size(0)
+#ifdef _WIN32
+	, FileHandle(INVALID_HANDLE_VALUE), MappingHandle(nullptr)
+#else
+	, FileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	this->Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path)
+{
+	this->Close();
+
+	this->FileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (this->FileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(this->FileHandle, &size) || size.QuadPart == 0) {
+		this->Close();
+		return false;
+	}
+
+	this->MappingHandle = CreateFileMappingA(this->FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (this->MappingHandle == nullptr) {
+		std::cout << "ERROR::MAPPED_FILE::MAP_FAILED\n" << path << std::endl;
+		this->Close();
+		return false;
+	}
+
+	this->Data = (const unsigned char*)MapViewOfFile(this->MappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (this->Data == nullptr) {
+		std::cout << "ERROR::MAPPED_FILE::MAP_FAILED\n" << path << std::endl;
+		this->Close();
+		return false;
+	}
+
+	this->Size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (this->Data != nullptr) {
+		UnmapViewOfFile(this->Data);
+	}
+	if (this->MappingHandle != nullptr) {
+		CloseHandle(this->MappingHandle);
+	}
+	if (this->FileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(this->FileHandle);
+	}
+
+	this->Data = nullptr;
+	this->Size = 0;
+	this->MappingHandle = nullptr;
+	this->FileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+	this->Close();
+
+	this->FileDescriptor = open(path, O_RDONLY);
+	if (this->FileDescriptor == -1) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(this->FileDescriptor, &info) != 0 || info.st_size == 0) {
+		this->Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, this->FileDescriptor, 0);
+	if (data == MAP_FAILED) {
+		std::cout << "ERROR::MAPPED_FILE::MAP_FAILED\n" << path << std::endl;
+		this->Close();
+		return false;
+	}
+
+	// we read front to back, so let the OS read ahead aggressively
+	madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+	this->Data = (const unsigned char*)data;
+	this->Size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (this->Data != nullptr) {
+		munmap((void*)this->Data, this->Size);
+	}
+	if (this->FileDescriptor != -1) {
+		close(this->FileDescriptor);
+	}
+
+	this->Data = nullptr;
+	this->Size = 0;
+	this->FileDescriptor = -1;
+}
+
+#endif
+
+const unsigned char* MappedFile::GetData()
+{
+	return this->Data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return this->Size;
+}
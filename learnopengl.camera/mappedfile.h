@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+// a read-only memory mapping of a whole file; pages come in from the OS as they're touched,
+// so nothing is copied or parsed up front
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* path);
+	void Close();
+
+	const unsigned char* GetData();
+	size_t GetSize();
+
+private:
+	const unsigned char* Data;
+	size_t Size;
+#ifdef _WIN32
+	void* FileHandle;
+	void* MappingHandle;
+#else
+	int FileDescriptor;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
@@ -0,0 +1,591 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+GLuint IndexedMesh::GetVertexCount() const
+{
+	return (GLuint)(this->Vertices.size() / this->FloatsPerVertex);
+}
+
+GLenum IndexedMesh::GetIndexType() const
+{
+	return GetVertexCount() <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::vector<unsigned char> IndexedMesh::GetPackedIndices() const
+{
+	std::vector<unsigned char> packed;
+	if (GetIndexType() == GL_UNSIGNED_SHORT) {
+		packed.resize(this->Indices.size() * sizeof(GLushort));
+		GLushort* narrow = (GLushort*)packed.data();
+		for (size_t i = 0; i < this->Indices.size(); i++) {
+			narrow[i] = (GLushort)this->Indices[i];
+		}
+	}
+	else {
+		packed.resize(this->Indices.size() * sizeof(GLuint));
+		std::memcpy(packed.data(), this->Indices.data(), packed.size());
+	}
+	return packed;
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint>& indices, GLuint vertexCount, GLuint cacheSize)
+{
+	// FIFO of vertex indices; timestamps tell us whether a vertex is still inside it
+	std::vector<GLuint> cachedAt(vertexCount, 0);
+	GLuint misses = 0;
+
+	for (GLuint index : indices) {
+		if (cachedAt[index] == 0 || misses - cachedAt[index] >= cacheSize) {
+			misses++;
+			cachedAt[index] = misses;
+		}
+	}
+
+	// misses are counted from 1 so that 0 can mean "never seen"
+	VertexCacheStats stats;
+	stats.Acmr = indices.empty() ? 0.0f : (GLfloat)misses / (indices.size() / 3);
+	stats.Atvr = vertexCount == 0 ? 0.0f : (GLfloat)misses / vertexCount;
+	return stats;
+}
+
+IndexedMesh WeldVertices(const GLfloat* vertices, GLuint vertexCount, GLuint floatsPerVertex, const GLuint* indices, GLuint indexCount)
+{
+	IndexedMesh mesh;
+	mesh.FloatsPerVertex = floatsPerVertex;
+
+	// hash each vertex's bytes; equal hashes are confirmed with a full compare
+	const size_t vertexBytes = floatsPerVertex * sizeof(GLfloat);
+	std::unordered_multimap<size_t, GLuint> seen;
+	std::vector<GLuint> remap(vertexCount);
+
+	for (GLuint v = 0; v < vertexCount; v++) {
+		const unsigned char* bytes = (const unsigned char*)(vertices + v * floatsPerVertex);
+		size_t hash = 14695981039346656037ull;
+		for (size_t b = 0; b < vertexBytes; b++) {
+			hash = (hash ^ bytes[b]) * 1099511628211ull;
+		}
+
+		GLuint welded = (GLuint)-1;
+		auto range = seen.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (std::memcmp(&mesh.Vertices[it->second * floatsPerVertex], bytes, vertexBytes) == 0) {
+				welded = it->second;
+				break;
+			}
+		}
+
+		if (welded == (GLuint)-1) {
+			welded = mesh.GetVertexCount();
+			mesh.Vertices.insert(mesh.Vertices.end(), vertices + v * floatsPerVertex, vertices + (v + 1) * floatsPerVertex);
+			seen.insert(std::make_pair(hash, welded));
+		}
+		remap[v] = welded;
+	}
+
+	if (indices == nullptr) {
+		mesh.Indices = remap;
+	}
+	else {
+		mesh.Indices.resize(indexCount);
+		for (GLuint i = 0; i < indexCount; i++) {
+			mesh.Indices[i] = remap[indices[i]];
+		}
+	}
+
+	return mesh;
+}
+
+// Forsyth's vertex scoring: recently used vertices and vertices with few remaining
+// triangles score highest, so we finish off what's already in the cache
+static GLfloat ScoreVertex(GLuint cachePosition, GLuint activeTriangles)
+{
+	if (activeTriangles == 0) {
+		return -1.0f;
+	}
+
+	GLfloat score = 0.0f;
+	if (cachePosition < 3) {
+		// the last triangle's vertices get a fixed score so we don't favour one strip direction
+		score = 0.75f;
+	}
+	else if (cachePosition < VERTEX_CACHE_SIZE) {
+		score = std::pow(1.0f - (GLfloat)(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+	}
+
+	return score + 2.0f * std::pow((GLfloat)activeTriangles, -0.5f);
+}
+
+void OptimizeVertexCache(IndexedMesh& mesh)
+{
+	const GLuint vertexCount = mesh.GetVertexCount();
+	const GLuint triangleCount = (GLuint)(mesh.Indices.size() / 3);
+	const GLuint NOT_CACHED = 0xFFFFFFFF;
+
+	// triangle adjacency per vertex, packed into one array
+	std::vector<GLuint> activeTriangles(vertexCount, 0);
+	for (GLuint index : mesh.Indices) {
+		activeTriangles[index]++;
+	}
+	std::vector<GLuint> adjacencyOffset(vertexCount + 1, 0);
+	for (GLuint v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + activeTriangles[v];
+	}
+	std::vector<GLuint> adjacency(mesh.Indices.size());
+	std::vector<GLuint> filled(vertexCount, 0);
+	for (GLuint t = 0; t < triangleCount; t++) {
+		for (GLuint k = 0; k < 3; k++) {
+			GLuint v = mesh.Indices[t * 3 + k];
+			adjacency[adjacencyOffset[v] + filled[v]++] = t;
+		}
+	}
+
+	std::vector<GLuint> cachePosition(vertexCount, NOT_CACHED);
+	std::vector<GLfloat> vertexScore(vertexCount);
+	for (GLuint v = 0; v < vertexCount; v++) {
+		vertexScore[v] = ScoreVertex(NOT_CACHED, activeTriangles[v]);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLfloat> triangleScore(triangleCount);
+	for (GLuint t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[mesh.Indices[t * 3]] + vertexScore[mesh.Indices[t * 3 + 1]] + vertexScore[mesh.Indices[t * 3 + 2]];
+	}
+
+	std::vector<GLuint> cache, nextCache;
+	std::vector<GLuint> optimized;
+	optimized.reserve(mesh.Indices.size());
+	GLuint bestTriangle = NOT_CACHED;
+	GLuint scanStart = 0;
+
+	while (optimized.size() < mesh.Indices.size()) {
+		// no candidate from the cache; fall back to the best remaining triangle
+		if (bestTriangle == NOT_CACHED) {
+			GLfloat bestScore = -1.0f;
+			for (GLuint t = scanStart; t < triangleCount; t++) {
+				if (!emitted[t] && triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+			while (scanStart < triangleCount && emitted[scanStart]) {
+				scanStart++;
+			}
+		}
+
+		// emit it and pull its vertices to the front of the cache
+		emitted[bestTriangle] = true;
+		nextCache.clear();
+		for (GLuint k = 0; k < 3; k++) {
+			GLuint v = mesh.Indices[bestTriangle * 3 + k];
+			optimized.push_back(v);
+			nextCache.push_back(v);
+
+			// drop the triangle from the vertex's active list
+			GLuint* begin = &adjacency[adjacencyOffset[v]];
+			GLuint* end = begin + activeTriangles[v];
+			for (GLuint* it = begin; it != end; ++it) {
+				if (*it == bestTriangle) {
+					*it = *(end - 1);
+					break;
+				}
+			}
+			activeTriangles[v]--;
+		}
+		for (GLuint v : cache) {
+			if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2]) {
+				nextCache.push_back(v);
+			}
+		}
+
+		// rescore everything whose cache position changed, including what fell out
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			GLuint v = nextCache[i];
+			cachePosition[v] = i < VERTEX_CACHE_SIZE ? (GLuint)i : NOT_CACHED;
+			vertexScore[v] = ScoreVertex(cachePosition[v], activeTriangles[v]);
+		}
+		if (nextCache.size() > VERTEX_CACHE_SIZE) {
+			nextCache.resize(VERTEX_CACHE_SIZE);
+		}
+		cache.swap(nextCache);
+
+		// the next triangle is the best one touching the cache
+		bestTriangle = NOT_CACHED;
+		GLfloat bestScore = -1.0f;
+		for (GLuint v : cache) {
+			for (GLuint i = 0; i < activeTriangles[v]; i++) {
+				GLuint t = adjacency[adjacencyOffset[v] + i];
+				triangleScore[t] = vertexScore[mesh.Indices[t * 3]] + vertexScore[mesh.Indices[t * 3 + 1]] + vertexScore[mesh.Indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	mesh.Indices.swap(optimized);
+}
+
+void OptimizeVertexFetch(IndexedMesh& mesh)
+{
+	const GLuint vertexCount = mesh.GetVertexCount();
+	const GLuint UNASSIGNED = 0xFFFFFFFF;
+	std::vector<GLuint> remap(vertexCount, UNASSIGNED);
+	std::vector<GLfloat> vertices;
+	vertices.reserve(mesh.Vertices.size());
+
+	for (GLuint& index : mesh.Indices) {
+		if (remap[index] == UNASSIGNED) {
+			remap[index] = (GLuint)(vertices.size() / mesh.FloatsPerVertex);
+			vertices.insert(vertices.end(), mesh.Vertices.begin() + index * mesh.FloatsPerVertex, mesh.Vertices.begin() + (index + 1) * mesh.FloatsPerVertex);
+		}
+		index = remap[index];
+	}
+
+	// unreferenced vertices are dropped
+	mesh.Vertices.swap(vertices);
+}
+
+IndexedMesh OptimizeMesh(const char* name, const GLfloat* vertices, GLuint vertexCount, GLuint floatsPerVertex, const GLuint* indices, GLuint indexCount)
+{
+	std::vector<GLuint> originalIndices;
+	if (indices == nullptr) {
+		for (GLuint i = 0; i < vertexCount; i++) {
+			originalIndices.push_back(i);
+		}
+	}
+	else {
+		originalIndices.assign(indices, indices + indexCount);
+	}
+	VertexCacheStats before = AnalyzeVertexCache(originalIndices, vertexCount);
+
+	IndexedMesh mesh = WeldVertices(vertices, vertexCount, floatsPerVertex, indices, indexCount);
+	OptimizeVertexCache(mesh);
+	OptimizeVertexFetch(mesh);
+	VertexCacheStats after = AnalyzeVertexCache(mesh.Indices, mesh.GetVertexCount());
+
+	std::cout << "INFO: Mesh " << name << ": " << vertexCount << " -> " << mesh.GetVertexCount() << " vertices, "
+		<< (mesh.GetIndexType() == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices, ACMR "
+		<< before.Acmr << " -> " << after.Acmr << ", ATVR " << before.Atvr << " -> " << after.Atvr << std::endl;
+
+	return mesh;
+}
+
+// a symmetric 4x4 plane quadric: xx xy xz xw yy yz yw zz zw ww
+struct Quadric
+{
+	double Q[10];
+};
+
+static void AddPlane(Quadric& quadric, double a, double b, double c, double d)
+{
+	double plane[4] = { a, b, c, d };
+	GLuint k = 0;
+	for (GLuint i = 0; i < 4; i++) {
+		for (GLuint j = i; j < 4; j++) {
+			quadric.Q[k++] += plane[i] * plane[j];
+		}
+	}
+}
+
+static double EvaluateQuadric(const Quadric& a, const Quadric& b, const GLfloat* p)
+{
+	double v[4] = { p[0], p[1], p[2], 1.0 };
+	double error = 0.0;
+	GLuint k = 0;
+	for (GLuint i = 0; i < 4; i++) {
+		for (GLuint j = i; j < 4; j++, k++) {
+			error += (a.Q[k] + b.Q[k]) * v[i] * v[j] * (i == j ? 1.0 : 2.0);
+		}
+	}
+	return error < 0.0 ? 0.0 : error;
+}
+
+static void TriangleNormal(const GLfloat* a, const GLfloat* b, const GLfloat* c, double* normal)
+{
+	double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+std::vector<GLuint> SimplifyMesh(const IndexedMesh& mesh, const std::vector<GLuint>& indices, GLuint targetIndexCount,
+	std::vector<GLuint>& collapsedInto, GLfloat* error)
+{
+	const GLuint vertexCount = mesh.GetVertexCount();
+	const GLuint stride = mesh.FloatsPerVertex;
+	std::vector<GLuint> result = indices;
+	if (collapsedInto.size() != vertexCount) {
+		collapsedInto.resize(vertexCount);
+		for (GLuint v = 0; v < vertexCount; v++) {
+			collapsedInto[v] = v;
+		}
+	}
+
+	// vertices at the same position but with different attributes sit on a seam; moving them would tear it open
+	std::unordered_map<std::string, GLuint> positions;
+	std::vector<GLuint> positionId(vertexCount);
+	std::vector<GLuint> sharing;
+	for (GLuint v = 0; v < vertexCount; v++) {
+		std::string key((const char*)&mesh.Vertices[v * stride], 3 * sizeof(GLfloat));
+		auto found = positions.insert(std::make_pair(key, (GLuint)sharing.size()));
+		if (found.second) {
+			sharing.push_back(0);
+		}
+		positionId[v] = found.first->second;
+		sharing[positionId[v]]++;
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+	for (GLuint v = 0; v < vertexCount; v++) {
+		locked[v] = sharing[positionId[v]] > 1;
+	}
+
+	// so do border vertices: an edge (by position) with only one triangle on it
+	std::unordered_map<GLuint64, GLuint> edgeUse;
+	for (size_t t = 0; t < result.size(); t += 3) {
+		for (GLuint e = 0; e < 3; e++) {
+			GLuint a = positionId[result[t + e]], b = positionId[result[t + (e + 1) % 3]];
+			edgeUse[a < b ? ((GLuint64)a << 32) | b : ((GLuint64)b << 32) | a]++;
+		}
+	}
+	for (size_t t = 0; t < result.size(); t += 3) {
+		for (GLuint e = 0; e < 3; e++) {
+			GLuint a = positionId[result[t + e]], b = positionId[result[t + (e + 1) % 3]];
+			if (edgeUse[a < b ? ((GLuint64)a << 32) | b : ((GLuint64)b << 32) | a] == 1) {
+				locked[result[t + e]] = locked[result[t + (e + 1) % 3]] = true;
+			}
+		}
+	}
+
+	// every vertex starts with the planes of the triangles around it
+	std::vector<Quadric> quadrics(vertexCount);
+	std::memset(quadrics.data(), 0, vertexCount * sizeof(Quadric));
+	for (size_t t = 0; t < result.size(); t += 3) {
+		const GLfloat* p[3] = { &mesh.Vertices[result[t] * stride], &mesh.Vertices[result[t + 1] * stride], &mesh.Vertices[result[t + 2] * stride] };
+		double n[3];
+		TriangleNormal(p[0], p[1], p[2], n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0) {
+			continue;
+		}
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+		for (GLuint c = 0; c < 3; c++) {
+			AddPlane(quadrics[result[t + c]], n[0], n[1], n[2], d);
+		}
+	}
+
+	struct Collapse
+	{
+		GLuint From;
+		GLuint To;
+		double Error;
+	};
+
+	// passes of independent collapses, cheapest first, until we hit the target or nothing more can go
+	while (result.size() > targetIndexCount) {
+		// triangles around each vertex
+		std::vector<GLuint> firstTriangle(vertexCount + 1, 0), triangles(result.size());
+		for (GLuint index : result) {
+			firstTriangle[index + 1]++;
+		}
+		for (GLuint v = 0; v < vertexCount; v++) {
+			firstTriangle[v + 1] += firstTriangle[v];
+		}
+		std::vector<GLuint> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			triangles[fill[result[i]]++] = (GLuint)(i / 3);
+		}
+
+		std::vector<Collapse> collapses;
+		for (size_t t = 0; t < result.size(); t += 3) {
+			for (GLuint e = 0; e < 3; e++) {
+				GLuint a = result[t + e], b = result[t + (e + 1) % 3];
+				if (!locked[a]) {
+					Collapse collapse = { a, b, EvaluateQuadric(quadrics[a], quadrics[b], &mesh.Vertices[b * stride]) };
+					collapses.push_back(collapse);
+				}
+				if (!locked[b]) {
+					Collapse collapse = { b, a, EvaluateQuadric(quadrics[a], quadrics[b], &mesh.Vertices[a * stride]) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.Error < y.Error; });
+
+		std::vector<bool> touched(vertexCount, false);
+		size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+		size_t removed = 0;
+		for (const Collapse& collapse : collapses) {
+			if (removed >= trianglesToRemove || (removed > 0 && removed * 3 >= result.size() / 4)) {
+				break;
+			}
+			if (touched[collapse.From] || touched[collapse.To]) {
+				continue;
+			}
+
+			// refuse collapses that would flip a surviving triangle over
+			bool flips = false;
+			size_t dying = 0;
+			for (GLuint i = firstTriangle[collapse.From]; i < firstTriangle[collapse.From + 1] && !flips; i++) {
+				GLuint* triangle = &result[triangles[i] * 3];
+				if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) {
+					dying++;
+					continue;
+				}
+				const GLfloat* before[3];
+				const GLfloat* after[3];
+				for (GLuint c = 0; c < 3; c++) {
+					before[c] = &mesh.Vertices[triangle[c] * stride];
+					after[c] = triangle[c] == collapse.From ? &mesh.Vertices[collapse.To * stride] : before[c];
+				}
+				double n0[3], n1[3];
+				TriangleNormal(before[0], before[1], before[2], n0);
+				TriangleNormal(after[0], after[1], after[2], n1);
+				flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0;
+			}
+			if (flips) {
+				continue;
+			}
+
+			// move every reference over, and keep the neighbourhood fixed for the rest of this pass
+			for (GLuint i = firstTriangle[collapse.From]; i < firstTriangle[collapse.From + 1]; i++) {
+				GLuint* triangle = &result[triangles[i] * 3];
+				for (GLuint c = 0; c < 3; c++) {
+					touched[triangle[c]] = true;
+					if (triangle[c] == collapse.From) {
+						triangle[c] = collapse.To;
+					}
+				}
+			}
+			for (GLuint k = 0; k < 10; k++) {
+				quadrics[collapse.To].Q[k] += quadrics[collapse.From].Q[k];
+			}
+			collapsedInto[collapse.From] = collapse.To;
+			removed += dying;
+		}
+
+		// drop the triangles that collapsed to slivers
+		size_t write = 0;
+		for (size_t t = 0; t < result.size(); t += 3) {
+			if (result[t] != result[t + 1] && result[t + 1] != result[t + 2] && result[t] != result[t + 2]) {
+				result[write++] = result[t];
+				result[write++] = result[t + 1];
+				result[write++] = result[t + 2];
+			}
+		}
+		result.resize(write);
+
+		if (removed == 0) {
+			break;
+		}
+	}
+
+	// the quadric orders collapses, but sums squares over every plane merged in. what the level is measured by is how
+	// far each original vertex now is from the one it ended up on, following it through every pass and every level
+	// before this one; a single collapse's distance would miss the chains
+	double largestError = 0.0;
+	for (GLuint v = 0; v < vertexCount; v++) {
+		GLuint last = v;
+		while (collapsedInto[last] != last) {
+			last = collapsedInto[last];
+		}
+		// short-circuit the chain for the next level
+		collapsedInto[v] = last;
+
+		const GLfloat* from = &mesh.Vertices[v * stride];
+		const GLfloat* to = &mesh.Vertices[last * stride];
+		double distance = std::sqrt((double)(from[0] - to[0]) * (from[0] - to[0]) + (double)(from[1] - to[1]) * (from[1] - to[1]) + (double)(from[2] - to[2]) * (from[2] - to[2]));
+		largestError = distance > largestError ? distance : largestError;
+	}
+
+	*error = (GLfloat)largestError;
+	return result;
+}
+
+std::vector<MeshLod> BuildLodChain(const IndexedMesh& mesh, GLuint maxLods)
+{
+	std::vector<MeshLod> lods(1);
+	lods[0].Indices = mesh.Indices;
+	lods[0].Error = 0.0f;
+
+	IndexedMesh level = mesh;
+	std::vector<GLuint> collapsedInto;
+	while (lods.size() < maxLods) {
+		const MeshLod& previous = lods.back();
+		GLuint target = (GLuint)(previous.Indices.size() / 6 * 3);
+		GLfloat error;
+		std::vector<GLuint> indices = SimplifyMesh(mesh, previous.Indices, target, collapsedInto, &error);
+
+		// stop once a level barely shrinks; the rest of the chain would just repeat it
+		if (indices.empty() || indices.size() * 10 > previous.Indices.size() * 9) {
+			break;
+		}
+
+		level.Indices = indices;
+		OptimizeVertexCache(level);
+
+		MeshLod lod;
+		lod.Indices = level.Indices;
+		lod.Error = error;
+		lods.push_back(lod);
+	}
+
+	return lods;
+}
+
+GLfloat GetBoundingRadius(const IndexedMesh& mesh)
+{
+	GLfloat radius = 0.0f;
+	for (GLuint v = 0; v < mesh.GetVertexCount(); v++) {
+		const GLfloat* p = &mesh.Vertices[v * mesh.FloatsPerVertex];
+		GLfloat length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		radius = length > radius ? length : radius;
+	}
+	return radius;
+}
+
+IndexedMesh GenerateSphere(GLuint slices, GLuint stacks)
+{
+	IndexedMesh mesh;
+	mesh.FloatsPerVertex = 5;
+
+	const GLfloat pi = 3.14159265f;
+	for (GLuint stack = 0; stack <= stacks; stack++) {
+		GLfloat phi = pi * stack / stacks;
+		for (GLuint slice = 0; slice <= slices; slice++) {
+			GLfloat theta = 2.0f * pi * slice / slices;
+			// the last column repeats the first with u = 1, which is the seam
+			GLfloat x = (slice == slices) ? std::sin(phi) : std::sin(phi) * std::cos(theta);
+			GLfloat z = (slice == slices) ? 0.0f : std::sin(phi) * std::sin(theta);
+			GLfloat y = std::cos(phi);
+			mesh.Vertices.insert(mesh.Vertices.end(), { 0.5f * x, 0.5f * y, 0.5f * z, (GLfloat)slice / slices, 1.0f - (GLfloat)stack / stacks });
+		}
+	}
+
+	for (GLuint stack = 0; stack < stacks; stack++) {
+		for (GLuint slice = 0; slice < slices; slice++) {
+			GLuint a = stack * (slices + 1) + slice;
+			GLuint b = a + slices + 1;
+			// the pole rows would only give degenerate triangles
+			if (stack != 0) {
+				mesh.Indices.insert(mesh.Indices.end(), { a, b, a + 1 });
+			}
+			if (stack != stacks - 1) {
+				mesh.Indices.insert(mesh.Indices.end(), { a + 1, b, b + 1 });
+			}
+		}
+	}
+
+	OptimizeVertexCache(mesh);
+	OptimizeVertexFetch(mesh);
+	return mesh;
+}
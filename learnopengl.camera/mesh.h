@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// post-transform cache size we optimise for and measure against
+const GLuint VERTEX_CACHE_SIZE = 32;
+// the most detail levels a mesh keeps, LOD 0 included
+const GLuint MAX_MESH_LODS = 8;
+
+// an indexed triangle list with interleaved float vertices
+struct IndexedMesh
+{
+	std::vector<GLfloat> Vertices;
+	GLuint FloatsPerVertex;
+	std::vector<GLuint> Indices;
+
+	GLuint GetVertexCount() const;
+
+	// the smallest index type that can address every vertex
+	GLenum GetIndexType() const;
+
+	// the indices narrowed to GetIndexType(), ready for glBufferData
+	std::vector<unsigned char> GetPackedIndices() const;
+};
+
+// how well an index order reuses the post-transform vertex cache
+struct VertexCacheStats
+{
+	// average cache miss ratio: vertices transformed per triangle (0.5 is ideal, 3.0 is worst)
+	GLfloat Acmr;
+	// average transform to vertex ratio: vertices transformed per unique vertex (1.0 is ideal)
+	GLfloat Atvr;
+};
+
+// simulates a FIFO post-transform cache over the index list
+VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint>& indices, GLuint vertexCount, GLuint cacheSize = VERTEX_CACHE_SIZE);
+
+// merges bit-identical vertices; indices may be null for a plain triangle list
+IndexedMesh WeldVertices(const GLfloat* vertices, GLuint vertexCount, GLuint floatsPerVertex, const GLuint* indices = nullptr, GLuint indexCount = 0);
+
+// reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm)
+void OptimizeVertexCache(IndexedMesh& mesh);
+
+// reorders vertices into first-use order so fetches walk memory forwards
+void OptimizeVertexFetch(IndexedMesh& mesh);
+
+// weld, cache and fetch optimisation in one go, printing the before/after cache stats
+IndexedMesh OptimizeMesh(const char* name, const GLfloat* vertices, GLuint vertexCount, GLuint floatsPerVertex, const GLuint* indices = nullptr, GLuint indexCount = 0);
+
+// one detail level: indices into the full mesh's vertices, and how far (in object space) it may stray from LOD 0
+struct MeshLod
+{
+	std::vector<GLuint> Indices;
+	GLfloat Error;
+};
+
+// quadric error metric simplification of a triangle list over mesh's vertices (positions are the first three floats),
+// down to at most targetIndexCount indices where it can. vertices only ever collapse onto a neighbour, so the result
+// indexes the same vertex buffer; border and attribute seam vertices never move. collapsedInto maps each vertex to the
+// one standing in for it (itself if it hasn't moved); pass it from level to level, empty to start. error gets the
+// farthest any vertex of the full mesh is from where it ended up
+std::vector<GLuint> SimplifyMesh(const IndexedMesh& mesh, const std::vector<GLuint>& indices, GLuint targetIndexCount,
+	std::vector<GLuint>& collapsedInto, GLfloat* error);
+
+// LOD 0 is the mesh itself; each level after halves the triangles of the one before, until simplification stalls
+std::vector<MeshLod> BuildLodChain(const IndexedMesh& mesh, GLuint maxLods = MAX_MESH_LODS);
+
+// the distance from the origin to the farthest position
+GLfloat GetBoundingRadius(const IndexedMesh& mesh);
+
+// a UV sphere of radius 0.5 with positions and texcoords, the same size as the cube
+IndexedMesh GenerateSphere(GLuint slices, GLuint stacks);
@@ -0,0 +1,22 @@
+#include <cstring>
+#include <iostream>
+
+#include "meshfile.h"
+
+// converts a Wavefront OBJ into the binary mesh format the samples load
+int main(int argc, char** argv)
+{
+	bool compress = false;
+	int arg = 1;
+	if (arg < argc && std::strcmp(argv[arg], "-z") == 0) {
+		compress = true;
+		arg++;
+	}
+
+	if (argc - arg != 2) {
+		std::cout << "usage: meshconvert [-z] input.obj output.mesh\n  -z  delta code the vertex and index streams" << std::endl;
+		return 1;
+	}
+
+	return ConvertObjToMeshFile(argv[arg], argv[arg + 1], compress) ? 0 : 1;
+}
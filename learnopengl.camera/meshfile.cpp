@@ -0,0 +1,445 @@
+#include "meshfile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// vertices per bit-packed group in the vertex codec
+const GLuint VERTEX_CODEC_GROUP = 16;
+
+static GLuint GetIndexSize(GLenum indexType)
+{
+	return indexType == GL_UNSIGNED_BYTE ? 1 : (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+static GLuint64 AlignUp(GLuint64 offset)
+{
+	return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+MeshFile::MeshFile()
+	: Vertices(nullptr), Indices(nullptr)
+{
+	std::memset(&this->Header, 0, sizeof(this->Header));
+}
+
+bool MeshFile::Load(const char* path)
+{
+	const AssetBundleEntry* entry = assetBundle.Find(path, ASSET_MESH_FILE);
+	if (entry != nullptr) {
+		const unsigned char* data = assetBundle.GetData(*entry, this->Unpacked);
+		return data != nullptr && this->Load(data, (size_t)entry->UnpackedBytes, path);
+	}
+	if (!this->File.Open(path)) {
+		return false;
+	}
+	return this->Load(this->File.GetData(), this->File.GetSize(), path);
+}
+
+bool MeshFile::Load(const unsigned char* data, size_t size, const char* path)
+{
+	if (size < sizeof(MeshFileHeader)) {
+		std::cout << "ERROR::MESH_FILE::TRUNCATED\n" << path << std::endl;
+		return false;
+	}
+
+	std::memcpy(&this->Header, data, sizeof(MeshFileHeader));
+	const MeshFileHeader& header = this->Header;
+	if (header.Magic != MESH_FILE_MAGIC || header.Version != MESH_FILE_VERSION) {
+		std::cout << "ERROR::MESH_FILE::BAD_HEADER\n" << path << std::endl;
+		return false;
+	}
+
+	size_t attributesEnd = sizeof(MeshFileHeader) + header.AttributeCount * sizeof(VertexAttributeDesc);
+	if (attributesEnd > size || header.VertexOffset + header.VertexBytes > size || header.IndexOffset + header.IndexBytes > size) {
+		std::cout << "ERROR::MESH_FILE::TRUNCATED\n" << path << std::endl;
+		return false;
+	}
+	this->Attributes.resize(header.AttributeCount);
+	std::memcpy(this->Attributes.data(), data + sizeof(MeshFileHeader), header.AttributeCount * sizeof(VertexAttributeDesc));
+
+	GLuint64 vertexBytes = (GLuint64)header.VertexCount * header.VertexStride;
+	GLuint64 indexBytes = (GLuint64)header.IndexCount * GetIndexSize(header.IndexType);
+	auto decodeStart = std::chrono::high_resolution_clock::now();
+	bool decoded = false;
+
+	if (header.VertexCodec == MESH_CODEC_RAW && header.VertexBytes == vertexBytes) {
+		this->Vertices = data + header.VertexOffset;
+	}
+	else if (header.VertexCodec == MESH_CODEC_DELTA) {
+		this->DecodedVertices.resize(vertexBytes);
+		if (!DecodeVertexStream(data + header.VertexOffset, header.VertexBytes, header.VertexCount, header.VertexStride, this->DecodedVertices.data())) {
+			std::cout << "ERROR::MESH_FILE::BAD_VERTEX_STREAM\n" << path << std::endl;
+			return false;
+		}
+		this->Vertices = this->DecodedVertices.data();
+		decoded = true;
+	}
+	else {
+		std::cout << "ERROR::MESH_FILE::BAD_VERTEX_STREAM\n" << path << std::endl;
+		return false;
+	}
+
+	if (header.IndexCodec == MESH_CODEC_RAW && header.IndexBytes == indexBytes) {
+		this->Indices = data + header.IndexOffset;
+	}
+	else if (header.IndexCodec == MESH_CODEC_DELTA) {
+		this->DecodedIndices.resize(indexBytes);
+		if (!DecodeIndexStream(data + header.IndexOffset, header.IndexBytes, header.IndexCount, header.IndexType, this->DecodedIndices.data())) {
+			std::cout << "ERROR::MESH_FILE::BAD_INDEX_STREAM\n" << path << std::endl;
+			return false;
+		}
+		this->Indices = this->DecodedIndices.data();
+		decoded = true;
+	}
+	else {
+		std::cout << "ERROR::MESH_FILE::BAD_INDEX_STREAM\n" << path << std::endl;
+		return false;
+	}
+
+	if (decoded) {
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - decodeStart).count();
+		double megabytes = (vertexBytes + indexBytes) / (1024.0 * 1024.0);
+		std::cout << "INFO: Mesh file " << path << ": decoded " << header.VertexBytes + header.IndexBytes << " -> " << vertexBytes + indexBytes
+			<< " bytes in " << seconds * 1000.0 << " ms (" << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s)" << std::endl;
+	}
+
+	return true;
+}
+
+const MeshFileHeader& MeshFile::GetHeader()
+{
+	return this->Header;
+}
+
+const std::vector<VertexAttributeDesc>& MeshFile::GetAttributes()
+{
+	return this->Attributes;
+}
+
+const void* MeshFile::GetVertices()
+{
+	return this->Vertices;
+}
+
+const void* MeshFile::GetIndices()
+{
+	return this->Indices;
+}
+
+bool WriteMeshFile(const char* path, const std::vector<VertexAttributeDesc>& attributes, GLuint vertexStride, const std::vector<unsigned char>& packedVertices,
+	const IndexedMesh& mesh, const std::vector<VertexSource>& sources, bool compress)
+{
+	MeshFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.Magic = MESH_FILE_MAGIC;
+	header.Version = MESH_FILE_VERSION;
+	header.VertexCount = mesh.GetVertexCount();
+	header.VertexStride = vertexStride;
+	header.AttributeCount = (GLuint)attributes.size();
+	header.IndexCount = (GLuint)mesh.Indices.size();
+	header.IndexType = mesh.GetIndexType();
+
+	// bounds come from the float positions, before any quantisation
+	for (GLuint axis = 0; axis < 3; axis++) {
+		header.BoundsMin[axis] = header.BoundsMax[axis] = 0.0f;
+	}
+	for (const VertexSource& source : sources) {
+		if (source.Semantic != POSITION) {
+			continue;
+		}
+		for (GLuint v = 0; v < header.VertexCount; v++) {
+			for (GLuint axis = 0; axis < 3 && axis < source.Components; axis++) {
+				GLfloat value = mesh.Vertices[v * mesh.FloatsPerVertex + source.Offset + axis];
+				if (v == 0 || value < header.BoundsMin[axis]) {
+					header.BoundsMin[axis] = value;
+				}
+				if (v == 0 || value > header.BoundsMax[axis]) {
+					header.BoundsMax[axis] = value;
+				}
+			}
+		}
+	}
+
+	std::vector<unsigned char> vertexStream, indexStream;
+	if (compress) {
+		header.VertexCodec = header.IndexCodec = MESH_CODEC_DELTA;
+		vertexStream = EncodeVertexStream(packedVertices.data(), header.VertexCount, vertexStride);
+		indexStream = EncodeIndexStream(mesh.Indices.data(), header.IndexCount);
+	}
+	else {
+		header.VertexCodec = header.IndexCodec = MESH_CODEC_RAW;
+		vertexStream = packedVertices;
+		indexStream = mesh.GetPackedIndices();
+	}
+
+	header.VertexOffset = AlignUp(sizeof(MeshFileHeader) + attributes.size() * sizeof(VertexAttributeDesc));
+	header.VertexBytes = vertexStream.size();
+	header.IndexOffset = AlignUp(header.VertexOffset + header.VertexBytes);
+	header.IndexBytes = indexStream.size();
+
+	std::vector<unsigned char> file(header.IndexOffset + header.IndexBytes, 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(header), attributes.data(), attributes.size() * sizeof(VertexAttributeDesc));
+	std::memcpy(file.data() + header.VertexOffset, vertexStream.data(), vertexStream.size());
+	std::memcpy(file.data() + header.IndexOffset, indexStream.data(), indexStream.size());
+
+	std::ofstream out(path, std::ios::binary);
+	out.write((const char*)file.data(), file.size());
+	if (!out) {
+		std::cout << "ERROR::MESH_FILE::WRITE_FAILED\n" << path << std::endl;
+		return false;
+	}
+
+	std::cout << "INFO: Mesh file " << path << ": " << header.VertexCount << " vertices, " << header.IndexCount << " indices, "
+		<< file.size() << " bytes" << (compress ? " (delta coded)" : "") << std::endl;
+	return true;
+}
+
+// one "v/vt/vn" corner of an OBJ face; indices are 1-based, negative ones count back from the end, 0 means absent
+static bool ParseObjCorner(const std::string& token, GLint* position, GLint* texCoord, GLint* normal)
+{
+	*position = *texCoord = *normal = 0;
+	const char* cursor = token.c_str();
+	char* end;
+
+	*position = (GLint)std::strtol(cursor, &end, 10);
+	if (end == cursor) {
+		return false;
+	}
+	if (*end == '/') {
+		cursor = end + 1;
+		*texCoord = (GLint)std::strtol(cursor, &end, 10);
+		if (*end == '/') {
+			cursor = end + 1;
+			*normal = (GLint)std::strtol(cursor, &end, 10);
+		}
+	}
+	return true;
+}
+
+static GLint ResolveObjIndex(GLint index, size_t count)
+{
+	return index < 0 ? (GLint)count + index : index - 1;
+}
+
+bool ConvertObjToMeshFile(const char* objPath, const char* meshPath, bool compress)
+{
+	std::ifstream obj(objPath);
+	if (!obj) {
+		std::cout << "ERROR::MESH_FILE::OBJ_NOT_FOUND\n" << objPath << std::endl;
+		return false;
+	}
+
+	std::vector<GLfloat> positions, texCoords, normals;
+	// every face corner as (position, texcoord, normal) indices, already triangulated
+	std::vector<GLint> corners;
+
+	std::string line;
+	while (std::getline(obj, line)) {
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+
+		if (keyword == "v") {
+			GLfloat x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			positions.insert(positions.end(), { x, y, z });
+		}
+		else if (keyword == "vt") {
+			GLfloat u = 0.0f, v = 0.0f;
+			stream >> u >> v;
+			texCoords.insert(texCoords.end(), { u, v });
+		}
+		else if (keyword == "vn") {
+			GLfloat x = 0.0f, y = 0.0f, z = 1.0f;
+			stream >> x >> y >> z;
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if (keyword == "f") {
+			std::vector<GLint> face;
+			std::string token;
+			while (stream >> token) {
+				GLint p, t, n;
+				if (!ParseObjCorner(token, &p, &t, &n)) {
+					break;
+				}
+				face.push_back(ResolveObjIndex(p, positions.size() / 3));
+				face.push_back(t == 0 ? -1 : ResolveObjIndex(t, texCoords.size() / 2));
+				face.push_back(n == 0 ? -1 : ResolveObjIndex(n, normals.size() / 3));
+			}
+			// polygons become fans around their first corner
+			for (size_t c = 2; c < face.size() / 3; c++) {
+				corners.insert(corners.end(), face.begin(), face.begin() + 3);
+				corners.insert(corners.end(), face.begin() + (c - 1) * 3, face.begin() + (c + 1) * 3);
+			}
+		}
+	}
+
+	bool hasNormals = !normals.empty();
+	GLuint floatsPerVertex = hasNormals ? 8 : 5;
+
+	// expand to one float vertex per corner; welding folds the duplicates back together
+	std::vector<GLfloat> vertices;
+	vertices.reserve(corners.size() / 3 * floatsPerVertex);
+	for (size_t c = 0; c < corners.size(); c += 3) {
+		GLint p = corners[c], t = corners[c + 1], n = corners[c + 2];
+		if (p < 0 || (size_t)p * 3 >= positions.size()) {
+			std::cout << "ERROR::MESH_FILE::BAD_OBJ_INDEX\n" << objPath << std::endl;
+			return false;
+		}
+		vertices.insert(vertices.end(), positions.begin() + p * 3, positions.begin() + p * 3 + 3);
+		if (t >= 0 && (size_t)t * 2 < texCoords.size()) {
+			vertices.insert(vertices.end(), texCoords.begin() + t * 2, texCoords.begin() + t * 2 + 2);
+		}
+		else {
+			vertices.insert(vertices.end(), { 0.0f, 0.0f });
+		}
+		if (hasNormals) {
+			if (n >= 0 && (size_t)n * 3 < normals.size()) {
+				vertices.insert(vertices.end(), normals.begin() + n * 3, normals.begin() + n * 3 + 3);
+			}
+			else {
+				vertices.insert(vertices.end(), { 0.0f, 0.0f, 1.0f });
+			}
+		}
+	}
+
+	if (vertices.empty()) {
+		std::cout << "ERROR::MESH_FILE::EMPTY_OBJ\n" << objPath << std::endl;
+		return false;
+	}
+
+	IndexedMesh mesh = OptimizeMesh(objPath, vertices.data(), (GLuint)(vertices.size() / floatsPerVertex), floatsPerVertex);
+	if (hasNormals) {
+		return WriteMeshFile<PackedLitVertex>(meshPath, mesh, { { POSITION, 0, 3 }, { TEXCOORD, 3, 2 }, { NORMAL, 5, 3 } }, compress);
+	}
+	return WriteMeshFile<PackedTexturedVertex>(meshPath, mesh, { { POSITION, 0, 3 }, { TEXCOORD, 3, 2 } }, compress);
+}
+
+std::vector<unsigned char> EncodeVertexStream(const unsigned char* vertices, GLuint count, GLuint stride)
+{
+	std::vector<unsigned char> out;
+
+	// byte lanes compress far better than whole vertices: a lane of half-float high bytes barely changes
+	for (GLuint lane = 0; lane < stride; lane++) {
+		unsigned char previous = 0;
+		for (GLuint group = 0; group < count; group += VERTEX_CODEC_GROUP) {
+			unsigned char zigzag[VERTEX_CODEC_GROUP] = { 0 };
+			unsigned char largest = 0;
+			for (GLuint i = 0; i < VERTEX_CODEC_GROUP && group + i < count; i++) {
+				unsigned char value = vertices[(size_t)(group + i) * stride + lane];
+				signed char delta = (signed char)(value - previous);
+				zigzag[i] = (unsigned char)((delta << 1) ^ (delta >> 7));
+				largest |= zigzag[i];
+				previous = value;
+			}
+
+			// the narrowest of 0, 1, 2, 4 or 8 bits that holds every value in the group
+			unsigned char bits = largest == 0 ? 0 : (largest < 2 ? 1 : (largest < 4 ? 2 : (largest < 16 ? 4 : 8)));
+			out.push_back(bits);
+			if (bits == 0) {
+				continue;
+			}
+
+			size_t start = out.size();
+			out.resize(start + VERTEX_CODEC_GROUP * bits / 8, 0);
+			for (GLuint i = 0; i < VERTEX_CODEC_GROUP; i++) {
+				GLuint bit = i * bits;
+				out[start + bit / 8] |= (unsigned char)(zigzag[i] << (bit % 8));
+			}
+		}
+	}
+
+	return out;
+}
+
+bool DecodeVertexStream(const unsigned char* data, size_t size, GLuint count, GLuint stride, unsigned char* out)
+{
+	size_t read = 0;
+	for (GLuint lane = 0; lane < stride; lane++) {
+		unsigned char previous = 0;
+		for (GLuint group = 0; group < count; group += VERTEX_CODEC_GROUP) {
+			if (read >= size) {
+				return false;
+			}
+			unsigned char bits = data[read++];
+			if (bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8) {
+				return false;
+			}
+
+			size_t bytes = VERTEX_CODEC_GROUP * bits / 8;
+			if (read + bytes > size) {
+				return false;
+			}
+			unsigned char mask = (unsigned char)((1u << bits) - 1);
+			for (GLuint i = 0; i < VERTEX_CODEC_GROUP && group + i < count; i++) {
+				GLuint bit = i * bits;
+				unsigned char zigzag = bits == 0 ? 0 : (unsigned char)((data[read + bit / 8] >> (bit % 8)) & mask);
+				previous += (unsigned char)((zigzag >> 1) ^ -(zigzag & 1));
+				out[(size_t)(group + i) * stride + lane] = previous;
+			}
+			read += bytes;
+		}
+	}
+	return read == size;
+}
+
+std::vector<unsigned char> EncodeIndexStream(const GLuint* indices, GLuint count)
+{
+	std::vector<unsigned char> out;
+	out.reserve(count);
+
+	// cache-optimised meshes mostly step by a few vertices at a time, so most indices take one byte
+	GLuint previous = 0;
+	for (GLuint i = 0; i < count; i++) {
+		GLint delta = (GLint)(indices[i] - previous);
+		GLuint zigzag = ((GLuint)delta << 1) ^ (GLuint)(delta >> 31);
+		while (zigzag >= 0x80) {
+			out.push_back((unsigned char)(zigzag | 0x80));
+			zigzag >>= 7;
+		}
+		out.push_back((unsigned char)zigzag);
+		previous = indices[i];
+	}
+
+	return out;
+}
+
+bool DecodeIndexStream(const unsigned char* data, size_t size, GLuint count, GLenum indexType, unsigned char* out)
+{
+	GLuint indexSize = GetIndexSize(indexType);
+	size_t read = 0;
+	GLuint previous = 0;
+	for (GLuint i = 0; i < count; i++) {
+		GLuint zigzag = 0;
+		for (GLuint shift = 0; ; shift += 7) {
+			if (read >= size || shift > 28) {
+				return false;
+			}
+			unsigned char byte = data[read++];
+			zigzag |= (GLuint)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+		}
+		previous += (zigzag >> 1) ^ (GLuint)-(GLint)(zigzag & 1);
+
+		if (indexSize == 1) {
+			out[i] = (unsigned char)previous;
+		}
+		else if (indexSize == 2) {
+			GLushort narrow = (GLushort)previous;
+			std::memcpy(out + i * 2, &narrow, 2);
+		}
+		else {
+			std::memcpy(out + i * 4, &previous, 4);
+		}
+	}
+	return read == size;
+}
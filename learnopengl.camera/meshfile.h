@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "assetbundle.h"
+#include "mappedfile.h"
+#include "mesh.h"
+#include "vertexlayout.h"
+
+// "LMSH", little-endian
+const GLuint MESH_FILE_MAGIC = 0x48534D4C;
+const GLuint MESH_FILE_VERSION = 1;
+// streams start on this boundary so they can go to GL straight from the mapping
+const GLuint MESH_FILE_ALIGNMENT = 16;
+
+enum MeshStreamCodec {
+	// bytes exactly as GL wants them
+	MESH_CODEC_RAW = 0,
+	// vertices: per-byte deltas between consecutive vertices, zigzagged and bit-packed in groups of 16.
+	// indices: zigzagged deltas between consecutive indices as varints
+	MESH_CODEC_DELTA = 1
+};
+
+// the file starts with this, followed by AttributeCount VertexAttributeDescs; the streams live at their offsets
+struct MeshFileHeader
+{
+	GLuint Magic;
+	GLuint Version;
+	GLuint VertexCount;
+	GLuint VertexStride;
+	GLuint AttributeCount;
+	GLuint VertexCodec;
+	GLuint64 VertexOffset;
+	GLuint64 VertexBytes;
+	GLuint IndexCount;
+	GLenum IndexType;
+	GLuint IndexCodec;
+	GLuint Reserved;
+	GLuint64 IndexOffset;
+	GLuint64 IndexBytes;
+	GLfloat BoundsMin[3];
+	GLfloat BoundsMax[3];
+};
+
+static_assert(sizeof(MeshFileHeader) == 96, "MeshFileHeader must have no padding");
+static_assert(sizeof(VertexAttributeDesc) == 20, "VertexAttributeDesc must have no padding");
+
+// a mesh file mapped into memory, from the asset bundle if it has it. raw streams are handed out straight from the
+// mapping; coded ones are decoded once, on Load
+class MeshFile
+{
+public:
+	MeshFile();
+
+	bool Load(const char* path);
+	// reads a mesh file already in memory, which must outlive this; path is only for messages
+	bool Load(const unsigned char* data, size_t size, const char* path);
+
+	const MeshFileHeader& GetHeader();
+	const std::vector<VertexAttributeDesc>& GetAttributes();
+	const void* GetVertices();
+	const void* GetIndices();
+
+	// whether the file's vertices can be used as the given VertexLayout without conversion
+	template <typename Layout>
+	bool Matches()
+	{
+		std::vector<VertexAttributeDesc> expected = Layout::Describe();
+		if (this->Header.VertexStride != (GLuint)Layout::Stride || expected.size() != this->Attributes.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < expected.size(); i++) {
+			const VertexAttributeDesc& a = expected[i];
+			const VertexAttributeDesc& b = this->Attributes[i];
+			if (a.Semantic != b.Semantic || a.Components != b.Components || a.Type != b.Type || a.Normalized != b.Normalized || a.Offset != b.Offset) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	MappedFile File;
+	// backs the file if the bundle stored it packed
+	std::vector<unsigned char> Unpacked;
+	MeshFileHeader Header;
+	std::vector<VertexAttributeDesc> Attributes;
+	const unsigned char* Vertices;
+	const unsigned char* Indices;
+	std::vector<unsigned char> DecodedVertices;
+	std::vector<unsigned char> DecodedIndices;
+};
+
+// writes packed vertices already in the given layout; sources locate POSITION in mesh for the bounds
+bool WriteMeshFile(const char* path, const std::vector<VertexAttributeDesc>& attributes, GLuint vertexStride, const std::vector<unsigned char>& packedVertices,
+	const IndexedMesh& mesh, const std::vector<VertexSource>& sources, bool compress);
+
+template <typename Layout>
+bool WriteMeshFile(const char* path, const IndexedMesh& mesh, const std::vector<VertexSource>& sources, bool compress)
+{
+	std::vector<unsigned char> packed;
+	if (!Layout::Pack(mesh, sources, packed)) {
+		return false;
+	}
+	return WriteMeshFile(path, Layout::Describe(), Layout::Stride, packed, mesh, sources, compress);
+}
+
+// reads positions, texcoords and normals from a Wavefront OBJ, welds and optimises them, and writes a mesh file
+// as PackedLitVertex if the OBJ has normals, PackedTexturedVertex if not
+bool ConvertObjToMeshFile(const char* objPath, const char* meshPath, bool compress);
+
+std::vector<unsigned char> EncodeVertexStream(const unsigned char* vertices, GLuint count, GLuint stride);
+bool DecodeVertexStream(const unsigned char* data, size_t size, GLuint count, GLuint stride, unsigned char* out);
+std::vector<unsigned char> EncodeIndexStream(const GLuint* indices, GLuint count);
+bool DecodeIndexStream(const unsigned char* data, size_t size, GLuint count, GLenum indexType, unsigned char* out);
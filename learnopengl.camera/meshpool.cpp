@@ -0,0 +1,266 @@
+#include "meshpool.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#include "glstate.h"
+
+MeshPool::MeshPool(GLsizei vertexStride, void (*applyLayout)(GLuint), GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity, GLenum indexType)
+	: VertexStride(vertexStride), IndexType(indexType), VertexArena(vertexCapacity), IndexArena(indexCapacity)
+{
+	this->IndexSize = indexType == GL_UNSIGNED_BYTE ? 1 : (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+
+	// the VAO only captures which buffers to read, so it survives defragmentation untouched
+	glGenVertexArrays(1, &this->VaoId);
+	glState.BindVertexArray(this->VaoId);
+	glState.BindBuffer(GL_ARRAY_BUFFER, this->VertexArena.GetBufferId());
+	applyLayout(0);
+	glState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->IndexArena.GetBufferId());
+
+	// cleanup
+	glState.BindVertexArray(0);
+	glState.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+MeshPool::~MeshPool()
+{
+	glState.DeleteVertexArray(this->VaoId);
+}
+
+bool MeshPool::Add(GLuint* meshId, const IndexedMesh& mesh, const std::vector<unsigned char>& packedVertices)
+{
+	if (!this->AddPacked(meshId, packedVertices.data(), mesh.GetVertexCount(), mesh.Indices.data(), (GLuint)mesh.Indices.size(), GL_UNSIGNED_INT)) {
+		return false;
+	}
+	this->Meshes[*meshId].Radius = GetBoundingRadius(mesh);
+	return true;
+}
+
+bool MeshPool::AddPacked(GLuint* meshId, const void* vertices, GLuint vertexCount, const void* indices, GLuint indexCount, GLenum indexType)
+{
+	if (this->IndexSize < 4 && vertexCount > (1u << (this->IndexSize * 8))) {
+		std::cout << "ERROR::MESH_POOL::INDEX_TYPE_TOO_NARROW\n" << vertexCount << " vertices" << std::endl;
+		return false;
+	}
+
+	// aligning to the stride keeps the base vertex a whole number
+	GLsizeiptr vertexBytes = (GLsizeiptr)vertexCount * this->VertexStride;
+	GLsizeiptr indexBytes = (GLsizeiptr)indexCount * this->IndexSize;
+	GLintptr vertexOffset = this->VertexArena.Allocate(vertexBytes, this->VertexStride);
+	GLintptr indexOffset = this->IndexArena.Allocate(indexBytes, this->IndexSize);
+	if (vertexOffset == BufferArena::INVALID_OFFSET || indexOffset == BufferArena::INVALID_OFFSET) {
+		std::cout << "ERROR::MESH_POOL::OUT_OF_SPACE\n" << vertexBytes << " vertex bytes, " << indexBytes << " index bytes" << std::endl;
+		if (vertexOffset != BufferArena::INVALID_OFFSET) {
+			this->VertexArena.Free(vertexOffset);
+		}
+		if (indexOffset != BufferArena::INVALID_OFFSET) {
+			this->IndexArena.Free(indexOffset);
+		}
+		return false;
+	}
+
+	// indices stay local to the mesh; the base vertex does the rest
+	this->VertexArena.Upload(vertexOffset, vertexBytes, vertices);
+	if (indexType == this->IndexType) {
+		this->IndexArena.Upload(indexOffset, indexBytes, indices);
+	}
+	else {
+		GLsizei sourceSize = indexType == GL_UNSIGNED_BYTE ? 1 : (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+		std::vector<unsigned char> packedIndices(indexBytes);
+		for (GLuint i = 0; i < indexCount; i++) {
+			GLuint index = 0;
+			if (sourceSize == 1) {
+				index = ((const unsigned char*)indices)[i];
+			}
+			else if (sourceSize == 2) {
+				index = ((const GLushort*)indices)[i];
+			}
+			else {
+				index = ((const GLuint*)indices)[i];
+			}
+
+			if (this->IndexSize == 1) {
+				packedIndices[i] = (unsigned char)index;
+			}
+			else if (this->IndexSize == 2) {
+				GLushort narrow = (GLushort)index;
+				std::memcpy(&packedIndices[i * 2], &narrow, 2);
+			}
+			else {
+				std::memcpy(&packedIndices[i * 4], &index, 4);
+			}
+		}
+		this->IndexArena.Upload(indexOffset, indexBytes, packedIndices.data());
+	}
+
+	Mesh entry;
+	entry.VertexOffset = vertexOffset;
+	entry.IndexOffset = indexOffset;
+	entry.BaseVertex = (GLint)(vertexOffset / this->VertexStride);
+	entry.FirstIndex = (GLuint)(indexOffset / this->IndexSize);
+	entry.IndexCount = (GLsizei)indexCount;
+	entry.Live = GL_TRUE;
+	entry.LodCount = 1;
+	entry.Lods[0].FirstIndex = entry.FirstIndex;
+	entry.Lods[0].IndexCount = entry.IndexCount;
+	entry.Lods[0].Error = 0.0f;
+	entry.Radius = 0.0f;
+
+	if (!this->FreeIds.empty()) {
+		*meshId = this->FreeIds.back();
+		this->FreeIds.pop_back();
+		this->Meshes[*meshId] = entry;
+	}
+	else {
+		*meshId = (GLuint)this->Meshes.size();
+		this->Meshes.push_back(entry);
+	}
+	return true;
+}
+
+bool MeshPool::AddLods(GLuint* meshId, const IndexedMesh& mesh, const std::vector<MeshLod>& lods, const std::vector<unsigned char>& packedVertices)
+{
+	GLuint lodCount = lods.size() < MAX_MESH_LODS ? (GLuint)lods.size() : MAX_MESH_LODS;
+	std::vector<GLuint> indices;
+	for (GLuint lod = 0; lod < lodCount; lod++) {
+		indices.insert(indices.end(), lods[lod].Indices.begin(), lods[lod].Indices.end());
+	}
+
+	if (!this->AddPacked(meshId, packedVertices.data(), mesh.GetVertexCount(), indices.data(), (GLuint)indices.size(), GL_UNSIGNED_INT)) {
+		return false;
+	}
+
+	// the levels follow one another in the allocation, finest first
+	Mesh& entry = this->Meshes[*meshId];
+	GLuint firstIndex = entry.FirstIndex;
+	for (GLuint lod = 0; lod < lodCount; lod++) {
+		entry.Lods[lod].FirstIndex = firstIndex;
+		entry.Lods[lod].IndexCount = (GLsizei)lods[lod].Indices.size();
+		entry.Lods[lod].Error = lods[lod].Error;
+		firstIndex += (GLuint)lods[lod].Indices.size();
+	}
+	entry.LodCount = lodCount;
+	entry.Radius = GetBoundingRadius(mesh);
+	return true;
+}
+
+void MeshPool::Remove(GLuint meshId)
+{
+	Mesh& mesh = this->Meshes[meshId];
+	if (!mesh.Live) {
+		return;
+	}
+
+	this->VertexArena.Free(mesh.VertexOffset);
+	this->IndexArena.Free(mesh.IndexOffset);
+	mesh.Live = GL_FALSE;
+	this->FreeIds.push_back(meshId);
+}
+
+void MeshPool::Defragment()
+{
+	// offsets are unique per arena, so they identify the mesh being moved
+	std::map<GLintptr, GLuint> byVertexOffset, byIndexOffset;
+	for (GLuint id = 0; id < this->Meshes.size(); id++) {
+		if (this->Meshes[id].Live) {
+			byVertexOffset[this->Meshes[id].VertexOffset] = id;
+			byIndexOffset[this->Meshes[id].IndexOffset] = id;
+		}
+	}
+
+	this->VertexArena.Defragment([&](GLintptr from, GLintptr to) {
+		Mesh& mesh = this->Meshes[byVertexOffset[from]];
+		mesh.VertexOffset = to;
+		mesh.BaseVertex = (GLint)(to / this->VertexStride);
+	});
+	this->IndexArena.Defragment([&](GLintptr from, GLintptr to) {
+		Mesh& mesh = this->Meshes[byIndexOffset[from]];
+		GLuint firstIndex = (GLuint)(to / this->IndexSize);
+		for (GLuint lod = 0; lod < mesh.LodCount; lod++) {
+			mesh.Lods[lod].FirstIndex = mesh.Lods[lod].FirstIndex - mesh.FirstIndex + firstIndex;
+		}
+		mesh.IndexOffset = to;
+		mesh.FirstIndex = firstIndex;
+	});
+}
+
+void MeshPool::Draw(GLuint meshId, GLuint lod)
+{
+	const Mesh& mesh = this->Meshes[meshId];
+	const Lod& level = mesh.Lods[lod];
+	glState.BindVertexArray(this->VaoId);
+	glDrawElementsBaseVertex(GL_TRIANGLES, level.IndexCount, this->IndexType, (GLvoid*)((GLintptr)level.FirstIndex * this->IndexSize), mesh.BaseVertex);
+}
+
+void MeshPool::DrawInstanced(GLuint meshId, GLsizei instanceCount, GLuint lod)
+{
+	const Mesh& mesh = this->Meshes[meshId];
+	const Lod& level = mesh.Lods[lod];
+	glState.BindVertexArray(this->VaoId);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.IndexCount, this->IndexType, (GLvoid*)((GLintptr)level.FirstIndex * this->IndexSize), instanceCount, mesh.BaseVertex);
+}
+
+GLuint MeshPool::SelectLod(GLuint meshId, GLfloat distance, GLfloat pixelsPerUnit)
+{
+	const Mesh& mesh = this->Meshes[meshId];
+	// measured from the nearest point of the bounds; inside them everything is full detail
+	GLfloat nearest = distance - mesh.Radius;
+	if (nearest <= 0.0f) {
+		return 0;
+	}
+
+	// errors only grow down the chain, so walk down until one would show
+	GLuint lod = 0;
+	while (lod + 1 < mesh.LodCount && mesh.Lods[lod + 1].Error * pixelsPerUnit / nearest <= LOD_PIXEL_ERROR) {
+		lod++;
+	}
+	return lod;
+}
+
+GLfloat MeshPool::GetPixelsPerUnit(GLfloat fovYRadians, GLint viewportHeight)
+{
+	return viewportHeight / (2.0f * std::tan(fovYRadians * 0.5f));
+}
+
+void MeshPool::SetRadius(GLuint meshId, GLfloat radius)
+{
+	this->Meshes[meshId].Radius = radius;
+}
+
+const MeshPool::Mesh& MeshPool::GetMesh(GLuint meshId)
+{
+	return this->Meshes[meshId];
+}
+
+GLuint MeshPool::GetVertexArrayId()
+{
+	return this->VaoId;
+}
+
+GLenum MeshPool::GetIndexType()
+{
+	return this->IndexType;
+}
+
+BufferArena& MeshPool::GetVertexArena()
+{
+	return this->VertexArena;
+}
+
+BufferArena& MeshPool::GetIndexArena()
+{
+	return this->IndexArena;
+}
+
+void MeshPool::LogStats(const char* name)
+{
+	const char* arenaNames[] = { "vertex", "index" };
+	BufferArena* arenas[] = { &this->VertexArena, &this->IndexArena };
+	for (GLuint i = 0; i < 2; i++) {
+		BufferArena::Stats stats = arenas[i]->GetStats();
+		std::cout << "INFO: " << name << " " << arenaNames[i] << " arena " << stats.Used << "/" << stats.Capacity << " bytes in "
+			<< stats.Allocations << " allocations, " << stats.FreeRanges << " free ranges, fragmentation " << stats.Fragmentation << std::endl;
+	}
+}
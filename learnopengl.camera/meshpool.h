@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "bufferarena.h"
+#include "mesh.h"
+
+// how many pixels a LOD's error may cover on screen before SelectLod picks a finer one
+const GLfloat LOD_PIXEL_ERROR = 1.0f;
+
+// every mesh of one vertex layout, packed into a shared vertex arena and index arena behind a single VAO.
+// meshes differ only by base vertex and first index, so switching between them never rebinds anything
+class MeshPool
+{
+public:
+	// one detail level: a run of the mesh's indices over the same vertices
+	struct Lod
+	{
+		GLuint FirstIndex;
+		GLsizei IndexCount;
+		// object space distance the surface may be off by, compared against LOD 0
+		GLfloat Error;
+	};
+
+	struct Mesh
+	{
+		GLintptr VertexOffset;
+		GLintptr IndexOffset;
+		GLint BaseVertex;
+		// every level's indices, back to back
+		GLuint FirstIndex;
+		GLsizei IndexCount;
+		GLboolean Live;
+		GLuint LodCount;
+		Lod Lods[MAX_MESH_LODS];
+		// bounding sphere about the origin, 0 if unknown
+		GLfloat Radius;
+	};
+
+	// applyLayout is a VertexLayout's Apply, e.g. MeshPool(PackedTexturedVertex::Stride, &PackedTexturedVertex::Apply, ...)
+	MeshPool(GLsizei vertexStride, void (*applyLayout)(GLuint), GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity, GLenum indexType = GL_UNSIGNED_SHORT);
+	~MeshPool();
+
+	// packedVertices must already be in the pool's layout; fails if an arena is full or the index type is too narrow
+	bool Add(GLuint* meshId, const IndexedMesh& mesh, const std::vector<unsigned char>& packedVertices);
+	// the same from raw streams, e.g. straight out of a mapped MeshFile; indices of the pool's type are uploaded as they are
+	bool AddPacked(GLuint* meshId, const void* vertices, GLuint vertexCount, const void* indices, GLuint indexCount, GLenum indexType);
+	// one set of vertices and every level of a BuildLodChain in a single allocation each
+	bool AddLods(GLuint* meshId, const IndexedMesh& mesh, const std::vector<MeshLod>& lods, const std::vector<unsigned char>& packedVertices);
+	void Remove(GLuint meshId);
+	// compacts both arenas, fixing up every mesh's base vertex and first index
+	void Defragment();
+
+	// binds the shared VAO (if it isn't already) and draws one level of one mesh
+	void Draw(GLuint meshId, GLuint lod = 0);
+	void DrawInstanced(GLuint meshId, GLsizei instanceCount, GLuint lod = 0);
+
+	// the coarsest level whose error, seen from distance, stays under LOD_PIXEL_ERROR pixels.
+	// pixelsPerUnit is how many pixels one unit spans at distance 1, see GetPixelsPerUnit
+	GLuint SelectLod(GLuint meshId, GLfloat distance, GLfloat pixelsPerUnit);
+	static GLfloat GetPixelsPerUnit(GLfloat fovYRadians, GLint viewportHeight);
+
+	// for meshes added from raw streams, whose bounds the pool can't see
+	void SetRadius(GLuint meshId, GLfloat radius);
+	const Mesh& GetMesh(GLuint meshId);
+	GLuint GetVertexArrayId();
+	GLenum GetIndexType();
+	BufferArena& GetVertexArena();
+	BufferArena& GetIndexArena();
+
+	// one INFO line per arena
+	void LogStats(const char* name);
+
+private:
+	GLsizei VertexStride;
+	GLenum IndexType;
+	GLsizei IndexSize;
+	BufferArena VertexArena;
+	BufferArena IndexArena;
+	GLuint VaoId;
+
+	std::vector<Mesh> Meshes;
+	// ids of removed meshes, reused before the list grows
+	std::vector<GLuint> FreeIds;
+};
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <SOIL.h>
+
+#include "mipchain.h"
+
+// runs per measurement; the best is reported, which is the one least disturbed by everything else on the machine
+const GLuint BENCH_RUNS = 5;
+
+struct BenchImage
+{
+	std::string Name;
+	std::vector<unsigned char> Pixels;
+	GLuint Width;
+	GLuint Height;
+};
+
+static bool LoadBenchImage(const char* path, BenchImage& image)
+{
+	int width, height;
+	unsigned char* pixels = SOIL_load_image(path, &width, &height, 0, SOIL_LOAD_RGBA);
+	if (pixels == nullptr) {
+		std::cout << "ERROR::MIPBENCH::LOAD_FAILED\n" << path << std::endl;
+		return false;
+	}
+	image.Name = path;
+	image.Pixels.assign(pixels, pixels + (size_t)width * height * 4);
+	image.Width = width;
+	image.Height = height;
+	SOIL_free_image_data(pixels);
+	return true;
+}
+
+// gradients under noise, so neither filter gets flat regions to coast through
+static BenchImage MakeSyntheticImage(GLuint size)
+{
+	BenchImage image;
+	image.Name = "synthetic " + std::to_string(size);
+	image.Width = size;
+	image.Height = size;
+	image.Pixels.resize((size_t)size * size * 4);
+	for (GLuint y = 0; y < size; y++) {
+		for (GLuint x = 0; x < size; x++) {
+			unsigned char* texel = &image.Pixels[((size_t)y * size + x) * 4];
+			texel[0] = (unsigned char)(x * 255 / size ^ (std::rand() & 31));
+			texel[1] = (unsigned char)(y * 255 / size ^ (std::rand() & 31));
+			texel[2] = (unsigned char)((x ^ y) & 255);
+			texel[3] = 255;
+		}
+	}
+	return image;
+}
+
+static GLdouble SecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<GLdouble>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void Report(const BenchImage& image, const std::string& method, GLdouble seconds)
+{
+	std::cout << "INFO: " << image.Name << " (" << image.Width << "x" << image.Height << ") " << method << ": " << seconds * 1000.0
+		<< " ms, " << (GLdouble)image.Width * image.Height / (seconds * 1000000.0) << " MPix/s" << std::endl;
+}
+
+static bool SameChain(MipChain& a, MipChain& b)
+{
+	if (a.GetLevelCount() != b.GetLevelCount()) {
+		return false;
+	}
+	for (GLuint level = 0; level < a.GetLevelCount(); level++) {
+		size_t bytes = (size_t)a.GetWidth(level) * a.GetHeight(level) * 4;
+		if (std::memcmp(a.GetLevelData(level), b.GetLevelData(level), bytes) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// times MipChain's filters on one thread, down every SIMD path the CPU has, against glGenerateMipmap on the current context
+int main(int argc, char** argv)
+{
+	glfwInit();
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "mipbench", nullptr, nullptr);
+	if (window == nullptr) {
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK) {
+		std::cout << "Failed to initialize GLEW" << std::endl;
+		return 1;
+	}
+	std::cout << "INFO: OpenGL renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+	// the sample's own textures, anything named on the command line, then big synthetic ones
+	std::vector<BenchImage> images;
+	std::vector<std::string> paths = { "./container.jpg", "./awesomeface.png" };
+	paths.insert(paths.end(), argv + 1, argv + argc);
+	for (const std::string& path : paths) {
+		BenchImage image;
+		if (LoadBenchImage(path.c_str(), image)) {
+			images.push_back(image);
+		}
+	}
+	images.push_back(MakeSyntheticImage(2048));
+	images.push_back(MakeSyntheticImage(4096));
+
+	GLuint textureId;
+	glGenTextures(1, &textureId);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	for (const BenchImage& image : images) {
+		for (GLuint filter = 0; filter < MIP_FILTER_COUNT; filter++) {
+			for (GLuint srgb = 0; srgb < 2; srgb++) {
+				// every path has to give the scalar chain back exactly, or cached and cooked chains would depend on the CPU
+				MipChain reference;
+				reference.Generate(image.Pixels.data(), image.Width, image.Height, (MipFilter)filter, srgb != 0, MAX_MIP_LEVELS, PIXEL_PATH_SCALAR);
+				for (GLuint path = PIXEL_PATH_SCALAR; path <= (GLuint)GetBestPixelPath(); path++) {
+					GLdouble best = 1e9;
+					for (GLuint run = 0; run < BENCH_RUNS; run++) {
+						MipChain mips;
+						auto start = std::chrono::high_resolution_clock::now();
+						mips.Generate(image.Pixels.data(), image.Width, image.Height, (MipFilter)filter, srgb != 0, MAX_MIP_LEVELS, (PixelPath)path);
+						best = std::min(best, SecondsSince(start));
+						if (run == 0 && !SameChain(mips, reference)) {
+							std::cout << "ERROR::MIPBENCH::MISMATCH\n" << image.Name << " " << MIP_FILTER_NAMES[filter] << " " << PIXEL_PATH_NAMES[path]
+								<< std::endl;
+						}
+					}
+					Report(image, std::string("MipChain ") + MIP_FILTER_NAMES[filter] + (srgb ? " sRGB " : " linear ") + PIXEL_PATH_NAMES[path], best);
+				}
+			}
+		}
+
+		// the top level goes up untimed; glFinish makes sure the timing covers the work and not just queuing it
+		GLdouble best = 1e9;
+		for (GLuint run = 0; run < BENCH_RUNS; run++) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.Width, image.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.Pixels.data());
+			glFinish();
+			auto start = std::chrono::high_resolution_clock::now();
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glFinish();
+			best = std::min(best, SecondsSince(start));
+		}
+		Report(image, "glGenerateMipmap", best);
+	}
+
+	// cleanup
+	glDeleteTextures(1, &textureId);
+	glfwTerminate();
+	return 0;
+}
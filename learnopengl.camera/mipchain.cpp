@@ -0,0 +1,446 @@
+#include "mipchain.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "pixelconvert.h"
+#include "simd.h"
+
+// the Kaiser filter reaches two target texels either side, four source texels at 2:1
+const GLfloat KAISER_RADIUS = 2.0f;
+const GLfloat KAISER_ALPHA = 4.0f;
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+static GLfloat BesselI0(GLfloat x)
+{
+	GLfloat sum = 1.0f, term = 1.0f;
+	for (GLuint k = 1; k < 20; k++) {
+		term *= (x / (2.0f * k)) * (x / (2.0f * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static GLfloat Kaiser(GLfloat t)
+{
+	if (std::fabs(t) >= KAISER_RADIUS) {
+		return 0.0f;
+	}
+	GLfloat window = BesselI0(KAISER_ALPHA * std::sqrt(1.0f - (t / KAISER_RADIUS) * (t / KAISER_RADIUS))) / BesselI0(KAISER_ALPHA);
+	GLfloat sinc = t == 0.0f ? 1.0f : std::sin(3.14159265f * t) / (3.14159265f * t);
+	return sinc * window;
+}
+
+// how many source texels one target texel reads along an axis; the Kaiser filter spans more of them the more the
+// axis shrinks, and never fewer than when it halves
+static GLuint GetTapCount(GLuint size, GLuint targetSize, MipFilter filter)
+{
+	if (filter == MIP_FILTER_BOX) {
+		return 2;
+	}
+	GLfloat scale = (GLfloat)size / targetSize;
+	return 2 * (GLuint)std::ceil(KAISER_RADIUS * (scale > 2.0f ? scale : 2.0f));
+}
+
+// which source texels make up each target texel along one axis, and how much each counts; taps weights per texel.
+// the box filter only halves
+static void BuildWeights(GLuint size, GLuint targetSize, MipFilter filter, GLuint taps, std::vector<GLint>& first, std::vector<GLfloat>& weights)
+{
+	first.resize(targetSize);
+	weights.resize((size_t)targetSize * taps);
+	GLfloat scale = (GLfloat)size / targetSize;
+	// enlarging interpolates between source texels rather than averaging them
+	GLfloat filterScale = scale > 1.0f ? scale : 1.0f;
+	for (GLuint x = 0; x < targetSize; x++) {
+		GLfloat* w = &weights[(size_t)x * taps];
+		if (filter == MIP_FILTER_BOX) {
+			// an odd last row or column goes unread, as with glGenerateMipmap
+			first[x] = (GLint)(x * 2);
+			w[0] = size > 1 ? 0.5f : 1.0f;
+			w[1] = size > 1 ? 0.5f : 0.0f;
+			continue;
+		}
+
+		// the target texel's center in source texels, measured in target texels from there
+		GLfloat center = (x + 0.5f) * scale - 0.5f;
+		first[x] = (GLint)std::floor(center) - (GLint)(taps / 2 - 1);
+		GLfloat sum = 0.0f;
+		for (GLuint i = 0; i < taps; i++) {
+			w[i] = Kaiser((first[x] + (GLint)i - center) / filterScale);
+			sum += w[i];
+		}
+		for (GLuint i = 0; i < taps; i++) {
+			w[i] /= sum;
+		}
+	}
+}
+
+static GLint Clamp(GLint value, GLuint size)
+{
+	return value < 0 ? 0 : (value >= (GLint)size ? (GLint)size - 1 : value);
+}
+
+#ifdef SIMD_SSE2
+// one whole texel per register
+static GLuint FilterRowSse2(const GLfloat* linear, GLuint width, GLuint targetWidth, GLuint taps, const GLint* first, const GLfloat* weights,
+	GLfloat* out)
+{
+	for (GLuint x = 0; x < targetWidth; x++) {
+		const GLfloat* w = weights + (size_t)x * taps;
+		__m128 sum = _mm_setzero_ps();
+		for (GLuint i = 0; i < taps; i++) {
+			GLint sx = Clamp(first[x] + (GLint)i, width);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(linear + (size_t)sx * 4), _mm_set1_ps(w[i])));
+		}
+		_mm_storeu_ps(out + (size_t)x * 4, sum);
+	}
+	return targetWidth;
+}
+
+// two target texels per register, each half with its own source texels and weights. multiplies and adds stay
+// separate and in the same order, so the sums match the other paths to the bit
+SIMD_AVX2_FUNCTION static GLuint FilterRowAvx2(const GLfloat* linear, GLuint width, GLuint targetWidth, GLuint taps, const GLint* first,
+	const GLfloat* weights, GLfloat* out)
+{
+	GLuint x = 0;
+	for (; x + 2 <= targetWidth; x += 2) {
+		const GLfloat* w0 = weights + (size_t)x * taps;
+		const GLfloat* w1 = w0 + taps;
+		__m256 sum = _mm256_setzero_ps();
+		for (GLuint i = 0; i < taps; i++) {
+			const GLfloat* l0 = linear + (size_t)Clamp(first[x] + (GLint)i, width) * 4;
+			const GLfloat* l1 = linear + (size_t)Clamp(first[x + 1] + (GLint)i, width) * 4;
+			__m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(l0)), _mm_loadu_ps(l1), 1);
+			__m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[i])), _mm_set1_ps(w1[i]), 1);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(texels, w));
+		}
+		_mm256_storeu_ps(out + (size_t)x * 4, sum);
+	}
+	return x;
+}
+
+static GLuint FilterColumnSse2(GLfloat* const* rows, const GLfloat* w, GLuint taps, GLuint targetWidth, GLfloat* sums)
+{
+	for (GLuint x = 0; x < targetWidth; x++) {
+		__m128 sum = _mm_setzero_ps();
+		for (GLuint i = 0; i < taps; i++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[i] + (size_t)x * 4), _mm_set1_ps(w[i])));
+		}
+		_mm_storeu_ps(sums + (size_t)x * 4, sum);
+	}
+	return targetWidth;
+}
+
+// every texel of a row shares the weights here, so two texels are one load
+SIMD_AVX2_FUNCTION static GLuint FilterColumnAvx2(GLfloat* const* rows, const GLfloat* w, GLuint taps, GLuint targetWidth, GLfloat* sums)
+{
+	GLuint x = 0;
+	for (; x + 2 <= targetWidth; x += 2) {
+		__m256 sum = _mm256_setzero_ps();
+		for (GLuint i = 0; i < taps; i++) {
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[i] + (size_t)x * 4), _mm256_set1_ps(w[i])));
+		}
+		_mm256_storeu_ps(sums + (size_t)x * 4, sum);
+	}
+	return x;
+}
+#endif
+
+// filters one source row across into targetWidth linear RGBA texels
+static void FilterRow(const unsigned char* source, GLuint width, GLuint targetWidth, bool srgb, GLuint taps,
+	const std::vector<GLint>& first, const std::vector<GLfloat>& weights, GLfloat* linear, GLfloat* out, PixelPath path)
+{
+	ConvertToLinear(source, linear, width, srgb, path);
+
+	GLuint x = 0;
+#ifdef SIMD_SSE2
+	if (path == PIXEL_PATH_AVX2) {
+		x = FilterRowAvx2(linear, width, targetWidth, taps, first.data(), weights.data(), out);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		x = FilterRowSse2(linear, width, targetWidth, taps, first.data(), weights.data(), out);
+	}
+#endif
+	for (; x < targetWidth; x++) {
+		const GLfloat* w = &weights[(size_t)x * taps];
+		GLfloat sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (GLuint i = 0; i < taps; i++) {
+			const GLfloat* l = linear + (size_t)Clamp(first[x] + (GLint)i, width) * 4;
+			for (GLuint c = 0; c < 4; c++) {
+				sum[c] += l[c] * w[i];
+			}
+		}
+		std::memcpy(out + (size_t)x * 4, sum, sizeof(sum));
+	}
+}
+
+// sums the filtered rows down into one target row of linear texels, and stores it as RGBA8
+static void FilterColumn(GLfloat* const* rows, const GLfloat* w, GLuint taps, GLuint targetWidth, bool srgb, GLfloat* sums, unsigned char* target,
+	PixelPath path)
+{
+	GLuint x = 0;
+#ifdef SIMD_SSE2
+	if (path == PIXEL_PATH_AVX2) {
+		x = FilterColumnAvx2(rows, w, taps, targetWidth, sums);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		x = FilterColumnSse2(rows, w, taps, targetWidth, sums);
+	}
+#endif
+	for (; x < targetWidth; x++) {
+		for (GLuint c = 0; c < 4; c++) {
+			GLfloat sum = 0.0f;
+			for (GLuint i = 0; i < taps; i++) {
+				sum += rows[i][(size_t)x * 4 + c] * w[i];
+			}
+			sums[(size_t)x * 4 + c] = sum;
+		}
+	}
+	// sinc lobes overshoot; the conversion clamps them
+	ConvertFromLinear(sums, target, targetWidth, srgb, path);
+}
+
+void DownsampleImage(const unsigned char* source, GLuint width, GLuint height, MipFilter filter, bool srgb, unsigned char* target, PixelPath path)
+{
+	ResizeImage(source, width, height, width > 1 ? width / 2 : 1, height > 1 ? height / 2 : 1, filter, srgb, target, path);
+}
+
+void ResizeImage(const unsigned char* source, GLuint width, GLuint height, GLuint targetWidth, GLuint targetHeight, MipFilter filter,
+	bool srgb, unsigned char* target, PixelPath path)
+{
+	// wider than the CPU can run gets the widest it can
+	path = path < GetBestPixelPath() ? path : GetBestPixelPath();
+
+	// one ring serves both axes, so it's as deep as the wider of the two filters
+	GLuint tapsX = GetTapCount(width, targetWidth, filter);
+	GLuint tapsY = GetTapCount(height, targetHeight, filter);
+	GLuint taps = tapsX > tapsY ? tapsX : tapsY;
+
+	std::vector<GLint> firstX, firstY;
+	std::vector<GLfloat> weightsX, weightsY;
+	BuildWeights(width, targetWidth, filter, taps, firstX, weightsX);
+	BuildWeights(height, targetHeight, filter, taps, firstY, weightsY);
+
+	// separable: source rows are filtered across once each into a ring of taps rows, which each target row then
+	// sums down. the taps rows one target row reads are consecutive, so they never collide in the ring
+	std::vector<GLfloat> linear((size_t)width * 4);
+	std::vector<GLfloat> sums((size_t)targetWidth * 4);
+	std::vector<GLfloat> ring((size_t)taps * targetWidth * 4);
+	std::vector<GLint> ringRows(taps, -1);
+	std::vector<GLfloat*> rows(taps);
+	for (GLuint y = 0; y < targetHeight; y++) {
+		for (GLuint i = 0; i < taps; i++) {
+			GLint sy = Clamp(firstY[y] + (GLint)i, height);
+			GLuint slot = (GLuint)sy % taps;
+			rows[i] = &ring[(size_t)slot * targetWidth * 4];
+			if (ringRows[slot] != sy) {
+				FilterRow(source + (size_t)sy * width * 4, width, targetWidth, srgb, taps, firstX, weightsX, linear.data(), rows[i], path);
+				ringRows[slot] = sy;
+			}
+		}
+		FilterColumn(rows.data(), &weightsY[(size_t)y * taps], taps, targetWidth, srgb, sums.data(), target + (size_t)y * targetWidth * 4, path);
+	}
+}
+
+GLuint64 HashMipSource(const unsigned char* data, size_t size, MipFilter filter, bool srgb, GLuint width, GLuint height)
+{
+	GLuint64 hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	// the settings too, so switching filter misses rather than loading the old chain
+	const GLuint settings[] = { (GLuint)filter, (GLuint)srgb, MIP_CACHE_VERSION, width, height };
+	for (size_t i = 0; i < sizeof(settings); i++) {
+		hash ^= ((const unsigned char*)settings)[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string GetMipCachePath(GLuint64 key)
+{
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "%016llx.mip", (unsigned long long)key);
+	return std::string(MIP_CACHE_DIR) + fileName;
+}
+
+MipChain::MipChain()
+{
+}
+
+void MipChain::Generate(const unsigned char* rgba, GLuint width, GLuint height, MipFilter filter, bool srgb, GLuint maxLevels, PixelPath path)
+{
+	this->File.Close();
+	this->Unpacked.clear();
+	this->Levels.clear();
+	this->Generated.clear();
+	this->Generated.push_back(std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4));
+	Level level;
+	level.Width = width;
+	level.Height = height;
+	this->Levels.push_back(level);
+
+	// each level from the one above; the error that adds is well under a byte
+	while ((level.Width > 1 || level.Height > 1) && this->Levels.size() < maxLevels) {
+		const Level& above = this->Levels.back();
+		level.Width = above.Width > 1 ? above.Width / 2 : 1;
+		level.Height = above.Height > 1 ? above.Height / 2 : 1;
+		this->Generated.push_back(std::vector<unsigned char>((size_t)level.Width * level.Height * 4));
+		DownsampleImage(this->Generated[this->Generated.size() - 2].data(), above.Width, above.Height, filter, srgb, this->Generated.back().data(), path);
+		this->Levels.push_back(level);
+	}
+
+	// the vectors don't move once the chain is built
+	for (size_t i = 0; i < this->Levels.size(); i++) {
+		this->Levels[i].Data = this->Generated[i].data();
+	}
+}
+
+bool MipChain::Load(const char* path, GLuint64 key)
+{
+	this->Levels.clear();
+	this->Generated.clear();
+	this->Unpacked.clear();
+	if (!this->File.Open(path)) {
+		return false;
+	}
+	if (!this->Parse(this->File.GetData(), this->File.GetSize(), key, path)) {
+		this->File.Close();
+		return false;
+	}
+	return true;
+}
+
+bool MipChain::LoadCooked(const char* path, bool srgb, GLuint64* key)
+{
+	this->File.Close();
+	this->Levels.clear();
+	this->Generated.clear();
+	const AssetBundleEntry* entry = assetBundle.Find(path, ASSET_MIP_CHAIN);
+	if (entry == nullptr || ((entry->Flags & ASSET_FLAG_SRGB) != 0) != srgb) {
+		return false;
+	}
+	const unsigned char* data = assetBundle.GetData(*entry, this->Unpacked);
+	if (data == nullptr || !this->Parse(data, (size_t)entry->UnpackedBytes, entry->Key, path)) {
+		std::cout << "ERROR::MIP_CHAIN::BAD_COOKED_CHAIN\n" << path << std::endl;
+		this->Unpacked.clear();
+		return false;
+	}
+	*key = entry->Key;
+	return true;
+}
+
+bool MipChain::Parse(const unsigned char* data, size_t size, GLuint64 key, const char* path)
+{
+	MipCacheHeader header;
+	if (size < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.Magic != MIP_CACHE_MAGIC || header.Version != MIP_CACHE_VERSION || header.Key != key ||
+		header.LevelCount == 0 || header.LevelCount > MAX_MIP_LEVELS) {
+		// a stale entry just gets regenerated and overwritten
+		return false;
+	}
+
+	Level level;
+	level.Width = header.Width;
+	level.Height = header.Height;
+	size_t offset = sizeof(header);
+	for (GLuint i = 0; i < header.LevelCount; i++) {
+		size_t bytes = (size_t)level.Width * level.Height * 4;
+		if (offset + bytes > size) {
+			std::cout << "ERROR::MIP_CHAIN::TRUNCATED\n" << path << std::endl;
+			this->Levels.clear();
+			return false;
+		}
+		level.Data = data + offset;
+		this->Levels.push_back(level);
+		offset += bytes;
+		level.Width = level.Width > 1 ? level.Width / 2 : 1;
+		level.Height = level.Height > 1 ? level.Height / 2 : 1;
+	}
+	return true;
+}
+
+bool MipChain::Save(const char* path, GLuint64 key)
+{
+#ifdef _WIN32
+	_mkdir(MIP_CACHE_DIR);
+#else
+	mkdir(MIP_CACHE_DIR, 0755);
+#endif
+
+	// written under another name and renamed, so a reader never maps a half written chain
+	std::string partialPath = std::string(path) + ".partial";
+	{
+		std::ofstream file(partialPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!this->Write(file, key)) {
+			std::cout << "ERROR::MIP_CHAIN::NOT_WRITTEN\n" << path << std::endl;
+			return false;
+		}
+	}
+	std::remove(path);
+	if (std::rename(partialPath.c_str(), path) != 0) {
+		std::cout << "ERROR::MIP_CHAIN::NOT_WRITTEN\n" << path << std::endl;
+		std::remove(partialPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool MipChain::Write(std::ostream& file, GLuint64 key)
+{
+	MipCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.Magic = MIP_CACHE_MAGIC;
+	header.Version = MIP_CACHE_VERSION;
+	header.Key = key;
+	header.Width = this->Levels[0].Width;
+	header.Height = this->Levels[0].Height;
+	header.LevelCount = (GLuint)this->Levels.size();
+
+	file.write((const char*)&header, sizeof(header));
+	for (const Level& level : this->Levels) {
+		file.write((const char*)level.Data, (std::streamsize)level.Width * level.Height * 4);
+	}
+	return (bool)file;
+}
+
+GLuint MipChain::GetLevelCount()
+{
+	return (GLuint)this->Levels.size();
+}
+
+GLuint MipChain::GetWidth(GLuint level)
+{
+	return this->Levels[level].Width;
+}
+
+GLuint MipChain::GetHeight(GLuint level)
+{
+	return this->Levels[level].Height;
+}
+
+const unsigned char* MipChain::GetLevelData(GLuint level)
+{
+	return this->Levels[level].Data;
+}
+
+GLuint64 MipChain::GetTotalBytes()
+{
+	GLuint64 bytes = 0;
+	for (const Level& level : this->Levels) {
+		bytes += (GLuint64)level.Width * level.Height * 4;
+	}
+	return bytes;
+}
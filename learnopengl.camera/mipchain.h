@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "assetbundle.h"
+#include "mappedfile.h"
+#include "pixelconvert.h"
+
+// "LMIP", little-endian
+const GLuint MIP_CACHE_MAGIC = 0x50494D4C;
+const GLuint MIP_CACHE_VERSION = 2;
+// where generated chains are kept between runs, named by the hash of the file they came from
+const char* const MIP_CACHE_DIR = "./mipcache/";
+// enough for a 2^31 texel side
+const GLuint MAX_MIP_LEVELS = 32;
+
+enum MipFilter {
+	// 2x2 average; cheapest, but blurs and lets some aliasing through
+	MIP_FILTER_BOX,
+	// 8 tap Kaiser-windowed sinc; keeps smaller levels sharp without the aliasing
+	MIP_FILTER_KAISER,
+	MIP_FILTER_COUNT
+};
+const char* const MIP_FILTER_NAMES[] = { "box", "kaiser" };
+
+// a cache file starts with this, followed by every level's RGBA8 texels back to back, largest first
+struct MipCacheHeader
+{
+	GLuint Magic;
+	GLuint Version;
+	GLuint64 Key;
+	GLuint Width;
+	GLuint Height;
+	GLuint LevelCount;
+	GLuint Reserved;
+};
+
+static_assert(sizeof(MipCacheHeader) == 32, "MipCacheHeader must have no padding");
+
+// an RGBA8 image and the levels below it, halving (rounding down) to 1x1. either generated here or mapped from
+// the mip cache or the asset bundle, in which case levels are handed out straight from the mapping
+class MipChain
+{
+public:
+	MipChain();
+
+	MipChain(const MipChain&) = delete;
+	MipChain& operator=(const MipChain&) = delete;
+
+	// filters in linear light if srgb, so bright and dark texels average as they look; alpha is always linear.
+	// maxLevels 1 keeps just the top level. every path gives the same chain, to the bit
+	void Generate(const unsigned char* rgba, GLuint width, GLuint height, MipFilter filter, bool srgb, GLuint maxLevels = MAX_MIP_LEVELS,
+		PixelPath path = GetBestPixelPath());
+	// false if there's no cache file or it was written for another key
+	bool Load(const char* path, GLuint64 key);
+	bool Save(const char* path, GLuint64 key);
+	// the chain assetcook put in the asset bundle for the image at path, if it was filtered as srgb says; key gets
+	// the hash it would have in the mip cache. the image itself is never read
+	bool LoadCooked(const char* path, bool srgb, GLuint64* key);
+	// the chain as a cache file has it
+	bool Write(std::ostream& file, GLuint64 key);
+
+	GLuint GetLevelCount();
+	GLuint GetWidth(GLuint level);
+	GLuint GetHeight(GLuint level);
+	const unsigned char* GetLevelData(GLuint level);
+	// every level's bytes together
+	GLuint64 GetTotalBytes();
+
+private:
+	struct Level
+	{
+		GLuint Width;
+		GLuint Height;
+		const unsigned char* Data;
+	};
+
+	std::vector<Level> Levels;
+	// backs the levels if they were generated, File if they were loaded, Unpacked if the bundle stored them packed
+	std::vector<std::vector<unsigned char>> Generated;
+	MappedFile File;
+	std::vector<unsigned char> Unpacked;
+
+	// points the levels into a cache file's bytes
+	bool Parse(const unsigned char* data, size_t size, GLuint64 key, const char* path);
+};
+
+// halves an RGBA8 image, rounding down and never below 1, into (width / 2) * (height / 2) * 4 bytes of target
+void DownsampleImage(const unsigned char* source, GLuint width, GLuint height, MipFilter filter, bool srgb, unsigned char* target,
+	PixelPath path = GetBestPixelPath());
+// scales an RGBA8 image to any size; only MIP_FILTER_KAISER can do more than halve
+void ResizeImage(const unsigned char* source, GLuint width, GLuint height, GLuint targetWidth, GLuint targetHeight, MipFilter filter,
+	bool srgb, unsigned char* target, PixelPath path = GetBestPixelPath());
+
+// 64-bit FNV-1a over a source file and the settings its chain is generated with: the filter, and the size the
+// image was resized to first, 0 if it wasn't
+GLuint64 HashMipSource(const unsigned char* data, size_t size, MipFilter filter, bool srgb, GLuint width = 0, GLuint height = 0);
+std::string GetMipCachePath(GLuint64 key);
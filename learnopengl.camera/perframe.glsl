@@ -0,0 +1,9 @@
+// per-frame values shared by every program; mirrors PerFrameUniforms in uniformbuffer.h
+
+layout (std140) uniform PerFrame
+{
+	mat4 view;
+	mat4 projection;
+	vec3 cameraPosition;
+	float time;
+};
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pixelconvert.h"
+
+// runs per measurement; the best is reported, which is the one least disturbed by everything else on the machine
+const GLuint BENCH_RUNS = 5;
+// a 2048x2048 image, big enough that every kernel streams from memory rather than cache, as it would on a real load
+const size_t BENCH_PIXELS = 2048 * 2048;
+
+// one kernel on one path, reading and writing buffers the benchmark owns
+struct BenchKernel
+{
+	std::string Name;
+	// bytes read and written per texel, which is what the GB/s counts
+	GLuint BytesPerPixel;
+	std::function<void(PixelPath)> Run;
+	// what to compare between paths once the kernel has run
+	std::function<std::vector<unsigned char>()> Output;
+};
+
+static GLdouble SecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<GLdouble>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// times every conversion kernel on each path this CPU can run, against the scalar one, and checks they all agree
+int main()
+{
+	std::vector<unsigned char> rgb(BENCH_PIXELS * 3), rgba(BENCH_PIXELS * 4), scratch(BENCH_PIXELS * 4);
+	std::vector<GLfloat> linear(BENCH_PIXELS * 4);
+	for (unsigned char& byte : rgb) {
+		byte = (unsigned char)std::rand();
+	}
+	for (unsigned char& byte : rgba) {
+		byte = (unsigned char)std::rand();
+	}
+	for (GLfloat& value : linear) {
+		// a little either side of 0-1, so the clamps are exercised too
+		value = std::rand() / (GLfloat)RAND_MAX * 1.2f - 0.1f;
+	}
+	const unsigned char bgra[4] = { 2, 1, 0, 3 };
+
+	auto bytesOf = [](const void* data, size_t size) {
+		return std::vector<unsigned char>((const unsigned char*)data, (const unsigned char*)data + size);
+	};
+	std::vector<GLfloat> linearOut(BENCH_PIXELS * 4);
+	std::vector<BenchKernel> kernels = {
+		{ "RGB to RGBA", 7, [&](PixelPath path) { ExpandRGBToRGBA(rgb.data(), scratch.data(), BENCH_PIXELS, path); },
+			[&] { return scratch; } },
+		{ "sRGB to linear", 20, [&](PixelPath path) { ConvertToLinear(rgba.data(), linearOut.data(), BENCH_PIXELS, true, path); },
+			[&] { return bytesOf(linearOut.data(), linearOut.size() * sizeof(GLfloat)); } },
+		{ "unorm to linear", 20, [&](PixelPath path) { ConvertToLinear(rgba.data(), linearOut.data(), BENCH_PIXELS, false, path); },
+			[&] { return bytesOf(linearOut.data(), linearOut.size() * sizeof(GLfloat)); } },
+		{ "linear to sRGB", 20, [&](PixelPath path) { ConvertFromLinear(linear.data(), scratch.data(), BENCH_PIXELS, true, path); },
+			[&] { return scratch; } },
+		{ "linear to unorm", 20, [&](PixelPath path) { ConvertFromLinear(linear.data(), scratch.data(), BENCH_PIXELS, false, path); },
+			[&] { return scratch; } },
+		// in place kernels start from a fresh copy each run; the copy isn't timed
+		{ "premultiply alpha", 8, [&](PixelPath path) { PremultiplyAlpha(scratch.data(), BENCH_PIXELS, path); },
+			[&] { return scratch; } },
+		{ "swizzle BGRA", 8, [&](PixelPath path) { SwizzleRGBA(rgba.data(), scratch.data(), BENCH_PIXELS, bgra, path); },
+			[&] { return scratch; } },
+		{ "flip rows", 8, [&](PixelPath path) { FlipRows(scratch.data(), 2048 * 4, (GLuint)(BENCH_PIXELS / 2048), path); },
+			[&] { return scratch; } }
+	};
+
+	PixelPath best = GetBestPixelPath();
+	std::cout << "INFO: widest path on this CPU: " << PIXEL_PATH_NAMES[best] << std::endl;
+	for (const BenchKernel& kernel : kernels) {
+		std::vector<unsigned char> expected;
+		GLdouble scalarTime = 0.0;
+		for (GLuint path = PIXEL_PATH_SCALAR; path <= (GLuint)best; path++) {
+			GLdouble fastest = 1e9;
+			for (GLuint run = 0; run < BENCH_RUNS; run++) {
+				std::memcpy(scratch.data(), rgba.data(), scratch.size());
+				auto start = std::chrono::high_resolution_clock::now();
+				kernel.Run((PixelPath)path);
+				fastest = std::min(fastest, SecondsSince(start));
+			}
+
+			std::vector<unsigned char> output = kernel.Output();
+			if (path == PIXEL_PATH_SCALAR) {
+				expected = output;
+				scalarTime = fastest;
+			}
+			else if (output != expected) {
+				std::cout << "ERROR::PIXELBENCH::MISMATCH\n" << kernel.Name << " " << PIXEL_PATH_NAMES[path] << " differs from scalar" << std::endl;
+			}
+			std::cout << "INFO: " << kernel.Name << " " << PIXEL_PATH_NAMES[path] << ": " << BENCH_PIXELS * kernel.BytesPerPixel / (fastest * 1e9)
+				<< " GB/s, " << scalarTime / fastest << "x scalar" << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,486 @@
+#include "pixelconvert.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "simd.h"
+
+static PixelPath DetectPixelPath()
+{
+#ifdef SIMD_SSE2
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		// the OS has to save the wide registers across context switches as well
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		if (osSavesYmm && (info[1] & (1 << 5)) != 0) {
+			return PIXEL_PATH_AVX2;
+		}
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return PIXEL_PATH_AVX2;
+	}
+#endif
+	return PIXEL_PATH_SSE2;
+#else
+	return PIXEL_PATH_SCALAR;
+#endif
+}
+
+PixelPath GetBestPixelPath()
+{
+	static PixelPath best = DetectPixelPath();
+	return best;
+}
+
+static PixelPath ClampPath(PixelPath path)
+{
+	PixelPath best = GetBestPixelPath();
+	return path < best ? path : best;
+}
+
+// bytes to floats: the first 256 entries decode sRGB, the second 256 just scale
+static const GLfloat* GetByteToLinear()
+{
+	static std::vector<GLfloat> table = [] {
+		std::vector<GLfloat> values(512);
+		for (GLuint i = 0; i < 256; i++) {
+			GLfloat c = i / 255.0f;
+			values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			values[256 + i] = c;
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+static const unsigned char* GetLinearToSrgb()
+{
+	static std::vector<unsigned char> table = [] {
+		std::vector<unsigned char> values(LINEAR_TO_SRGB_STEPS);
+		for (GLuint i = 0; i < LINEAR_TO_SRGB_STEPS; i++) {
+			GLfloat l = i / (GLfloat)(LINEAR_TO_SRGB_STEPS - 1);
+			GLfloat c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			values[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+// each vector kernel does what it can in whole registers and returns how many texels that was; the scalar loop
+// after it finishes the rest
+
+#ifdef SIMD_SSE2
+static size_t ExpandRGBToRGBASse2(const unsigned char* source, unsigned char* target, size_t pixels)
+{
+	// four texels per 16-byte load, lined up by byte shifts; the load reads past them, so the last few are left over
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	size_t i = 0;
+	for (; i + 6 <= pixels; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(source + i * 3));
+		__m128i lo = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+		__m128i hi = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+		_mm_storeu_si128((__m128i*)(target + i * 4), _mm_or_si128(_mm_unpacklo_epi64(lo, hi), alpha));
+	}
+	return i;
+}
+
+SIMD_AVX2_FUNCTION static size_t ExpandRGBToRGBAAvx2(const unsigned char* source, unsigned char* target, size_t pixels)
+{
+	// eight texels per 32-byte load: the permute gives each lane the twelve bytes of its four, the shuffle spreads them
+	const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	size_t i = 0;
+	for (; i + 11 <= pixels; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(source + i * 3));
+		v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, spread), shuffle);
+		_mm256_storeu_si256((__m256i*)(target + i * 4), _mm256_or_si256(v, alpha));
+	}
+	return i;
+}
+#endif
+
+void ExpandRGBToRGBA(const unsigned char* source, unsigned char* target, size_t pixels, PixelPath path)
+{
+	size_t i = 0;
+#ifdef SIMD_SSE2
+	path = ClampPath(path);
+	if (path == PIXEL_PATH_AVX2) {
+		i = ExpandRGBToRGBAAvx2(source, target, pixels);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		i = ExpandRGBToRGBASse2(source, target, pixels);
+	}
+#endif
+	for (; i < pixels; i++) {
+		target[i * 4] = source[i * 3];
+		target[i * 4 + 1] = source[i * 3 + 1];
+		target[i * 4 + 2] = source[i * 3 + 2];
+		target[i * 4 + 3] = 255;
+	}
+}
+
+#ifdef SIMD_SSE2
+static size_t ConvertToLinearSse2(const unsigned char* source, GLfloat* target, size_t pixels, bool srgb)
+{
+	// there's no gather before AVX2, so decoding sRGB stays with the table
+	if (srgb) {
+		return 0;
+	}
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(255.0f);
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(source + i * 4));
+		__m128i words[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+		for (GLuint k = 0; k < 2; k++) {
+			// divided rather than multiplied by the reciprocal, so the results match the table's to the bit
+			_mm_storeu_ps(target + (i + k * 2) * 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words[k], zero)), scale));
+			_mm_storeu_ps(target + (i + k * 2 + 1) * 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words[k], zero)), scale));
+		}
+	}
+	return i;
+}
+
+SIMD_AVX2_FUNCTION static size_t ConvertToLinearAvx2(const unsigned char* source, GLfloat* target, size_t pixels, bool srgb)
+{
+	// two texels per register; sRGB is gathered from the table, alpha from its linear half
+	const GLfloat* table = GetByteToLinear();
+	const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+	const __m256 scale = _mm256_set1_ps(255.0f);
+	size_t i = 0;
+	for (; i + 2 <= pixels; i += 2) {
+		__m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + i * 4)));
+		__m256 values = srgb ? _mm256_i32gather_ps(table, _mm256_add_epi32(bytes, alphaOffset), 4) : _mm256_div_ps(_mm256_cvtepi32_ps(bytes), scale);
+		_mm256_storeu_ps(target + i * 4, values);
+	}
+	return i;
+}
+#endif
+
+void ConvertToLinear(const unsigned char* source, GLfloat* target, size_t pixels, bool srgb, PixelPath path)
+{
+	size_t i = 0;
+#ifdef SIMD_SSE2
+	path = ClampPath(path);
+	if (path == PIXEL_PATH_AVX2) {
+		i = ConvertToLinearAvx2(source, target, pixels, srgb);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		i = ConvertToLinearSse2(source, target, pixels, srgb);
+	}
+#endif
+	const GLfloat* toLinear = GetByteToLinear() + (srgb ? 0 : 256);
+	const GLfloat* toUnorm = GetByteToLinear() + 256;
+	for (; i < pixels; i++) {
+		target[i * 4] = toLinear[source[i * 4]];
+		target[i * 4 + 1] = toLinear[source[i * 4 + 1]];
+		target[i * 4 + 2] = toLinear[source[i * 4 + 2]];
+		target[i * 4 + 3] = toUnorm[source[i * 4 + 3]];
+	}
+}
+
+#ifdef SIMD_SSE2
+static size_t ConvertFromLinearSse2(const GLfloat* source, unsigned char* target, size_t pixels, bool srgb)
+{
+	// one texel per register, clamped and scaled to table steps (color) or bytes (alpha)
+	const GLfloat rgbScale = srgb ? (GLfloat)(LINEAR_TO_SRGB_STEPS - 1) : 255.0f;
+	const __m128 scale = _mm_setr_ps(rgbScale, rgbScale, rgbScale, 255.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	size_t i = 0;
+	if (!srgb) {
+		// four texels packed down to bytes together
+		for (; i + 4 <= pixels; i += 4) {
+			__m128i texels[4];
+			for (GLuint k = 0; k < 4; k++) {
+				__m128 l = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + (i + k) * 4), zero), one);
+				texels[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(l, scale), half));
+			}
+			__m128i words = _mm_packus_epi16(_mm_packs_epi32(texels[0], texels[1]), _mm_packs_epi32(texels[2], texels[3]));
+			_mm_storeu_si128((__m128i*)(target + i * 4), words);
+		}
+		return i;
+	}
+
+	// the table lookups are scalar, but the clamping and scaling before them aren't
+	const unsigned char* toSrgb = GetLinearToSrgb();
+	for (; i < pixels; i++) {
+		GLint scaled[4];
+		__m128 l = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i * 4), zero), one);
+		_mm_storeu_si128((__m128i*)scaled, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(l, scale), half)));
+		target[i * 4] = toSrgb[scaled[0]];
+		target[i * 4 + 1] = toSrgb[scaled[1]];
+		target[i * 4 + 2] = toSrgb[scaled[2]];
+		target[i * 4 + 3] = (unsigned char)scaled[3];
+	}
+	return i;
+}
+
+SIMD_AVX2_FUNCTION static size_t ConvertFromLinearAvx2(const GLfloat* source, unsigned char* target, size_t pixels, bool srgb)
+{
+	// two texels per register
+	const GLfloat rgbScale = srgb ? (GLfloat)(LINEAR_TO_SRGB_STEPS - 1) : 255.0f;
+	const __m256 scale = _mm256_setr_ps(rgbScale, rgbScale, rgbScale, 255.0f, rgbScale, rgbScale, rgbScale, 255.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	size_t i = 0;
+	if (!srgb) {
+		// packing works within lanes, leaving the even texels in the low one and the odd in the high; the permute
+		// puts them back in order
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		for (; i + 8 <= pixels; i += 8) {
+			__m256i texels[4];
+			for (GLuint k = 0; k < 4; k++) {
+				__m256 l = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source + (i + k * 2) * 4), zero), one);
+				texels[k] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(l, scale), half));
+			}
+			__m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(texels[0], texels[1]), _mm256_packs_epi32(texels[2], texels[3]));
+			_mm256_storeu_si256((__m256i*)(target + i * 4), _mm256_permutevar8x32_epi32(bytes, order));
+		}
+		return i;
+	}
+
+	const unsigned char* toSrgb = GetLinearToSrgb();
+	for (; i + 2 <= pixels; i += 2) {
+		GLint scaled[8];
+		__m256 l = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source + i * 4), zero), one);
+		_mm256_storeu_si256((__m256i*)scaled, _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(l, scale), half)));
+		for (GLuint k = 0; k < 8; k += 4) {
+			target[i * 4 + k] = toSrgb[scaled[k]];
+			target[i * 4 + k + 1] = toSrgb[scaled[k + 1]];
+			target[i * 4 + k + 2] = toSrgb[scaled[k + 2]];
+			target[i * 4 + k + 3] = (unsigned char)scaled[k + 3];
+		}
+	}
+	return i;
+}
+#endif
+
+void ConvertFromLinear(const GLfloat* source, unsigned char* target, size_t pixels, bool srgb, PixelPath path)
+{
+	size_t i = 0;
+#ifdef SIMD_SSE2
+	path = ClampPath(path);
+	if (path == PIXEL_PATH_AVX2) {
+		i = ConvertFromLinearAvx2(source, target, pixels, srgb);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		i = ConvertFromLinearSse2(source, target, pixels, srgb);
+	}
+#endif
+	const unsigned char* toSrgb = GetLinearToSrgb();
+	const GLfloat rgbScale = srgb ? (GLfloat)(LINEAR_TO_SRGB_STEPS - 1) : 255.0f;
+	for (; i < pixels; i++) {
+		for (GLuint c = 0; c < 4; c++) {
+			GLfloat l = source[i * 4 + c];
+			l = l < 0.0f ? 0.0f : (l > 1.0f ? 1.0f : l);
+			GLint scaled = (GLint)(l * (c < 3 ? rgbScale : 255.0f) + 0.5f);
+			target[i * 4 + c] = srgb && c < 3 ? toSrgb[scaled] : (unsigned char)scaled;
+		}
+	}
+}
+
+#ifdef SIMD_SSE2
+// (c * a + 128) / 255, rounded exactly, on texels widened to 16 bits; alpha is multiplied by 255, which leaves it be
+static inline __m128i PremultiplyWordsSse2(__m128i texels)
+{
+	const __m128i colorMask = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+	const __m128i alphaOne = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(texels, _mm_or_si128(_mm_and_si128(alpha, colorMask), alphaOne)), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static size_t PremultiplyAlphaSse2(unsigned char* rgba, size_t pixels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+		__m128i lo = PremultiplyWordsSse2(_mm_unpacklo_epi8(v, zero));
+		__m128i hi = PremultiplyWordsSse2(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_packus_epi16(lo, hi));
+	}
+	return i;
+}
+
+SIMD_AVX2_FUNCTION static inline __m256i PremultiplyWordsAvx2(__m256i texels)
+{
+	const __m256i colorMask = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+	const __m256i alphaOne = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+	__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(texels, _mm256_or_si256(_mm256_and_si256(alpha, colorMask), alphaOne)), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+SIMD_AVX2_FUNCTION static size_t PremultiplyAlphaAvx2(unsigned char* rgba, size_t pixels)
+{
+	// unpacking and packing both work within lanes, so the texels come back where they were
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= pixels; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+		__m256i lo = PremultiplyWordsAvx2(_mm256_unpacklo_epi8(v, zero));
+		__m256i hi = PremultiplyWordsAvx2(_mm256_unpackhi_epi8(v, zero));
+		_mm256_storeu_si256((__m256i*)(rgba + i * 4), _mm256_packus_epi16(lo, hi));
+	}
+	return i;
+}
+#endif
+
+void PremultiplyAlpha(unsigned char* rgba, size_t pixels, PixelPath path)
+{
+	size_t i = 0;
+#ifdef SIMD_SSE2
+	path = ClampPath(path);
+	if (path == PIXEL_PATH_AVX2) {
+		i = PremultiplyAlphaAvx2(rgba, pixels);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		i = PremultiplyAlphaSse2(rgba, pixels);
+	}
+#endif
+	for (; i < pixels; i++) {
+		GLuint alpha = rgba[i * 4 + 3];
+		for (GLuint c = 0; c < 3; c++) {
+			GLuint x = rgba[i * 4 + c] * alpha + 128;
+			rgba[i * 4 + c] = (unsigned char)((x + (x >> 8)) >> 8);
+		}
+	}
+}
+
+#ifdef SIMD_SSE2
+static size_t SwizzleRGBASse2(const unsigned char* source, unsigned char* target, size_t pixels, const unsigned char order[4])
+{
+	// no byte shuffle before SSSE3, so each channel is shifted down out of its source place and up into its target
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	__m128i shiftDown[4], shiftUp[4];
+	for (GLuint c = 0; c < 4; c++) {
+		shiftDown[c] = _mm_cvtsi32_si128(order[c] * 8);
+		shiftUp[c] = _mm_cvtsi32_si128(c * 8);
+	}
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(source + i * 4));
+		__m128i swizzled = _mm_setzero_si128();
+		for (GLuint c = 0; c < 4; c++) {
+			swizzled = _mm_or_si128(swizzled, _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(v, shiftDown[c]), byteMask), shiftUp[c]));
+		}
+		_mm_storeu_si128((__m128i*)(target + i * 4), swizzled);
+	}
+	return i;
+}
+
+SIMD_AVX2_FUNCTION static size_t SwizzleRGBAAvx2(const unsigned char* source, unsigned char* target, size_t pixels, const unsigned char order[4])
+{
+	char pattern[32];
+	for (GLuint b = 0; b < 32; b++) {
+		pattern[b] = (char)((b % 16) / 4 * 4 + order[b % 4]);
+	}
+	const __m256i shuffle = _mm256_loadu_si256((const __m256i*)pattern);
+	size_t i = 0;
+	for (; i + 8 <= pixels; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(source + i * 4));
+		_mm256_storeu_si256((__m256i*)(target + i * 4), _mm256_shuffle_epi8(v, shuffle));
+	}
+	return i;
+}
+#endif
+
+void SwizzleRGBA(const unsigned char* source, unsigned char* target, size_t pixels, const unsigned char order[4], PixelPath path)
+{
+	size_t i = 0;
+#ifdef SIMD_SSE2
+	path = ClampPath(path);
+	if (path == PIXEL_PATH_AVX2) {
+		i = SwizzleRGBAAvx2(source, target, pixels, order);
+	}
+	else if (path == PIXEL_PATH_SSE2) {
+		i = SwizzleRGBASse2(source, target, pixels, order);
+	}
+#endif
+	for (; i < pixels; i++) {
+		unsigned char texel[4] = { source[i * 4], source[i * 4 + 1], source[i * 4 + 2], source[i * 4 + 3] };
+		for (GLuint c = 0; c < 4; c++) {
+			target[i * 4 + c] = texel[order[c]];
+		}
+	}
+}
+
+#ifdef SIMD_SSE2
+static size_t SwapBytesSse2(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(a + i), vb);
+		_mm_storeu_si128((__m128i*)(b + i), va);
+	}
+	return i;
+}
+
+SIMD_AVX2_FUNCTION static size_t SwapBytesAvx2(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(a + i), vb);
+		_mm256_storeu_si256((__m256i*)(b + i), va);
+	}
+	return i;
+}
+#endif
+
+void FlipRows(unsigned char* data, size_t rowBytes, GLuint rows, PixelPath path)
+{
+#ifdef SIMD_SSE2
+	path = ClampPath(path);
+#endif
+	for (GLuint y = 0; y < rows / 2; y++) {
+		unsigned char* top = data + (size_t)y * rowBytes;
+		unsigned char* bottom = data + (size_t)(rows - 1 - y) * rowBytes;
+		size_t i = 0;
+#ifdef SIMD_SSE2
+		if (path == PIXEL_PATH_AVX2) {
+			i = SwapBytesAvx2(top, bottom, rowBytes);
+		}
+		else if (path == PIXEL_PATH_SSE2) {
+			i = SwapBytesSse2(top, bottom, rowBytes);
+		}
+#endif
+		for (; i < rowBytes; i++) {
+			unsigned char swapped = top[i];
+			top[i] = bottom[i];
+			bottom[i] = swapped;
+		}
+	}
+}
+
+void ConvertToUploadLayout(const unsigned char* source, GLuint width, GLuint height, GLuint channels, unsigned char* target)
+{
+	for (GLuint y = 0; y < height; y++) {
+		const unsigned char* sourceRow = source + (size_t)(height - 1 - y) * width * channels;
+		unsigned char* targetRow = target + (size_t)y * width * 4;
+		if (channels == 3) {
+			ExpandRGBToRGBA(sourceRow, targetRow, width);
+		}
+		else {
+			std::memcpy(targetRow, sourceRow, (size_t)width * 4);
+			PremultiplyAlpha(targetRow, width);
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// linear values are looked up in this many steps on the way back to sRGB; fine enough that even the darkest
+// sRGB steps, about 0.0003 apart, land on the right byte
+const GLuint LINEAR_TO_SRGB_STEPS = 65536;
+
+// which kernels to run. SSE2 is there whenever the build targets it; AVX2 is compiled in alongside and used only
+// if the CPU has it
+enum PixelPath {
+	PIXEL_PATH_SCALAR,
+	PIXEL_PATH_SSE2,
+	PIXEL_PATH_AVX2,
+	PIXEL_PATH_COUNT
+};
+const char* const PIXEL_PATH_NAMES[] = { "scalar", "SSE2", "AVX2" };
+
+// the widest path this build and this CPU can run; asking any kernel for a wider one gets this
+PixelPath GetBestPixelPath();
+
+// RGB8 to RGBA8 with opaque alpha. drivers expand 3-byte texels on the CPU at upload anyway, and RGB rows of odd
+// widths break GL's default 4-byte row alignment
+void ExpandRGBToRGBA(const unsigned char* source, unsigned char* target, size_t pixels, PixelPath path = GetBestPixelPath());
+// RGBA8 to floats in 0-1; color is decoded from sRGB if srgb, alpha is always linear
+void ConvertToLinear(const unsigned char* source, GLfloat* target, size_t pixels, bool srgb, PixelPath path = GetBestPixelPath());
+// the other way, clamping to 0-1 first and rounding to the nearest byte (through LINEAR_TO_SRGB_STEPS if srgb)
+void ConvertFromLinear(const GLfloat* source, unsigned char* target, size_t pixels, bool srgb, PixelPath path = GetBestPixelPath());
+// scales color by alpha, rounding exactly, so filtering and blending never pull in the color of transparent texels.
+// in place
+void PremultiplyAlpha(unsigned char* rgba, size_t pixels, PixelPath path = GetBestPixelPath());
+// target channel c of every texel takes source channel order[c]; { 2, 1, 0, 3 } turns BGRA into RGBA and back.
+// source and target may be the same
+void SwizzleRGBA(const unsigned char* source, unsigned char* target, size_t pixels, const unsigned char order[4], PixelPath path = GetBestPixelPath());
+// reverses the order of rows in place
+void FlipRows(unsigned char* data, size_t rowBytes, GLuint rows, PixelPath path = GetBestPixelPath());
+
+// turns a decoded image of 3 or 4 channels, top row first as image files have it, into the layout textures are
+// uploaded in: RGBA8, bottom row first as GL's texture coordinates have it, color premultiplied by alpha. one pass,
+// a row at a time, so each row is converted while it's still in cache
+void ConvertToUploadLayout(const unsigned char* source, GLuint width, GLuint height, GLuint channels, unsigned char* target);
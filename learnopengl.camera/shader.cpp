@@ -0,0 +1,849 @@
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "shader.h"
+#include "assetbundle.h"
+#include "filewatcher.h"
+#include "glstate.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+Shader::Shader(const GLchar * vertexShaderPath, const GLchar * fragmentShaderPath, GLboolean async,
+	const std::vector<std::string>& defines)
+	: ProgramId(0),
+	Defines(defines),
+	VertexShaderId(0),
+	FragmentShaderId(0),
+	Ready(GL_FALSE),
+	CacheHit(GL_FALSE),
+	ReloadPending(false)
+{
+	// I would say the constructor shouldn't have IO logic in it, it should just rely on chars
+	this->VertexShaderPath = vertexShaderPath;
+	this->FragmentShaderPath = fragmentShaderPath;
+	this->Name = this->VertexShaderPath + " + " + this->FragmentShaderPath;
+	for (const std::string& define : this->Defines) {
+		this->Name += " " + define;
+	}
+
+	// 1. retrieve the vertex/ fragment source code from file path, resolving includes and defines
+	std::string vertexShaderCode;
+	std::string fragmentShaderCode;
+	ReadSources(vertexShaderCode, fragmentShaderCode, &this->IncludedFiles, true);
+
+	// 2. submit the compile and link; nothing here waits on the driver
+	BeginBuild(vertexShaderCode, fragmentShaderCode);
+
+	// synchronous callers get a finished program straight away
+	if (!async) {
+		FinishBuild();
+	}
+}
+
+Shader::~Shader()
+{
+	// defined here, where FileWatcher is complete; the watcher thread is stopped once the body has run
+	if (this->VertexShaderId != 0) {
+		glDeleteShader(this->VertexShaderId);
+		glDeleteShader(this->FragmentShaderId);
+	}
+	glState.DeleteProgram(this->ProgramId);
+}
+
+bool Shader::ReadSources(std::string& vertexShaderCode, std::string& fragmentShaderCode, std::vector<std::string>* includedFiles, bool cooked)
+{
+	std::vector<std::string> vertexIncludes, fragmentIncludes;
+	if (!PreprocessFile(this->VertexShaderPath, vertexShaderCode, vertexIncludes, cooked) ||
+		!PreprocessFile(this->FragmentShaderPath, fragmentShaderCode, fragmentIncludes, cooked)) {
+		return false;
+	}
+
+	// the top-level files come first in each list
+	if (includedFiles != nullptr) {
+		includedFiles->clear();
+		includedFiles->insert(includedFiles->end(), vertexIncludes.begin() + 1, vertexIncludes.end());
+		includedFiles->insert(includedFiles->end(), fragmentIncludes.begin() + 1, fragmentIncludes.end());
+	}
+
+	return true;
+}
+
+bool Shader::PreprocessFile(const std::string& path, std::string& output, std::vector<std::string>& includedFiles, bool cooked)
+{
+	// each file is pulled in at most once per stage, which also breaks include cycles
+	for (const std::string& included : includedFiles) {
+		if (included == path) {
+			return true;
+		}
+	}
+	bool topLevel = includedFiles.empty();
+	includedFiles.push_back(path);
+
+	std::string code;
+	const AssetBundleEntry* entry = cooked ? assetBundle.Find(path.c_str(), ASSET_SHADER_SOURCE) : nullptr;
+	if (entry != nullptr) {
+		// cooked with the comments gone but every line where it was, so #line and the compiler's errors still match
+		std::vector<unsigned char> unpacked;
+		const unsigned char* data = assetBundle.GetData(*entry, unpacked);
+		if (data == nullptr) {
+			return false;
+		}
+		code.assign((const char*)data, (size_t)entry->UnpackedBytes);
+	}
+	else {
+		std::ifstream shaderFile;
+
+		// ensures ifstream objects can throw exceptions
+		shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+		try
+		{
+			// read file's buffer contents into a stream
+			shaderFile.open(path.c_str());
+			std::stringstream shaderStream;
+			shaderStream << shaderFile.rdbuf();
+			shaderFile.close();
+			code = shaderStream.str();
+		}
+		catch (std::ifstream::failure e)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n" << path << std::endl;
+			return false;
+		}
+	}
+
+	// includes are resolved relative to the including file
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	std::istringstream lines(code);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line)) {
+		lineNumber++;
+
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+			size_t open = line.find('"', start);
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				std::cout << "ERROR::SHADER::MALFORMED_INCLUDE\n" << path << ":" << lineNumber << std::endl;
+				return false;
+			}
+
+			output += "#line 1\n";
+			if (!PreprocessFile(directory + line.substr(open + 1, close - open - 1), output, includedFiles, cooked)) {
+				return false;
+			}
+			// keep the compiler's line numbers matching the including file
+			output += "#line " + std::to_string(lineNumber + 1) + "\n";
+			continue;
+		}
+
+		output += line;
+		output += '\n';
+
+		// defines go straight after #version, which must stay the first statement
+		if (topLevel && start != std::string::npos && line.compare(start, 8, "#version") == 0 && !this->Defines.empty()) {
+			for (const std::string& define : this->Defines) {
+				size_t equals = define.find('=');
+				output += "#define " + (equals == std::string::npos ? define : define.substr(0, equals) + " " + define.substr(equals + 1)) + "\n";
+			}
+			output += "#line " + std::to_string(lineNumber + 1) + "\n";
+		}
+	}
+
+	return true;
+}
+
+void Shader::BeginBuild(const std::string& vertexShaderCode, const std::string& fragmentShaderCode)
+{
+	// try the on-disk program binary cache before paying for a full compile and link
+	this->BuildStart = std::chrono::steady_clock::now();
+	this->CacheKey = HashProgramSources(vertexShaderCode, fragmentShaderCode);
+	this->CacheHit = LoadProgramBinary(this->CacheKey) ? GL_TRUE : GL_FALSE;
+	if (this->CacheHit) {
+		return;
+	}
+
+	const GLchar* vertexShaderCodeString = vertexShaderCode.c_str();
+	const GLchar* fragmentShaderCodeString = fragmentShaderCode.c_str();
+
+	// compile the shaders and link the program, deferring every status query to FinishBuild
+	CreateShader(&this->VertexShaderId, vertexShaderCodeString, GL_VERTEX_SHADER);
+	CreateShader(&this->FragmentShaderId, fragmentShaderCodeString, GL_FRAGMENT_SHADER);
+	CreateShaderProgram(&this->ProgramId, this->VertexShaderId, this->FragmentShaderId);
+}
+
+void Shader::FinishBuild()
+{
+	if (!this->CacheHit) {
+		// querying status blocks until the driver is done, which is why async callers poll first
+		CheckForShaderErrors(this->VertexShaderId);
+		CheckForShaderErrors(this->FragmentShaderId);
+		CheckForProgramErrors(this->ProgramId);
+
+		// delete the shaders as they're linked into our program now and no longer necessary
+		glDeleteShader(this->VertexShaderId);
+		glDeleteShader(this->FragmentShaderId);
+		this->VertexShaderId = 0;
+		this->FragmentShaderId = 0;
+
+		SaveProgramBinary(this->CacheKey);
+	}
+
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::steady_clock::now() - this->BuildStart;
+	std::cout << "INFO: Shader program " << this->Name
+		<< (this->CacheHit ? " loaded from binary cache" : " compiled from source")
+		<< " in " << buildTime.count() << " ms" << std::endl;
+
+	OnProgramLinked();
+	this->Ready = GL_TRUE;
+}
+
+bool Shader::IsReady()
+{
+	if (this->Ready) {
+		return true;
+	}
+
+	// without KHR_parallel_shader_compile we can't ask without blocking, so finish on first poll
+	if (!this->CacheHit && GLEW_KHR_parallel_shader_compile) {
+		GLint completed = GL_FALSE;
+		glGetProgramiv(this->ProgramId, GL_COMPLETION_STATUS_KHR, &completed);
+		if (!completed) {
+			return false;
+		}
+	}
+
+	FinishBuild();
+	return true;
+}
+
+void Shader::Watch()
+{
+	// runs on the watcher thread: do the file IO here so the render thread only compiles
+	std::vector<std::string> watchedFiles = { this->VertexShaderPath, this->FragmentShaderPath };
+	watchedFiles.insert(watchedFiles.end(), this->IncludedFiles.begin(), this->IncludedFiles.end());
+	this->Watcher.reset(new FileWatcher(watchedFiles, [this]() {
+		std::string vertexShaderCode, fragmentShaderCode;
+		std::vector<std::string> includedFiles;
+		if (!ReadSources(vertexShaderCode, fragmentShaderCode, &includedFiles)) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(this->ReloadMutex);
+		this->ReloadVertexShaderCode = vertexShaderCode;
+		this->ReloadFragmentShaderCode = fragmentShaderCode;
+		this->ReloadIncludedFiles = includedFiles;
+		this->ReloadPending = true;
+	}));
+}
+
+bool Shader::Update()
+{
+	// a reload waits until the initial build is done so we always have a program to fall back on
+	if (!this->Ready || !this->ReloadPending.exchange(false)) {
+		return false;
+	}
+
+	std::string vertexShaderCode, fragmentShaderCode;
+	std::vector<std::string> includedFiles;
+	{
+		std::lock_guard<std::mutex> lock(this->ReloadMutex);
+		vertexShaderCode.swap(this->ReloadVertexShaderCode);
+		fragmentShaderCode.swap(this->ReloadFragmentShaderCode);
+		includedFiles.swap(this->ReloadIncludedFiles);
+	}
+
+	// the edit may have added or dropped #includes: watch what the sources pull in now, even if they don't compile,
+	// so fixing a broken include still triggers a reload. this joins the old watcher thread, so not under the lock
+	if (includedFiles != this->IncludedFiles) {
+		this->IncludedFiles.swap(includedFiles);
+		Watch();
+	}
+
+	GLuint vertexShaderId, fragmentShaderId, programId;
+	CreateShader(&vertexShaderId, vertexShaderCode.c_str(), GL_VERTEX_SHADER);
+	CreateShader(&fragmentShaderId, fragmentShaderCode.c_str(), GL_FRAGMENT_SHADER);
+	CreateShaderProgram(&programId, vertexShaderId, fragmentShaderId);
+
+	// check every stage so a broken edit reports all of its errors at once
+	bool vertexOk = CheckForShaderErrors(vertexShaderId);
+	bool fragmentOk = CheckForShaderErrors(fragmentShaderId);
+	bool programOk = CheckForProgramErrors(programId);
+
+	glDeleteShader(vertexShaderId);
+	glDeleteShader(fragmentShaderId);
+
+	if (!vertexOk || !fragmentOk || !programOk) {
+		std::cout << "ERROR::SHADER::RELOAD_FAILED\n" << this->Name << " keeps its previous program" << std::endl;
+		glState.DeleteProgram(programId);
+		return false;
+	}
+
+	// swap in the new program only now that we know it linked
+	glState.DeleteProgram(this->ProgramId);
+	this->ProgramId = programId;
+	this->CacheKey = HashProgramSources(vertexShaderCode, fragmentShaderCode);
+	SaveProgramBinary(this->CacheKey);
+	OnProgramLinked();
+
+	std::cout << "INFO: Shader program " << this->Name << " reloaded" << std::endl;
+	return true;
+}
+
+void Shader::Use()
+{
+	glState.UseProgram(this->ProgramId);
+}
+
+GLuint Shader::GetProgramId()
+{
+	return this->ProgramId;
+}
+
+void Shader::Set(GLuint nameHash, const glm::mat4& value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, glm::value_ptr(value), 16 * sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniformMatrix4fv(uniform->Location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void Shader::Set(GLuint nameHash, const glm::vec3& value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, glm::value_ptr(value), 3 * sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniform3fv(uniform->Location, 1, glm::value_ptr(value));
+	}
+}
+
+void Shader::Set(GLuint nameHash, const glm::vec2& value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, glm::value_ptr(value), 2 * sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniform2fv(uniform->Location, 1, glm::value_ptr(value));
+	}
+}
+
+void Shader::Set(GLuint nameHash, GLfloat value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, &value, sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniform1f(uniform->Location, value);
+	}
+}
+
+void Shader::Set(GLuint nameHash, GLint value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, &value, sizeof(GLint));
+	if (uniform != nullptr) {
+		glUniform1i(uniform->Location, value);
+	}
+}
+
+GLint Shader::GetUniformLocation(const char* name)
+{
+	auto it = this->Uniforms.find(HashUniformName(name));
+	return it == this->Uniforms.end() ? -1 : it->second.Location;
+}
+
+void Shader::CreateShader(GLuint* id, const char* shader, GLenum type)
+{
+	*id = glCreateShader(type);
+	glShaderSource(*id, 1, &shader, NULL);
+	glCompileShader(*id);
+}
+
+void Shader::CreateShaderProgram(GLuint * id, GLuint vertexShaderId, GLuint fragmentShaderId)
+{
+	*id = glCreateProgram();
+	glAttachShader(*id, vertexShaderId);
+	glAttachShader(*id, fragmentShaderId);
+	// ask the driver to keep the linked binary around so we can cache it
+	if (GLEW_ARB_get_program_binary) {
+		glProgramParameteri(*id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(*id);
+}
+
+bool Shader::CheckForShaderErrors(GLuint shaderId)
+{
+	GLint success;
+	GLchar infoLog[512];
+	glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+
+	if (!success) {
+		glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+
+	return success == GL_TRUE;
+}
+
+bool Shader::CheckForProgramErrors(GLuint programId)
+{
+	GLint success;
+	GLchar infoLog[512];
+	glGetProgramiv(programId, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR::PROGRAM::LINK_FAILED\n" << infoLog << std::endl;
+	}
+
+	return success == GL_TRUE;
+}
+
+void Shader::OnProgramLinked()
+{
+	// resolve every active uniform once so we never query the driver by name per frame
+	CacheUniformLocations();
+	BindUniformBlocks();
+	Reflect();
+}
+
+void Shader::CacheUniformLocations()
+{
+	this->Uniforms.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramiv(this->ProgramId, GL_ACTIVE_UNIFORMS, &uniformCount);
+
+	for (GLint i = 0; i < uniformCount; i++) {
+		GLchar name[256];
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(this->ProgramId, i, sizeof(name), &length, &size, &type, name);
+
+		// arrays are reported as "name[0]"; key them by their bare name
+		std::string uniformName(name, length);
+		size_t bracket = uniformName.find('[');
+		if (bracket != std::string::npos) {
+			uniformName.erase(bracket);
+		}
+
+		Uniform uniform;
+		uniform.Location = glGetUniformLocation(this->ProgramId, name);
+		uniform.Type = type;
+		uniform.HasValue = GL_FALSE;
+
+		// uniforms inside blocks have no location; they're not settable this way
+		if (uniform.Location == -1) {
+			continue;
+		}
+
+		GLuint nameHash = HashUniformName(uniformName.c_str());
+		if (!this->Uniforms.insert(std::make_pair(nameHash, uniform)).second) {
+			std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << uniformName << std::endl;
+		}
+	}
+}
+
+const Shader::Reflection& Shader::GetReflection()
+{
+	return this->Reflected;
+}
+
+bool Shader::ValidateVertexArray(GLuint vaoId, const char* vaoName)
+{
+	bool valid = true;
+	glState.BindVertexArray(vaoId);
+
+	for (const ActiveVariable& attribute : this->Reflected.Attributes) {
+		// built-ins such as gl_VertexID have no location and need no array
+		if (attribute.Location == -1) {
+			continue;
+		}
+
+		// matrices take one location per column
+		GLint components, locations;
+		GetAttributeShape(attribute.Type, &components, &locations);
+
+		for (GLint column = 0; column < locations * attribute.Size; column++) {
+			GLuint location = attribute.Location + column;
+			GLint enabled = GL_FALSE, size = 0;
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+
+			if (!enabled) {
+				std::cout << "ERROR::SHADER::VERTEX_LAYOUT_MISMATCH\n" << this->Name << " reads " << GetTypeName(attribute.Type)
+					<< " " << attribute.Name << " at location " << location << " but " << vaoName << " has no array enabled there" << std::endl;
+				valid = false;
+			}
+			// extra components are fine; packed formats pad vec3s out to four
+			else if (size < components) {
+				std::cout << "ERROR::SHADER::VERTEX_LAYOUT_MISMATCH\n" << this->Name << " reads " << GetTypeName(attribute.Type)
+					<< " " << attribute.Name << " at location " << location << " but " << vaoName << " supplies " << size << " components" << std::endl;
+				valid = false;
+			}
+		}
+	}
+
+	return valid;
+}
+
+void Shader::Reflect()
+{
+	this->Reflected = Reflection();
+
+	GLint count = 0;
+	GLchar name[256];
+	GLsizei length;
+
+	glGetProgramiv(this->ProgramId, GL_ACTIVE_ATTRIBUTES, &count);
+	for (GLint i = 0; i < count; i++) {
+		ActiveVariable attribute;
+		glGetActiveAttrib(this->ProgramId, i, sizeof(name), &length, &attribute.Size, &attribute.Type, name);
+		attribute.Name.assign(name, length);
+		attribute.Location = glGetAttribLocation(this->ProgramId, name);
+		attribute.Binding = -1;
+		this->Reflected.Attributes.push_back(attribute);
+	}
+
+	glGetProgramiv(this->ProgramId, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; i++) {
+		ActiveVariable uniform;
+		glGetActiveUniform(this->ProgramId, i, sizeof(name), &length, &uniform.Size, &uniform.Type, name);
+		uniform.Name.assign(name, length);
+		uniform.Location = glGetUniformLocation(this->ProgramId, name);
+
+		// for samplers, the binding is the texture unit the sampler currently reads from
+		uniform.Binding = -1;
+		if (IsSamplerType(uniform.Type) && uniform.Location != -1) {
+			glGetUniformiv(this->ProgramId, uniform.Location, &uniform.Binding);
+			this->Reflected.Samplers.push_back(uniform);
+		}
+		this->Reflected.Uniforms.push_back(uniform);
+	}
+
+	glGetProgramiv(this->ProgramId, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (GLint i = 0; i < count; i++) {
+		ActiveVariable block;
+		glGetActiveUniformBlockName(this->ProgramId, i, sizeof(name), &length, name);
+		block.Name.assign(name, length);
+		block.Type = GL_UNIFORM_BLOCK;
+		block.Location = i;
+		glGetActiveUniformBlockiv(this->ProgramId, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.Size);
+		glGetActiveUniformBlockiv(this->ProgramId, i, GL_UNIFORM_BLOCK_BINDING, &block.Binding);
+		this->Reflected.UniformBlocks.push_back(block);
+	}
+}
+
+bool Shader::IsSamplerType(GLenum type)
+{
+	switch (type)
+	{
+	// every sampler type GL 4.6 reports: float, depth comparison, signed and unsigned integer
+	case GL_SAMPLER_1D:
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_3D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_1D_ARRAY:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_CUBE_MAP_ARRAY:
+	case GL_SAMPLER_2D_MULTISAMPLE:
+	case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case GL_SAMPLER_BUFFER:
+	case GL_SAMPLER_2D_RECT:
+	case GL_SAMPLER_1D_SHADOW:
+	case GL_SAMPLER_2D_SHADOW:
+	case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_1D_ARRAY_SHADOW:
+	case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+	case GL_SAMPLER_2D_RECT_SHADOW:
+	case GL_INT_SAMPLER_1D:
+	case GL_INT_SAMPLER_2D:
+	case GL_INT_SAMPLER_3D:
+	case GL_INT_SAMPLER_CUBE:
+	case GL_INT_SAMPLER_1D_ARRAY:
+	case GL_INT_SAMPLER_2D_ARRAY:
+	case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+	case GL_INT_SAMPLER_2D_MULTISAMPLE:
+	case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case GL_INT_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_2D_RECT:
+	case GL_UNSIGNED_INT_SAMPLER_1D:
+	case GL_UNSIGNED_INT_SAMPLER_2D:
+	case GL_UNSIGNED_INT_SAMPLER_3D:
+	case GL_UNSIGNED_INT_SAMPLER_CUBE:
+	case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+	case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Shader::GetAttributeShape(GLenum type, GLint* components, GLint* locations)
+{
+	*locations = 1;
+	switch (type)
+	{
+	case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT:
+		*components = 1; break;
+	case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2:
+		*components = 2; break;
+	case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3:
+		*components = 3; break;
+	case GL_FLOAT_MAT2:
+		*components = 2; *locations = 2; break;
+	case GL_FLOAT_MAT3:
+		*components = 3; *locations = 3; break;
+	case GL_FLOAT_MAT4:
+		*components = 4; *locations = 4; break;
+	default:
+		*components = 4; break;
+	}
+}
+
+const char* Shader::GetTypeName(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT: return "float";
+	case GL_FLOAT_VEC2: return "vec2";
+	case GL_FLOAT_VEC3: return "vec3";
+	case GL_FLOAT_VEC4: return "vec4";
+	case GL_INT: return "int";
+	case GL_UNSIGNED_INT: return "uint";
+	case GL_FLOAT_MAT3: return "mat3";
+	case GL_FLOAT_MAT4: return "mat4";
+	case GL_SAMPLER_2D: return "sampler2D";
+	case GL_SAMPLER_2D_ARRAY: return "sampler2DArray";
+	default: return "<type>";
+	}
+}
+
+std::map<std::string, GLuint> Shader::UniformBlockBindings;
+
+void Shader::SetUniformBlockBinding(const char* blockName, GLuint bindingPoint)
+{
+	UniformBlockBindings[blockName] = bindingPoint;
+}
+
+void Shader::BindUniformBlocks()
+{
+	// GLSL 400 can't declare a block's binding itself, so we assign it after every link
+	GLint blockCount = 0;
+	glGetProgramiv(this->ProgramId, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+
+	for (GLint i = 0; i < blockCount; i++) {
+		GLchar name[256];
+		glGetActiveUniformBlockName(this->ProgramId, i, sizeof(name), NULL, name);
+
+		auto binding = UniformBlockBindings.find(name);
+		if (binding != UniformBlockBindings.end()) {
+			glUniformBlockBinding(this->ProgramId, i, binding->second);
+		}
+		else {
+			std::cout << "ERROR::SHADER::UNIFORM_BLOCK_NOT_BOUND\n" << name << " in " << this->Name << std::endl;
+		}
+	}
+}
+
+Shader::Uniform* Shader::FindDirtyUniform(GLuint nameHash, const void* value, size_t size)
+{
+	auto it = this->Uniforms.find(nameHash);
+	if (it == this->Uniforms.end()) {
+		return nullptr;
+	}
+
+	// uniform values are per-program state, so our shadow copy stays valid across Use() calls
+	Uniform& uniform = it->second;
+	if (uniform.HasValue && std::memcmp(uniform.Value, value, size) == 0) {
+		return nullptr;
+	}
+
+	std::memcpy(uniform.Value, value, size);
+	uniform.HasValue = GL_TRUE;
+	return &uniform;
+}
+
+GLuint64 Shader::HashProgramSources(const std::string& vertexShaderCode, const std::string& fragmentShaderCode)
+{
+	// the driver identity is part of the key, so a driver update simply misses the old entries
+	std::string key = vertexShaderCode;
+	key += '\0';
+	key += fragmentShaderCode;
+	key += '\0';
+	key += (const char*)glGetString(GL_VENDOR);
+	key += (const char*)glGetString(GL_RENDERER);
+	key += (const char*)glGetString(GL_VERSION);
+
+	// 64-bit FNV-1a
+	GLuint64 hash = 14695981039346656037ull;
+	for (size_t i = 0; i < key.size(); i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string Shader::GetProgramBinaryPath(GLuint64 cacheKey)
+{
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)cacheKey);
+	return std::string(SHADER_CACHE_DIR) + fileName;
+}
+
+bool Shader::LoadProgramBinary(GLuint64 cacheKey)
+{
+	// program binaries are core in 4.1; on our 4.0 context they need the ARB extension
+	if (!GLEW_ARB_get_program_binary) {
+		return false;
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount == 0) {
+		return false;
+	}
+
+	std::ifstream file(GetProgramBinaryPath(cacheKey).c_str(), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	ProgramBinaryHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (!file || header.Magic != PROGRAM_BINARY_MAGIC || header.Key != cacheKey || header.Length <= 0) {
+		return false;
+	}
+
+	std::vector<char> binary(header.Length);
+	file.read(binary.data(), header.Length);
+	if (!file) {
+		return false;
+	}
+
+	this->ProgramId = glCreateProgram();
+	glProgramBinary(this->ProgramId, header.Format, binary.data(), header.Length);
+
+	// the driver is free to reject a binary it no longer understands; fall back to source
+	GLint success;
+	glGetProgramiv(this->ProgramId, GL_LINK_STATUS, &success);
+	if (!success) {
+		std::cout << "INFO: Discarding stale shader program binary " << GetProgramBinaryPath(cacheKey) << std::endl;
+		glState.DeleteProgram(this->ProgramId);
+		this->ProgramId = 0;
+		std::remove(GetProgramBinaryPath(cacheKey).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void Shader::SaveProgramBinary(GLuint64 cacheKey)
+{
+	if (!GLEW_ARB_get_program_binary) {
+		return;
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+	GLint success;
+	glGetProgramiv(this->ProgramId, GL_LINK_STATUS, &success);
+	if (formatCount == 0 || !success) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(this->ProgramId, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	ProgramBinaryHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.Magic = PROGRAM_BINARY_MAGIC;
+	header.Key = cacheKey;
+	std::vector<char> binary(length);
+	glGetProgramBinary(this->ProgramId, length, &header.Length, &header.Format, binary.data());
+
+#ifdef _WIN32
+	_mkdir(SHADER_CACHE_DIR);
+#else
+	mkdir(SHADER_CACHE_DIR, 0755);
+#endif
+
+	std::ofstream file(GetProgramBinaryPath(cacheKey).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "ERROR::SHADER::PROGRAM_BINARY_NOT_WRITTEN\n" << GetProgramBinaryPath(cacheKey) << std::endl;
+		return;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), header.Length);
+}
+
+ShaderPermutations::ShaderPermutations(const GLchar* vertexShaderPath, const GLchar* fragmentShaderPath, GLboolean async)
+	: VertexShaderPath(vertexShaderPath),
+	FragmentShaderPath(fragmentShaderPath),
+	Async(async),
+	Watching(GL_FALSE)
+{
+}
+
+Shader& ShaderPermutations::Get(const std::vector<std::string>& defines)
+{
+	// normalise the define set so the same permutation always maps to the same key
+	std::vector<std::string> sortedDefines(defines);
+	std::sort(sortedDefines.begin(), sortedDefines.end());
+	sortedDefines.erase(std::unique(sortedDefines.begin(), sortedDefines.end()), sortedDefines.end());
+
+	std::string key;
+	for (const std::string& define : sortedDefines) {
+		key += define + ";";
+	}
+
+	auto it = this->Variants.find(key);
+	if (it != this->Variants.end()) {
+		return *it->second;
+	}
+
+	// first request for this permutation; only now do we pay for compiling it
+	Shader* variant = new Shader(this->VertexShaderPath.c_str(), this->FragmentShaderPath.c_str(), this->Async, sortedDefines);
+	this->Variants[key].reset(variant);
+	if (this->Watching) {
+		variant->Watch();
+	}
+	return *variant;
+}
+
+void ShaderPermutations::Watch()
+{
+	this->Watching = GL_TRUE;
+	for (auto& variant : this->Variants) {
+		variant.second->Watch();
+	}
+}
+
+bool ShaderPermutations::Update()
+{
+	bool changed = false;
+	for (auto& variant : this->Variants) {
+		changed |= variant.second->Update();
+	}
+	return changed;
+}
+
+size_t ShaderPermutations::GetVariantCount()
+{
+	return this->Variants.size();
+}
@@ -2,16 +2,29 @@
 
 in vec3 ourColor; // set this variable in the OpenGL code
 in vec2 ourTexCoord;
+flat in vec2 ourLayers;
+#ifdef USE_INSTANCING
+in float fade;
+#endif
 
 out vec4 color;
 
-uniform sampler2D ourTexture0;
-uniform sampler2D ourTexture1;
-uniform float mixValue;
+#include "texturemix.glsl"
+#ifdef USE_INSTANCING
+#include "fade.glsl"
+#endif
 
 void main()
 {
-	color = mix(texture(ourTexture0, ourTexCoord), texture(ourTexture1, vec2(ourTexCoord.x, ourTexCoord.y)), mixValue);
-	// color = texture(ourTexture, ourTexCoord) * vec4(ourColor, 1.0f);
-	// color = vec4(ourColor, 1.0f);
+#ifdef USE_INSTANCING
+	// the impostor takes these pixels
+	if (fade > FadeThreshold()) {
+		discard;
+	}
+#endif
+	color = MixTextures(ourTexCoord, ourLayers);
+#if defined(USE_VERTEX_COLOR) || defined(USE_INSTANCING)
+	// only variants with vertex colors or instance tints have anything to multiply by
+	color *= vec4(ourColor, 1.0f);
+#endif
 }
@@ -4,118 +4,203 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
 
 #include <GL\glew.h>
+#include <glm/glm.hpp>
+
+// FNV-1a hash of a uniform name. constexpr, but only worked out at compile time where a constant is needed, see UNIFORM
+constexpr GLuint HashUniformName(const char* name, GLuint hash = 2166136261u)
+{
+	return *name == '\0' ? hash : HashUniformName(name + 1, (hash ^ (GLuint)(unsigned char)*name) * 16777619u);
+}
+
+// the hash of a literal uniform name as a compile-time constant, for the GLuint Set overloads
+#define UNIFORM(name) (std::integral_constant<GLuint, HashUniformName(name)>::value)
+
+// where linked program binaries are cached between runs
+const char* const SHADER_CACHE_DIR = "./shadercache/";
+
+class FileWatcher;
 
 class Shader
 {
 public:
-	// constructor reads and builds the shader
-	Shader(const GLchar* vertexShaderPath, const GLchar* fragmentShaderPath)
+	// one active attribute, uniform, sampler or uniform block as reported after link.
+	// Location is the block index for blocks; Binding is the texture unit for samplers
+	// and the binding point for blocks, -1 otherwise
+	struct ActiveVariable
 	{
-		// I would say the constructor shouldn't have IO logic in it, it should just rely on chars
-
-		// 1. retrieve the vertex/ fragment source code from file path
-		std::string vertexShaderCode;
-		std::string fragmentShaderCode;
-		std::ifstream vertexShaderFile;
-		std::ifstream fragmentShaderFile;
-
-		// ensures ifstream objects can throw exceptions
-		vertexShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fragmentShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-		try
-		{
-			// open files
-			vertexShaderFile.open(vertexShaderPath);
-			fragmentShaderFile.open(fragmentShaderPath);
-			std::stringstream vertexShaderStream, fragmentShaderStream;
-
-			// read file's buffer contents into streams
-			vertexShaderStream << vertexShaderFile.rdbuf();
-			fragmentShaderStream << fragmentShaderFile.rdbuf();
-
-			// close file handlers
-			vertexShaderFile.close();
-			fragmentShaderFile.close();
-
-			// convert stream into GLchar array
-			vertexShaderCode = vertexShaderStream.str();
-			fragmentShaderCode = fragmentShaderStream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n" << std::endl;
-		}
-
-		const GLchar* vertexShaderCodeString = vertexShaderCode.c_str();
-		const GLchar* fragmentShaderCodeString = fragmentShaderCode.c_str();
-
-		// 2. compile the shaders
-		GLuint vertexShaderId, fragmentShaderId;
-
-		CreateShader(&vertexShaderId, vertexShaderCodeString, GL_VERTEX_SHADER);
-		CheckForShaderErrors(vertexShaderId);
-
-		CreateShader(&fragmentShaderId, fragmentShaderCodeString, GL_FRAGMENT_SHADER);
-		CheckForShaderErrors(fragmentShaderId);
-
-		// 3. shader program
-		CreateShaderProgram(&this->ProgramId, vertexShaderId, fragmentShaderId);
-		CheckForProgramErrors(this->ProgramId);
-
-		// delete the shaders as they're linked into our program now and no longer necessary
-		glDeleteProgram(vertexShaderId);
-		glDeleteProgram(fragmentShaderId);
-	}
+		std::string Name;
+		GLenum Type;
+		GLint Size;
+		GLint Location;
+		GLint Binding;
+	};
+
+	struct Reflection
+	{
+		std::vector<ActiveVariable> Attributes;
+		std::vector<ActiveVariable> Uniforms;
+		std::vector<ActiveVariable> Samplers;
+		std::vector<ActiveVariable> UniformBlocks;
+	};
+
+	// constructor reads and builds the shader; an async shader only submits the
+	// compile and link, and must be polled with IsReady() before it's used.
+	// defines ("NAME" or "NAME=VALUE") are injected into both stages after #version
+	Shader(const GLchar* vertexShaderPath, const GLchar* fragmentShaderPath, GLboolean async = GL_FALSE,
+		const std::vector<std::string>& defines = std::vector<std::string>());
+
+	~Shader();
+
+	// non-blocking when the driver supports KHR_parallel_shader_compile
+	bool IsReady();
+
+	// start watching the source files for edits from a background thread
+	void Watch();
+
+	// call once per frame on the GL thread; swaps in a reloaded program if one
+	// is waiting and it linked, returning true when the program changed
+	bool Update();
 
 	// use the program
-	void Use()
-	{
-		glUseProgram(this->ProgramId);
-	}
+	void Use();
 
-	GLuint GetProgramId()
-	{
-		return this->ProgramId;
-	}
+	GLuint GetProgramId();
 
-private:
-	GLuint ProgramId;
-	void CreateShader(GLuint* id, const char* shader, GLenum type)
-	{
-		*id = glCreateShader(type);
-		glShaderSource(*id, 1, &shader, NULL);
-		glCompileShader(*id);
-	}
+	// typed uniform setters; the GL call is skipped when the value hasn't changed. these hash name on every call, so
+	// per-frame code passes UNIFORM("name") instead
+	void Set(const char* name, const glm::mat4& value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, const glm::vec3& value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, const glm::vec2& value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, GLfloat value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, GLint value) { this->Set(HashUniformName(name), value); }
 
-	void CreateShaderProgram(GLuint* id, GLuint vertexShaderId, GLuint fragmentShaderId)
-	{
-		*id = glCreateProgram();
-		glAttachShader(*id, vertexShaderId);
-		glAttachShader(*id, fragmentShaderId);
-		glLinkProgram(*id);
-	}
-	void CheckForShaderErrors(GLuint shaderId)
+	void Set(GLuint nameHash, const glm::mat4& value);
+	void Set(GLuint nameHash, const glm::vec3& value);
+	void Set(GLuint nameHash, const glm::vec2& value);
+	void Set(GLuint nameHash, GLfloat value);
+	void Set(GLuint nameHash, GLint value);
+
+	// returns -1 if the uniform isn't active in the program
+	GLint GetUniformLocation(const char* name);
+
+	// everything the linked program exposes; empty until the build has finished
+	const Reflection& GetReflection();
+
+	// checks that the VAO enables an array of the right width for every attribute the
+	// program reads, printing a diagnostic per mismatch; binds the VAO
+	bool ValidateVertexArray(GLuint vaoId, const char* vaoName);
+
+	// every program linked after this call gets the named uniform block bound to bindingPoint
+	static void SetUniformBlockBinding(const char* blockName, GLuint bindingPoint);
+
+private:
+	// an active uniform resolved at link time plus the last value we uploaded to it
+	struct Uniform
 	{
-		GLint success;
-		GLchar infoLog[512];
-		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
-
-		if (!success) {
-			glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
-			std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
-	}
-	void CheckForProgramErrors(GLuint programId)
+		GLint Location;
+		GLenum Type;
+		GLboolean HasValue;
+		GLfloat Value[16];
+	};
+
+	// on-disk layout of a cached program binary; the blob itself follows the header
+	struct ProgramBinaryHeader
 	{
-		GLint success;
-		GLchar infoLog[512];
-		glGetProgramiv(programId, GL_LINK_STATUS, &success);
-		if (!success) {
-			glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-			std::cout << "ERROR::PROGRAM::LINK_FAILED\n" << infoLog << std::endl;
-		}
-	}
-};
\ No newline at end of file
+		GLuint Magic;
+		GLenum Format;
+		GLuint64 Key;
+		GLsizei Length;
+		GLuint Reserved;
+	};
+	static_assert(sizeof(ProgramBinaryHeader) == 24, "ProgramBinaryHeader must have no padding");
+	static const GLuint PROGRAM_BINARY_MAGIC = 0x42504C47; // "GLPB"
+
+	static std::map<std::string, GLuint> UniformBlockBindings;
+
+	GLuint ProgramId;
+	std::unordered_map<GLuint, Uniform> Uniforms;
+	Reflection Reflected;
+
+	// in-flight build state
+	std::string VertexShaderPath;
+	std::string FragmentShaderPath;
+	std::vector<std::string> Defines;
+	// every file the sources pulled in through #include, for the watcher
+	std::vector<std::string> IncludedFiles;
+	std::string Name;
+	GLuint VertexShaderId;
+	GLuint FragmentShaderId;
+	GLuint64 CacheKey;
+	GLboolean Ready;
+	GLboolean CacheHit;
+	std::chrono::steady_clock::time_point BuildStart;
+
+	// hot-reload state, filled in by the watcher thread
+	std::mutex ReloadMutex;
+	std::atomic<bool> ReloadPending;
+	std::string ReloadVertexShaderCode;
+	std::string ReloadFragmentShaderCode;
+	std::vector<std::string> ReloadIncludedFiles;
+	// declared last so its thread is joined before anything it touches is destroyed
+	std::unique_ptr<FileWatcher> Watcher;
+
+	// cooked reads files from the asset bundle where it has them; edits are only ever on disk, so reloads don't
+	bool ReadSources(std::string& vertexShaderCode, std::string& fragmentShaderCode, std::vector<std::string>* includedFiles = nullptr,
+		bool cooked = false);
+	bool PreprocessFile(const std::string& path, std::string& output, std::vector<std::string>& includedFiles, bool cooked);
+	void BeginBuild(const std::string& vertexShaderCode, const std::string& fragmentShaderCode);
+	void FinishBuild();
+
+	void CreateShader(GLuint* id, const char* shader, GLenum type);
+	void CreateShaderProgram(GLuint* id, GLuint vertexShaderId, GLuint fragmentShaderId);
+	bool CheckForShaderErrors(GLuint shaderId);
+	bool CheckForProgramErrors(GLuint programId);
+	void OnProgramLinked();
+	void CacheUniformLocations();
+	void BindUniformBlocks();
+	void Reflect();
+	static bool IsSamplerType(GLenum type);
+	static void GetAttributeShape(GLenum type, GLint* components, GLint* locations);
+	static const char* GetTypeName(GLenum type);
+	GLuint64 HashProgramSources(const std::string& vertexShaderCode, const std::string& fragmentShaderCode);
+	std::string GetProgramBinaryPath(GLuint64 cacheKey);
+	bool LoadProgramBinary(GLuint64 cacheKey);
+	void SaveProgramBinary(GLuint64 cacheKey);
+	Uniform* FindDirtyUniform(GLuint nameHash, const void* value, size_t size);
+};
+
+// lazily built, deduplicated permutations of one vertex+fragment pair, keyed by define set
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(const GLchar* vertexShaderPath, const GLchar* fragmentShaderPath, GLboolean async = GL_FALSE);
+
+	// returns the variant for this define set, submitting its build the first time it's asked for;
+	// the order and repetition of defines doesn't matter
+	Shader& Get(const std::vector<std::string>& defines = std::vector<std::string>());
+
+	// watch the sources of every variant, including ones built later
+	void Watch();
+
+	// forward the per-frame hot-reload check to every built variant; true if any was swapped
+	bool Update();
+
+	size_t GetVariantCount();
+
+private:
+	std::string VertexShaderPath;
+	std::string FragmentShaderPath;
+	GLboolean Async;
+	GLboolean Watching;
+	std::map<std::string, std::unique_ptr<Shader>> Variants;
+};
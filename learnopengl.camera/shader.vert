@@ -1,19 +1,48 @@
 #version 400 core
 
 layout (location = 0) in vec3 position; // the position variable has attribute position 0
+#ifdef USE_VERTEX_COLOR
 layout (location = 1) in vec3 color;
+#endif
 layout (location = 2) in vec2 texCoord;
 
+#ifndef USE_INSTANCING
+uniform mat4 model;
+// which texture array layers to mix; instances bring their own
+uniform vec2 textureLayers;
+#endif
+
 out vec3 ourColor;
 out vec2 ourTexCoord;
+flat out vec2 ourLayers;
+#ifdef USE_INSTANCING
+out float fade;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "perframe.glsl"
+
+#ifdef USE_INSTANCING
+#include "instance.glsl"
+#endif
 
 void main()
 {
+#ifdef USE_INSTANCING
+	mat4 model = InstanceModel();
+	fade = ImpostorFade(model[3].xyz);
+#endif
 	gl_Position = projection * view * model * vec4(position, 1.0f);
+#ifdef USE_VERTEX_COLOR
 	ourColor = color;
-	ourTexCoord = vec2(texCoord.x, 1.0f - texCoord.y);
+#else
+	ourColor = vec3(1.0f);
+#endif
+#ifdef USE_INSTANCING
+	ourColor *= instanceTint.rgb;
+	ourLayers = instanceLayers.xy;
+#else
+	ourLayers = textureLayers;
+#endif
+	// the loader stores images bottom row first, as texture coordinates expect
+	ourTexCoord = texCoord;
 }
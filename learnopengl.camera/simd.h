@@ -0,0 +1,16 @@
+#pragma once
+
+// SSE2 is always there on x64, and on x86 whenever the compiler was told to assume it. AVX2 kernels go in functions
+// marked SIMD_AVX2_FUNCTION, built for AVX2 whatever the rest of the build targets, and are only called once
+// GetBestPixelPath has said the CPU can run them
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_AVX2_FUNCTION
+#else
+#define SIMD_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
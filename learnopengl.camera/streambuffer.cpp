@@ -0,0 +1,180 @@
+#include "streambuffer.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "glstate.h"
+
+// nanoseconds per glClientWaitSync before we check again
+const GLuint64 STREAM_BUFFER_WAIT_NS = 1000000;
+
+StreamBuffer::StreamBuffer(GLsizeiptr frameSize, GLuint frameCount)
+	: BufferId(0), FrameCount(frameCount), Frame(0), Head(0), Flushed(0), Persistent(false), Mapped(nullptr)
+{
+	// keep every region's base aligned for glBindBufferRange
+	GLsizeiptr alignment = GetUniformAlignment() > 256 ? GetUniformAlignment() : 256;
+	this->FrameSize = (frameSize + alignment - 1) / alignment * alignment;
+	this->Fences.assign(frameCount, (GLsync)0);
+	this->ResetStats();
+
+	// GL_COPY_WRITE_BUFFER isn't used for drawing, so binding to it never disturbs anything else
+	glGenBuffers(1, &this->BufferId);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+
+	if (GLEW_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, this->FrameSize * frameCount, NULL, flags);
+		this->Mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, this->FrameSize * frameCount, flags);
+		if (this->Mapped != nullptr) {
+			this->Persistent = true;
+		}
+		else {
+			// immutable storage can't be respecified, so start over with a fresh buffer
+			std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED\nfalling back to orphaning" << std::endl;
+			glState.DeleteBuffers(1, &this->BufferId);
+			glGenBuffers(1, &this->BufferId);
+			glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+		}
+	}
+
+	if (!this->Persistent) {
+		// one region is enough; orphaning gives us fresh storage every frame
+		glBufferData(GL_COPY_WRITE_BUFFER, this->FrameSize, NULL, GL_STREAM_DRAW);
+		this->Staging.resize(this->FrameSize);
+		this->Mapped = this->Staging.data();
+	}
+
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (GLsync fence : this->Fences) {
+		if (fence != 0) {
+			glDeleteSync(fence);
+		}
+	}
+
+	if (this->Persistent) {
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glState.DeleteBuffers(1, &this->BufferId);
+}
+
+void StreamBuffer::BeginFrame()
+{
+	this->Head = 0;
+	this->Flushed = 0;
+
+	if (!this->Persistent) {
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+		glBufferData(GL_COPY_WRITE_BUFFER, this->FrameSize, NULL, GL_STREAM_DRAW);
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return;
+	}
+
+	this->Frame = (this->Frame + 1) % this->FrameCount;
+	GLsync fence = this->Fences[this->Frame];
+	if (fence == 0) {
+		return;
+	}
+
+	// a zero-timeout poll first, so the common case costs no flush and no timing
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		this->Counters.Stalls++;
+		auto start = std::chrono::high_resolution_clock::now();
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_WAIT_NS);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		this->Counters.StallTime += std::chrono::duration<GLdouble>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	if (status == GL_WAIT_FAILED) {
+		std::cout << "ERROR::STREAM_BUFFER::WAIT_FAILED" << std::endl;
+	}
+
+	glDeleteSync(fence);
+	this->Fences[this->Frame] = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	Allocation allocation = { nullptr, 0 };
+
+	GLsizeiptr start = (this->Head + alignment - 1) / alignment * alignment;
+	if (start + size > this->FrameSize) {
+		this->Counters.Overflows++;
+		return allocation;
+	}
+
+	this->Head = start + size;
+	this->Counters.Used = this->Head;
+	allocation.Offset = this->GetFrameBase() + start;
+	allocation.Pointer = this->Mapped + allocation.Offset;
+	return allocation;
+}
+
+void StreamBuffer::Flush()
+{
+	// coherent mappings are visible to GL as soon as they're written
+	if (this->Persistent || this->Flushed == this->Head) {
+		return;
+	}
+
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, this->BufferId);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, this->Flushed, this->Head - this->Flushed, this->Mapped + this->Flushed);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	this->Flushed = this->Head;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (!this->Persistent) {
+		this->Flush();
+		return;
+	}
+
+	this->Fences[this->Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint StreamBuffer::GetBufferId()
+{
+	return this->BufferId;
+}
+
+bool StreamBuffer::IsPersistent()
+{
+	return this->Persistent;
+}
+
+StreamBuffer::Stats StreamBuffer::GetStats()
+{
+	return this->Counters;
+}
+
+void StreamBuffer::ResetStats()
+{
+	this->Counters.Stalls = 0;
+	this->Counters.StallTime = 0.0;
+	this->Counters.Overflows = 0;
+	this->Counters.Used = 0;
+}
+
+GLsizeiptr StreamBuffer::GetUniformAlignment()
+{
+	static GLint alignment = 0;
+	if (alignment == 0) {
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment <= 0) {
+			alignment = 256;
+		}
+	}
+	return alignment;
+}
+
+GLintptr StreamBuffer::GetFrameBase()
+{
+	return this->Persistent ? this->Frame * this->FrameSize : 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// how many frames the CPU may run ahead of the GPU before BeginFrame has to wait
+const GLuint STREAM_BUFFER_FRAMES = 3;
+
+// a ring of per-frame regions in one buffer, for data rewritten every frame: uniforms, instances, transient vertices.
+// with ARB_buffer_storage the buffer stays persistently mapped and each region is fenced, so writing never
+// synchronizes with GL and the CPU only waits once it is STREAM_BUFFER_FRAMES ahead. without it we orphan the
+// buffer every frame and upload in Flush()
+class StreamBuffer
+{
+public:
+	struct Allocation
+	{
+		// where to write; nullptr if the frame's region is full
+		void* Pointer;
+		// where the data will live in the buffer, for glBindBufferRange or attribute offsets
+		GLintptr Offset;
+	};
+
+	struct Stats
+	{
+		// BeginFrame calls that found the GPU still reading the region, and how long they waited in seconds
+		GLuint Stalls;
+		GLdouble StallTime;
+		// allocations refused because the frame's region was full
+		GLuint Overflows;
+		// bytes handed out in the current frame
+		GLsizeiptr Used;
+	};
+
+	StreamBuffer(GLsizeiptr frameSize, GLuint frameCount = STREAM_BUFFER_FRAMES);
+	~StreamBuffer();
+
+	// moves to the next region, waiting for the GPU to finish with it if it must
+	void BeginFrame();
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+	// makes everything allocated so far visible to GL; call before drawing with it
+	void Flush();
+	// fences the region so BeginFrame knows when it can be reused
+	void EndFrame();
+
+	GLuint GetBufferId();
+	bool IsPersistent();
+	// counters accumulate until ResetStats
+	Stats GetStats();
+	void ResetStats();
+
+	static GLsizeiptr GetUniformAlignment();
+
+private:
+	GLuint BufferId;
+	GLsizeiptr FrameSize;
+	GLuint FrameCount;
+	GLuint Frame;
+	GLsizeiptr Head;
+	GLsizeiptr Flushed;
+	bool Persistent;
+
+	// the persistent mapping, or CPU staging for one frame when orphaning
+	unsigned char* Mapped;
+	std::vector<unsigned char> Staging;
+	std::vector<GLsync> Fences;
+
+	Stats Counters;
+
+	GLintptr GetFrameBase();
+};
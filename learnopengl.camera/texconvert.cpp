@@ -0,0 +1,108 @@
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <SOIL.h>
+
+#include "pixelconvert.h"
+#include "texturefile.h"
+
+static bool NamesMatch(const char* a, const char* b)
+{
+	while (*a != '\0' && std::tolower((unsigned char)*a) == std::tolower((unsigned char)*b)) {
+		a++;
+		b++;
+	}
+	return *a == '\0' && *b == '\0';
+}
+
+// compresses an image into the block-compressed texture format the samples load
+int main(int argc, char** argv)
+{
+	int format = -1;
+	bool mipmaps = true;
+	int filter = MIP_FILTER_KAISER;
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (std::strcmp(argv[arg], "-n") == 0) {
+			mipmaps = false;
+		}
+		else if (std::strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+			arg++;
+			for (int f = 0; f < BLOCK_FORMAT_COUNT; f++) {
+				if (NamesMatch(argv[arg], BLOCK_FORMAT_NAMES[f])) {
+					format = f;
+				}
+			}
+			if (format == -1) {
+				break;
+			}
+		}
+		else if (std::strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+			arg++;
+			filter = -1;
+			for (int f = 0; f < MIP_FILTER_COUNT; f++) {
+				if (NamesMatch(argv[arg], MIP_FILTER_NAMES[f])) {
+					filter = f;
+				}
+			}
+			if (filter == -1) {
+				break;
+			}
+		}
+		else {
+			break;
+		}
+		arg++;
+	}
+
+	if (argc - arg != 2 || filter == -1) {
+		std::cout << "usage: texconvert [-f bc1|bc3|bc4|bc5] [-m box|kaiser] [-n] input.png output.ctex\n"
+			"  -f  block format; BC3 if the image has any transparency, BC1 if not\n"
+			"  -m  mip filter, Kaiser by default\n"
+			"  -n  top level only, no mipmaps" << std::endl;
+		return 1;
+	}
+
+	int width, height, channels;
+	unsigned char* pixels = SOIL_load_image(argv[arg], &width, &height, &channels, SOIL_LOAD_AUTO);
+	if (pixels != nullptr && channels < 3) {
+		SOIL_free_image_data(pixels);
+		pixels = SOIL_load_image(argv[arg], &width, &height, &channels, SOIL_LOAD_RGBA);
+		channels = 4;
+	}
+	if (pixels == nullptr) {
+		std::cout << "ERROR::TEXCONVERT::LOAD_FAILED\n" << argv[arg] << std::endl;
+		return 1;
+	}
+	// laid out as the loader uploads its images: RGBA, bottom row first, premultiplied
+	std::vector<unsigned char> image((size_t)width * height * 4);
+	ConvertToUploadLayout(pixels, width, height, channels, image.data());
+	SOIL_free_image_data(pixels);
+
+	if (format == -1) {
+		format = BLOCK_BC1;
+		for (size_t i = 3; i < (size_t)width * height * 4; i += 4) {
+			if (image[i] != 255) {
+				format = BLOCK_BC3;
+				break;
+			}
+		}
+	}
+
+	// color formats hold sRGB, so they're filtered in linear light; BC4 and BC5 hold data and are filtered as it is
+	MipChain mips;
+	bool srgb = format == BLOCK_BC1 || format == BLOCK_BC3;
+	mips.Generate(image.data(), width, height, (MipFilter)filter, srgb, mipmaps ? MAX_MIP_LEVELS : 1);
+
+	TextureCompressStats stats;
+	if (!WriteTextureFile(argv[arg + 1], (BlockFormat)format, mips, &stats)) {
+		return 1;
+	}
+
+	std::cout << "INFO: " << argv[arg] << " " << width << "x" << height << " " << BLOCK_FORMAT_NAMES[format] << ": "
+		<< stats.Pixels / (stats.EncodeTime * 1000000.0) << " MPix/s, " << stats.UncompressedBytes / 1024 << " KB as RGBA8 -> "
+		<< stats.CompressedBytes / 1024 << " KB (" << 100.0 * stats.CompressedBytes / stats.UncompressedBytes << "%)" << std::endl;
+	return 0;
+}
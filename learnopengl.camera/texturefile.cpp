@@ -0,0 +1,142 @@
+#include "texturefile.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static GLuint64 AlignUp(GLuint64 offset)
+{
+	return (offset + TEXTURE_FILE_ALIGNMENT - 1) / TEXTURE_FILE_ALIGNMENT * TEXTURE_FILE_ALIGNMENT;
+}
+
+TextureFile::TextureFile()
+	: Data(nullptr)
+{
+	std::memset(&this->Header, 0, sizeof(this->Header));
+}
+
+bool TextureFile::Load(const char* path)
+{
+	const AssetBundleEntry* entry = assetBundle.Find(path, ASSET_TEXTURE_FILE);
+	if (entry != nullptr) {
+		const unsigned char* data = assetBundle.GetData(*entry, this->Unpacked);
+		return data != nullptr && this->Load(data, (size_t)entry->UnpackedBytes, path);
+	}
+	if (!this->File.Open(path)) {
+		return false;
+	}
+	return this->Load(this->File.GetData(), this->File.GetSize(), path);
+}
+
+bool TextureFile::Load(const unsigned char* data, size_t size, const char* path)
+{
+	this->Data = data;
+	if (size < sizeof(TextureFileHeader)) {
+		std::cout << "ERROR::TEXTURE_FILE::TRUNCATED\n" << path << std::endl;
+		return false;
+	}
+
+	std::memcpy(&this->Header, data, sizeof(TextureFileHeader));
+	const TextureFileHeader& header = this->Header;
+	if (header.Magic != TEXTURE_FILE_MAGIC || header.Version != TEXTURE_FILE_VERSION || header.Format >= BLOCK_FORMAT_COUNT ||
+		header.InternalFormat != GetBlockInternalFormat((BlockFormat)header.Format) || header.LevelCount == 0 || header.LevelCount > MAX_TEXTURE_LEVELS) {
+		std::cout << "ERROR::TEXTURE_FILE::BAD_HEADER\n" << path << std::endl;
+		return false;
+	}
+
+	size_t levelsEnd = sizeof(TextureFileHeader) + header.LevelCount * sizeof(TextureFileLevel);
+	if (levelsEnd > size) {
+		std::cout << "ERROR::TEXTURE_FILE::TRUNCATED\n" << path << std::endl;
+		return false;
+	}
+	this->Levels.resize(header.LevelCount);
+	std::memcpy(this->Levels.data(), data + sizeof(TextureFileHeader), header.LevelCount * sizeof(TextureFileLevel));
+
+	for (const TextureFileLevel& level : this->Levels) {
+		if (level.Offset + level.Bytes > size || level.Bytes != GetCompressedSize((BlockFormat)header.Format, level.Width, level.Height)) {
+			std::cout << "ERROR::TEXTURE_FILE::TRUNCATED\n" << path << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+const TextureFileHeader& TextureFile::GetHeader()
+{
+	return this->Header;
+}
+
+const TextureFileLevel& TextureFile::GetLevel(GLuint level)
+{
+	return this->Levels[level];
+}
+
+const unsigned char* TextureFile::GetLevelData(GLuint level)
+{
+	return this->Data + this->Levels[level].Offset;
+}
+
+GLuint64 TextureFile::GetTotalBytes()
+{
+	GLuint64 bytes = 0;
+	for (const TextureFileLevel& level : this->Levels) {
+		bytes += level.Bytes;
+	}
+	return bytes;
+}
+
+bool WriteTextureFile(const char* path, BlockFormat format, MipChain& mips, TextureCompressStats* stats)
+{
+	TextureFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.Magic = TEXTURE_FILE_MAGIC;
+	header.Version = TEXTURE_FILE_VERSION;
+	header.Format = format;
+	header.InternalFormat = GetBlockInternalFormat(format);
+	header.Width = mips.GetWidth(0);
+	header.Height = mips.GetHeight(0);
+
+	std::memset(stats, 0, sizeof(*stats));
+	std::vector<TextureFileLevel> levels;
+	std::vector<std::vector<unsigned char>> blocks;
+	GLuint levelCount = mips.GetLevelCount() < MAX_TEXTURE_LEVELS ? mips.GetLevelCount() : MAX_TEXTURE_LEVELS;
+	for (GLuint i = 0; i < levelCount; i++) {
+		TextureFileLevel level;
+		level.Width = mips.GetWidth(i);
+		level.Height = mips.GetHeight(i);
+		level.Bytes = GetCompressedSize(format, level.Width, level.Height);
+		blocks.push_back(std::vector<unsigned char>(level.Bytes));
+
+		auto encodeStart = std::chrono::high_resolution_clock::now();
+		CompressImage(format, mips.GetLevelData(i), level.Width, level.Height, blocks.back().data());
+		stats->EncodeTime += std::chrono::duration<GLdouble>(std::chrono::high_resolution_clock::now() - encodeStart).count();
+		stats->Pixels += (GLuint64)level.Width * level.Height;
+		stats->UncompressedBytes += (GLuint64)level.Width * level.Height * 4;
+		stats->CompressedBytes += level.Bytes;
+		levels.push_back(level);
+	}
+
+	// levels follow the level table, each on the alignment boundary
+	header.LevelCount = (GLuint)levels.size();
+	GLuint64 offset = AlignUp(sizeof(TextureFileHeader) + levels.size() * sizeof(TextureFileLevel));
+	for (TextureFileLevel& level : levels) {
+		level.Offset = offset;
+		offset = AlignUp(offset + level.Bytes);
+	}
+
+	std::vector<unsigned char> file(offset, 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(TextureFileLevel));
+	for (size_t i = 0; i < levels.size(); i++) {
+		std::memcpy(file.data() + levels[i].Offset, blocks[i].data(), blocks[i].size());
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	out.write((const char*)file.data(), file.size());
+	if (!out) {
+		std::cout << "ERROR::TEXTURE_FILE::WRITE_FAILED\n" << path << std::endl;
+		return false;
+	}
+	return true;
+}
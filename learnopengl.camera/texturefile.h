@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "assetbundle.h"
+#include "blockcompress.h"
+#include "mappedfile.h"
+#include "mipchain.h"
+
+// "LTEX", little-endian
+const GLuint TEXTURE_FILE_MAGIC = 0x5845544C;
+const GLuint TEXTURE_FILE_VERSION = 2;
+// levels start on this boundary so they can go to GL straight from the mapping
+const GLuint TEXTURE_FILE_ALIGNMENT = 16;
+// enough for a 32768 texel side
+const GLuint MAX_TEXTURE_LEVELS = 16;
+
+// one mip level's blocks, rows of blocks in GL's order: the image's bottom row first, as texconvert lays it out
+struct TextureFileLevel
+{
+	GLuint64 Offset;
+	GLuint64 Bytes;
+	GLuint Width;
+	GLuint Height;
+};
+
+// the file starts with this, followed by LevelCount TextureFileLevels, largest first
+struct TextureFileHeader
+{
+	GLuint Magic;
+	GLuint Version;
+	// a BlockFormat, and the GL internal format it uploads as; a file where they disagree doesn't load
+	GLuint Format;
+	GLenum InternalFormat;
+	GLuint Width;
+	GLuint Height;
+	GLuint LevelCount;
+	GLuint Reserved;
+};
+
+static_assert(sizeof(TextureFileHeader) == 32, "TextureFileHeader must have no padding");
+static_assert(sizeof(TextureFileLevel) == 24, "TextureFileLevel must have no padding");
+
+// a block-compressed mip chain mapped into memory; levels are handed out straight from the mapping, which is the
+// asset bundle's if it has the file
+class TextureFile
+{
+public:
+	TextureFile();
+
+	bool Load(const char* path);
+	// reads a texture file already in memory, which must outlive this; path is only for messages
+	bool Load(const unsigned char* data, size_t size, const char* path);
+
+	const TextureFileHeader& GetHeader();
+	const TextureFileLevel& GetLevel(GLuint level);
+	const unsigned char* GetLevelData(GLuint level);
+	// every level's bytes together
+	GLuint64 GetTotalBytes();
+
+private:
+	MappedFile File;
+	// backs Data if the bundle stored the file packed
+	std::vector<unsigned char> Unpacked;
+	const unsigned char* Data;
+	TextureFileHeader Header;
+	std::vector<TextureFileLevel> Levels;
+};
+
+// what compressing a mip chain took, for reporting
+struct TextureCompressStats
+{
+	GLdouble EncodeTime;
+	GLuint64 Pixels;
+	// the chain as RGBA8 against as blocks
+	GLuint64 UncompressedBytes;
+	GLuint64 CompressedBytes;
+};
+
+// compresses every level of mips (up to MAX_TEXTURE_LEVELS) and writes them as a texture file
+bool WriteTextureFile(const char* path, BlockFormat format, MipChain& mips, TextureCompressStats* stats);
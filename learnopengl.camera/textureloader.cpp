@@ -0,0 +1,981 @@
+#include "textureloader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <SOIL.h>
+
+#include "glstate.h"
+#include "pixelconvert.h"
+
+TextureLoader::TextureLoader(GLuint workerCount)
+	: Budget(0), Frame(0), NextUploadBuffer(0), Uploading(GL_FALSE), Stopping(false)
+{
+	if (workerCount == 0) {
+		GLuint cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+	std::memset(&this->CacheStats, 0, sizeof(this->CacheStats));
+
+	// a grey checker, so anything still loading is obvious without being garish
+	const GLubyte placeholder[] = {
+		96, 96, 96, 255,	160, 160, 160, 255,
+		160, 160, 160, 255,	96, 96, 96, 255
+	};
+	glGenTextures(1, &this->PlaceholderId);
+	glState.BindTexture(0, GL_TEXTURE_2D, this->PlaceholderId);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glState.BindTexture(0, GL_TEXTURE_2D, 0);
+
+	glGenBuffers(TEXTURE_UPLOAD_BUFFERS, this->UploadBufferIds);
+
+	for (GLuint i = 0; i < workerCount; i++) {
+		this->Workers.push_back(std::thread(&TextureLoader::Work, this));
+	}
+}
+
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->JobMutex);
+		this->Stopping = true;
+	}
+	this->JobReady.notify_all();
+	for (std::thread& worker : this->Workers) {
+		worker.join();
+	}
+
+	if (this->Uploading) {
+		this->AbandonUpload();
+	}
+	for (const Texture& texture : this->Textures) {
+		if (texture.TextureId != 0) {
+			glState.DeleteTextures(1, &texture.TextureId);
+		}
+		if (texture.PendingId != 0) {
+			glState.DeleteTextures(1, &texture.PendingId);
+		}
+	}
+	glState.DeleteTextures(1, &this->PlaceholderId);
+	glState.DeleteBuffers(TEXTURE_UPLOAD_BUFFERS, this->UploadBufferIds);
+}
+
+std::string TextureLoader::GetPathKey(const char* path, GLenum wrapType, GLenum filterType, bool srgb)
+{
+	return std::string(path) + "|" + std::to_string(wrapType) + "|" + std::to_string(filterType) + (srgb ? "|srgb" : "|linear");
+}
+
+TextureLoader::Handle TextureLoader::AddTexture(const Texture& texture)
+{
+	if (this->FreeHandles.empty()) {
+		this->Textures.push_back(texture);
+		return (Handle)this->Textures.size() - 1;
+	}
+	// anything still in flight for the last holder of the handle carries the old generation, and is dropped
+	Handle handle = this->FreeHandles.back();
+	this->FreeHandles.pop_back();
+	GLuint generation = this->Textures[handle].Generation + 1;
+	this->Textures[handle] = texture;
+	this->Textures[handle].Generation = generation;
+	return handle;
+}
+
+TextureLoader::Handle TextureLoader::Load(const char* path, GLenum wrapType, GLenum filterType, bool srgb)
+{
+	std::string key = GetPathKey(path, wrapType, filterType, srgb);
+	std::map<std::string, Handle>::iterator found = this->ByPath.find(key);
+	if (found != this->ByPath.end()) {
+		this->Textures[found->second].RefCount++;
+		this->CacheStats.PathHits++;
+		return found->second;
+	}
+
+	Texture texture;
+	texture.Path = path;
+	texture.WrapType = wrapType;
+	texture.FilterType = filterType;
+	texture.Srgb = srgb;
+	texture.Target = GL_TEXTURE_2D;
+	texture.TextureId = 0;
+	texture.PendingId = 0;
+	texture.Failed = GL_FALSE;
+	texture.Loading = GL_FALSE;
+	texture.RefCount = 1;
+	texture.Generation = 0;
+	texture.ContentKey = 0;
+	texture.Width = 0;
+	texture.Height = 0;
+	texture.FirstLevel = 0;
+	texture.RequestedLevel = 0;
+	texture.Bytes = 0;
+	texture.LastUsed = this->Frame;
+	texture.VisibleLevel = 0;
+	texture.MinLod = 0.0f;
+	texture.Streamed = GL_FALSE;
+	texture.ScreenSize = 0.0f;
+	texture.Footprint = 0.0f;
+	texture.Size = 0;
+	texture.LayerCount = 0;
+	texture.LayersUsed = 0;
+	texture.LayersPending = 0;
+
+	Handle handle = this->AddTexture(texture);
+	this->Textures[handle].Storage = handle;
+	this->ByPath[key] = handle;
+	this->CacheStats.Misses++;
+	this->Request(handle);
+	return handle;
+}
+
+void TextureLoader::Request(Handle handle)
+{
+	Texture& texture = this->Textures[handle];
+	texture.Loading = GL_TRUE;
+	texture.QueuedTime = std::chrono::steady_clock::now();
+	if (texture.Target == GL_TEXTURE_2D) {
+		{
+			std::lock_guard<std::mutex> lock(this->JobMutex);
+			Job job;
+			job.Texture = handle;
+			job.Generation = texture.Generation;
+			job.Path = texture.Path;
+			job.Srgb = texture.Srgb;
+			job.Layer = -1;
+			job.Size = 0;
+			this->Jobs.push_back(job);
+		}
+		this->JobReady.notify_one();
+		return;
+	}
+
+	// an array's layers all go into one new array, so each is loaded again; their chains are in the mip cache by now.
+	// layers still on their way to the old one are dropped, and loaded with the rest
+	if (texture.PendingId != 0) {
+		glState.DeleteTextures(1, &texture.PendingId);
+	}
+	texture.PendingId = this->AllocateArray(texture, texture.RequestedLevel);
+	texture.Generation++;
+	texture.LayersPending = texture.LayersUsed;
+	{
+		std::lock_guard<std::mutex> lock(this->JobMutex);
+		for (GLuint layer = 0; layer < texture.LayersUsed; layer++) {
+			Job job;
+			job.Texture = handle;
+			job.Generation = texture.Generation;
+			job.Path = texture.LayerPaths[layer];
+			job.Srgb = texture.LayerSrgb[layer];
+			job.Layer = (GLint)layer;
+			job.Size = texture.Size;
+			this->Jobs.push_back(job);
+		}
+	}
+	this->JobReady.notify_all();
+	if (texture.LayersPending == 0) {
+		this->FinishLayer(texture);
+	}
+}
+
+GLuint TextureLoader::AllocateArray(const Texture& texture, GLuint firstLevel)
+{
+	// every level of every layer starts grey, standing in for the placeholder until its image is up
+	GLuint size = texture.Size >> firstLevel;
+	std::vector<GLubyte> grey((size_t)size * size * texture.LayerCount * 4, 128);
+	GLuint arrayId;
+	glGenTextures(1, &arrayId);
+	glState.BindTexture(0, GL_TEXTURE_2D_ARRAY, arrayId);
+	GLuint levelCount = 0;
+	for (GLuint levelSize = size; ; levelSize /= 2) {
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, levelCount++, GL_RGBA8, levelSize, levelSize, texture.LayerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey.data());
+		if (levelSize == 1) {
+			break;
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, texture.WrapType);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, texture.WrapType);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, texture.FilterType);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, texture.FilterType);
+	glState.BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+	return arrayId;
+}
+
+void TextureLoader::Release(Handle texture)
+{
+	Texture& entry = this->Textures[texture];
+	if (entry.RefCount == 0 || --entry.RefCount > 0) {
+		return;
+	}
+
+	// nothing holds it any more: drop whatever's in flight, free the texture, and give the handle back
+	entry.Generation++;
+	entry.Loading = GL_FALSE;
+	if (entry.TextureId != 0) {
+		glState.DeleteTextures(1, &entry.TextureId);
+		entry.TextureId = 0;
+	}
+	if (entry.PendingId != 0) {
+		glState.DeleteTextures(1, &entry.PendingId);
+		entry.PendingId = 0;
+	}
+	entry.Bytes = 0;
+	if (entry.Target == GL_TEXTURE_2D) {
+		std::map<std::string, Handle>::iterator found = this->ByPath.find(GetPathKey(entry.Path.c_str(), entry.WrapType, entry.FilterType, entry.Srgb));
+		if (found != this->ByPath.end() && found->second == texture) {
+			this->ByPath.erase(found);
+		}
+	}
+	this->FreeHandles.push_back(texture);
+	if (entry.Storage != texture) {
+		this->Release(entry.Storage);
+	}
+}
+
+TextureLoader::Handle TextureLoader::CreateArray(GLuint size, GLuint layerCount, GLenum wrapType, GLenum filterType)
+{
+	Texture texture;
+	texture.Path = "texture array";
+	texture.PendingId = 0;
+	texture.WrapType = wrapType;
+	texture.FilterType = filterType;
+	texture.Srgb = true;
+	texture.Target = GL_TEXTURE_2D_ARRAY;
+	texture.Failed = GL_FALSE;
+	texture.Loading = GL_FALSE;
+	texture.QueuedTime = std::chrono::steady_clock::now();
+	texture.RefCount = 1;
+	texture.Generation = 0;
+	texture.ContentKey = 0;
+	texture.Width = size;
+	texture.Height = size;
+	texture.FirstLevel = 0;
+	texture.RequestedLevel = 0;
+	texture.Bytes = 0;
+	texture.LastUsed = this->Frame;
+	texture.VisibleLevel = 0;
+	texture.MinLod = 0.0f;
+	texture.Streamed = GL_FALSE;
+	texture.ScreenSize = 0.0f;
+	texture.Footprint = 0.0f;
+	texture.Size = size;
+	texture.LayerCount = layerCount;
+	texture.LayersUsed = 0;
+	texture.LayersPending = 0;
+
+	for (GLuint levelSize = size; ; levelSize /= 2) {
+		texture.LevelBytes.push_back((GLuint64)levelSize * levelSize * layerCount * 4);
+		texture.Bytes += texture.LevelBytes.back();
+		if (levelSize == 1) {
+			break;
+		}
+	}
+	texture.TextureId = this->AllocateArray(texture, 0);
+
+	Handle handle = this->AddTexture(texture);
+	this->Textures[handle].Storage = handle;
+	return handle;
+}
+
+GLint TextureLoader::LoadLayer(Handle array, const char* path, bool srgb)
+{
+	Texture& texture = this->Textures[array];
+	if (texture.LayersUsed == texture.LayerCount) {
+		std::cout << "ERROR::TEXTURE::ARRAY_FULL\n" << path << " doesn't fit in " << texture.LayerCount << " layers" << std::endl;
+		return -1;
+	}
+	GLint layer = (GLint)texture.LayersUsed++;
+	texture.LayersPending++;
+	texture.LayerPaths.push_back(path);
+	texture.LayerSrgb.push_back(srgb);
+
+	{
+		std::lock_guard<std::mutex> lock(this->JobMutex);
+		Job job;
+		job.Texture = array;
+		job.Generation = texture.Generation;
+		job.Path = path;
+		job.Srgb = srgb;
+		job.Layer = layer;
+		job.Size = texture.Size;
+		this->Jobs.push_back(job);
+	}
+	this->JobReady.notify_one();
+	return layer;
+}
+
+void TextureLoader::Work()
+{
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(this->JobMutex);
+			this->JobReady.wait(lock, [this] { return this->Stopping || !this->Jobs.empty(); });
+			if (this->Stopping) {
+				return;
+			}
+			job = this->Jobs.front();
+			this->Jobs.pop_front();
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Decoded decoded;
+		decoded.Texture = job.Texture;
+		decoded.Generation = job.Generation;
+		decoded.Path = job.Path;
+		decoded.Layer = job.Layer;
+		decoded.TextureId = 0;
+		decoded.FirstLevel = 0;
+		decoded.ContentKey = 0;
+		decoded.Swapped = GL_FALSE;
+		decoded.MipsCached = GL_FALSE;
+		decoded.MipsCooked = GL_FALSE;
+		decoded.Width = 0;
+		decoded.Height = 0;
+		decoded.Level = 0;
+		decoded.UploadedRows = 0;
+
+		// a pre-compressed chain needs no decoding at all, just mapping
+		size_t dot = job.Path.find_last_of('.');
+		std::string compressedPath = job.Path.substr(0, dot == std::string::npos || dot == 0 ? job.Path.size() : dot) + ".ctex";
+		std::shared_ptr<TextureFile> file = std::make_shared<TextureFile>();
+		if (job.Layer == -1 && file->Load(compressedPath.c_str())) {
+			decoded.File = file;
+			decoded.Width = (int)file->GetHeader().Width;
+			decoded.Height = (int)file->GetHeader().Height;
+			// two files with the same top level are the same texture, near enough
+			const unsigned char* top = file->GetLevelData(0);
+			decoded.ContentKey = HashMipSource(top, (size_t)file->GetLevel(0).Bytes, TEXTURE_MIP_FILTER, job.Srgb);
+		}
+		else {
+			this->DecodeMips(job, decoded);
+		}
+		decoded.DecodeTime = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(this->DecodedMutex);
+		this->DecodedImages.push_back(decoded);
+	}
+}
+
+void TextureLoader::DecodeMips(const Job& job, Decoded& decoded)
+{
+	// a chain cooked at the size asked for needs nothing read but itself
+	std::shared_ptr<MipChain> cooked = std::make_shared<MipChain>();
+	GLuint64 cookedKey;
+	if (cooked->LoadCooked(job.Path.c_str(), job.Srgb, &cookedKey) &&
+		(job.Size == 0 || (cooked->GetWidth(0) == job.Size && cooked->GetHeight(0) == job.Size))) {
+		decoded.Mips = cooked;
+		decoded.MipsCooked = GL_TRUE;
+		decoded.ContentKey = cookedKey;
+		decoded.Width = (int)cooked->GetWidth(0);
+		decoded.Height = (int)cooked->GetHeight(0);
+		return;
+	}
+
+	// the cache is keyed by the file's bytes, so a hit skips decoding as well as filtering
+	MappedFile source;
+	if (!source.Open(job.Path.c_str())) {
+		return;
+	}
+	GLuint64 key = HashMipSource(source.GetData(), source.GetSize(), TEXTURE_MIP_FILTER, job.Srgb, job.Size, job.Size);
+	decoded.ContentKey = key;
+	std::string cachePath = GetMipCachePath(key);
+	std::shared_ptr<MipChain> mips = std::make_shared<MipChain>();
+	if (mips->Load(cachePath.c_str(), key)) {
+		decoded.Mips = mips;
+		decoded.MipsCached = GL_TRUE;
+		decoded.Width = (int)mips->GetWidth(0);
+		decoded.Height = (int)mips->GetHeight(0);
+		return;
+	}
+
+	// decoded as the file has it and converted here, where the kernels are faster than SOIL's expansion. grey
+	// images are rare enough that SOIL just expands them on a second decode
+	int channels;
+	unsigned char* pixels = SOIL_load_image_from_memory(source.GetData(), (int)source.GetSize(), &decoded.Width, &decoded.Height, &channels, SOIL_LOAD_AUTO);
+	if (pixels != nullptr && channels < 3) {
+		SOIL_free_image_data(pixels);
+		pixels = SOIL_load_image_from_memory(source.GetData(), (int)source.GetSize(), &decoded.Width, &decoded.Height, &channels, SOIL_LOAD_RGBA);
+		channels = 4;
+	}
+	if (pixels == nullptr) {
+		return;
+	}
+	// always four channels, so rows stay 4-byte aligned and the driver never has to expand RGB on upload
+	std::vector<unsigned char> rgba((size_t)decoded.Width * decoded.Height * 4);
+	ConvertToUploadLayout(pixels, decoded.Width, decoded.Height, channels, rgba.data());
+	SOIL_free_image_data(pixels);
+	if (job.Size != 0 && (decoded.Width != (int)job.Size || decoded.Height != (int)job.Size)) {
+		// into its array's bucket; the Kaiser filter resizes to anything, the box filter only halves
+		std::vector<unsigned char> resized((size_t)job.Size * job.Size * 4);
+		ResizeImage(rgba.data(), decoded.Width, decoded.Height, job.Size, job.Size, MIP_FILTER_KAISER, job.Srgb, resized.data());
+		decoded.Width = (int)job.Size;
+		decoded.Height = (int)job.Size;
+		mips->Generate(resized.data(), job.Size, job.Size, TEXTURE_MIP_FILTER, job.Srgb);
+	}
+	else {
+		mips->Generate(rgba.data(), decoded.Width, decoded.Height, TEXTURE_MIP_FILTER, job.Srgb);
+	}
+	mips->Save(cachePath.c_str(), key);
+	decoded.Mips = mips;
+}
+
+GLuint TextureLoader::Update(GLdouble budget)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GLuint madeResident = 0;
+	this->Frame++;
+
+	do {
+		if (this->Uploading && this->Textures[this->Current.Texture].Generation != this->Current.Generation) {
+			this->AbandonUpload();
+		}
+		if (!this->Uploading) {
+			{
+				std::lock_guard<std::mutex> lock(this->DecodedMutex);
+				if (this->DecodedImages.empty()) {
+					break;
+				}
+				this->Current = this->DecodedImages.front();
+				this->DecodedImages.pop_front();
+			}
+
+			Texture& texture = this->Textures[this->Current.Texture];
+			if (texture.Generation != this->Current.Generation) {
+				// released, unloaded or asked for other levels since it was queued
+				this->Current.Mips.reset();
+				this->Current.File.reset();
+				continue;
+			}
+			if (!this->Current.Mips && !this->Current.File) {
+				std::cout << "ERROR::TEXTURE::LOAD_FAILED\n" << this->Current.Path << std::endl;
+				if (this->Current.Layer != -1) {
+					// the layer just stays grey
+					this->FinishLayer(texture);
+				}
+				else {
+					texture.Failed = GL_TRUE;
+					texture.Loading = GL_FALSE;
+				}
+				continue;
+			}
+			if (this->Current.File && this->Current.File->GetHeader().Format != BLOCK_BC4 && this->Current.File->GetHeader().Format != BLOCK_BC5 &&
+				!GLEW_EXT_texture_compression_s3tc) {
+				std::cout << "ERROR::TEXTURE::FORMAT_UNSUPPORTED\n" << this->Current.Path << " needs EXT_texture_compression_s3tc" << std::endl;
+				texture.Failed = GL_TRUE;
+				texture.Loading = GL_FALSE;
+				this->Current.File.reset();
+				continue;
+			}
+			// only on a first load: a texture coming back from an unload may have others sharing it already
+			if (this->Current.Layer == -1 && texture.LevelBytes.empty() && this->ShareStorage(this->Current.Texture, this->Current.ContentKey)) {
+				// another path had the same image; this handle shows that texture from now on
+				std::cout << "INFO: " << this->Current.Path << " has the same content as " << this->Textures[texture.Storage].Path << ", sharing it" << std::endl;
+				this->Current.Mips.reset();
+				this->Current.File.reset();
+				continue;
+			}
+
+			// storage first; the rows follow in bands over however many frames they take, smallest level first, so
+			// there's something to draw from after the first few. arrays have theirs already
+			GLuint levelCount = this->Current.File ? this->Current.File->GetHeader().LevelCount : this->Current.Mips->GetLevelCount();
+			if (this->Current.Layer == -1) {
+				GLuint firstLevel = texture.RequestedLevel;
+				if (texture.LevelBytes.empty() && texture.Streamed) {
+					// a first load of a streamed texture gets only what its footprint needs, or a small start if it has none yet
+					GLfloat footprint = texture.Footprint > 0.0f ? texture.Footprint : (GLfloat)TEXTURE_STREAM_INITIAL_SIZE;
+					firstLevel = GetLevelForFootprint((GLuint)this->Current.Width, (GLuint)this->Current.Height, levelCount, footprint);
+					texture.RequestedLevel = firstLevel;
+				}
+				this->Current.FirstLevel = firstLevel < levelCount ? firstLevel : levelCount - 1;
+				this->AllocateStorage(texture);
+			}
+			else {
+				// into the array being rebuilt, if there is one
+				this->Current.TextureId = texture.PendingId != 0 ? texture.PendingId : texture.TextureId;
+				this->Current.FirstLevel = texture.PendingId != 0 ? texture.RequestedLevel : texture.FirstLevel;
+			}
+			this->Current.Level = levelCount - 1;
+			this->Uploading = GL_TRUE;
+		}
+
+		if (this->UploadStep()) {
+			Texture& texture = this->Textures[this->Current.Texture];
+			if (this->Current.Layer == -1) {
+				this->ShowLevel();
+			}
+			if (this->Current.Level > this->Current.FirstLevel) {
+				this->Current.Level--;
+				continue;
+			}
+
+			GLuint64 bytes = 0;
+			std::cout << "INFO: " << this->Current.Path << " " << this->Current.Width << "x" << this->Current.Height;
+			if (this->Current.Layer == -1) {
+				texture.Loading = GL_FALSE;
+				bytes = texture.Bytes;
+			}
+			else {
+				bytes = this->Current.Mips->GetTotalBytes();
+				this->FinishLayer(texture);
+			}
+
+			if (this->Current.File) {
+				// the chain came ready made
+				const TextureFileHeader& header = this->Current.File->GetHeader();
+				std::cout << " " << BLOCK_FORMAT_NAMES[header.Format] << ", " << header.LevelCount - this->Current.FirstLevel << " levels, mapped in ";
+				this->Current.File.reset();
+			}
+			else {
+				std::cout << " RGBA8";
+				if (this->Current.Layer != -1) {
+					std::cout << " in array layer " << this->Current.Layer;
+				}
+				std::cout << ", " << this->Current.Mips->GetLevelCount() - this->Current.FirstLevel << " levels, "
+					<< (this->Current.MipsCooked ? "mapped from the asset bundle in " : (this->Current.MipsCached ? "mapped from the mip cache in " : "decoded and filtered in "));
+				this->Current.Mips.reset();
+			}
+			this->Uploading = GL_FALSE;
+			madeResident++;
+
+			GLdouble sinceLoad = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - texture.QueuedTime).count();
+			std::cout << this->Current.DecodeTime * 1000.0 << " ms, " << bytes / 1024 << " KB resident " << sinceLoad * 1000.0 << " ms after Load" << std::endl;
+		}
+	} while (std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count() < budget);
+
+	this->Evict();
+	this->Stream();
+	return madeResident;
+}
+
+void TextureLoader::ShowLevel()
+{
+	Texture& texture = this->Textures[this->Current.Texture];
+	GLuint level = this->Current.Level;
+	if (!this->Current.Swapped) {
+		// the texture being replaced stays in use until the new one is as sharp, or entirely up if it's to be blurrier
+		if (texture.TextureId != 0 && level > texture.VisibleLevel && level > this->Current.FirstLevel) {
+			return;
+		}
+		if (texture.TextureId != 0) {
+			glState.DeleteTextures(1, &texture.TextureId);
+		}
+		texture.TextureId = this->Current.TextureId;
+		texture.ContentKey = this->Current.ContentKey;
+		texture.Width = (GLuint)this->Current.Width;
+		texture.Height = (GLuint)this->Current.Height;
+		texture.FirstLevel = this->Current.FirstLevel;
+		texture.LevelBytes.clear();
+		texture.Bytes = 0;
+		GLuint levelCount = this->Current.File ? this->Current.File->GetHeader().LevelCount : this->Current.Mips->GetLevelCount();
+		for (GLuint chainLevel = 0; chainLevel < levelCount; chainLevel++) {
+			if (this->Current.File) {
+				texture.LevelBytes.push_back(this->Current.File->GetLevel(chainLevel).Bytes);
+			}
+			else {
+				texture.LevelBytes.push_back((GLuint64)this->Current.Mips->GetWidth(chainLevel) * this->Current.Mips->GetHeight(chainLevel) * 4);
+			}
+			if (chainLevel >= texture.FirstLevel) {
+				texture.Bytes += texture.LevelBytes.back();
+			}
+		}
+		if (texture.VisibleLevel < level) {
+			// nothing was showing, or something blurrier than this; either way there's nothing to fade from
+			texture.VisibleLevel = level;
+			texture.MinLod = 0.0f;
+		}
+		this->Current.Swapped = GL_TRUE;
+	}
+
+	// sampling starts at the new level; MIN_LOD holds it where it was for the fade in Stream
+	texture.MinLod += (GLfloat)(texture.VisibleLevel - level);
+	texture.VisibleLevel = level;
+	glState.BindTexture(0, GL_TEXTURE_2D, texture.TextureId);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)(level - texture.FirstLevel));
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, texture.MinLod);
+}
+
+void TextureLoader::FinishLayer(Texture& texture)
+{
+	if (texture.LayersPending > 0) {
+		texture.LayersPending--;
+	}
+	if (texture.LayersPending > 0 || texture.PendingId == 0) {
+		return;
+	}
+
+	// every layer is in the rebuilt array, which replaces the old one
+	glState.DeleteTextures(1, &texture.TextureId);
+	texture.TextureId = texture.PendingId;
+	texture.PendingId = 0;
+	GLfloat shown = (GLfloat)texture.VisibleLevel + texture.MinLod;
+	texture.FirstLevel = texture.RequestedLevel;
+	texture.VisibleLevel = texture.RequestedLevel;
+	texture.MinLod = shown > (GLfloat)texture.FirstLevel ? shown - (GLfloat)texture.FirstLevel : 0.0f;
+	texture.Bytes = 0;
+	for (GLuint level = texture.FirstLevel; level < texture.LevelBytes.size(); level++) {
+		texture.Bytes += texture.LevelBytes[level];
+	}
+	texture.Loading = GL_FALSE;
+	glState.BindTexture(0, GL_TEXTURE_2D_ARRAY, texture.TextureId);
+	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_LOD, texture.MinLod);
+}
+
+void TextureLoader::AbandonUpload()
+{
+	// once swapped in the texture is the entry's, and goes with it
+	if (this->Current.Layer == -1 && this->Current.TextureId != 0 && !this->Current.Swapped) {
+		glState.DeleteTextures(1, &this->Current.TextureId);
+	}
+	this->Current.Mips.reset();
+	this->Current.File.reset();
+	this->Uploading = GL_FALSE;
+}
+
+bool TextureLoader::ShareStorage(Handle handle, GLuint64 contentKey)
+{
+	Texture& texture = this->Textures[handle];
+	for (Handle other = 0; other < (Handle)this->Textures.size(); other++) {
+		const Texture& owner = this->Textures[other];
+		if (other == handle || owner.RefCount == 0 || owner.Storage != other || owner.Target != GL_TEXTURE_2D ||
+			owner.TextureId == 0 || owner.ContentKey != contentKey || owner.WrapType != texture.WrapType || owner.FilterType != texture.FilterType) {
+			continue;
+		}
+		texture.Storage = other;
+		texture.Loading = GL_FALSE;
+		texture.ContentKey = contentKey;
+		this->Textures[other].RefCount++;
+		this->CacheStats.ContentHits++;
+		return true;
+	}
+	return false;
+}
+
+void TextureLoader::Unload(Handle handle)
+{
+	Texture& texture = this->Textures[handle];
+	glState.DeleteTextures(1, &texture.TextureId);
+	texture.TextureId = 0;
+	texture.Bytes = 0;
+	texture.VisibleLevel = 0;
+	texture.MinLod = 0.0f;
+	texture.Loading = GL_FALSE;
+	texture.Generation++;
+	// the next Bind brings it back as small as it had got
+	texture.RequestedLevel = texture.FirstLevel;
+}
+
+GLuint64 TextureLoader::GetCommittedBytes()
+{
+	GLuint64 committed = 0;
+	for (const Texture& texture : this->Textures) {
+		if (texture.RefCount == 0) {
+			continue;
+		}
+		if (texture.Loading && texture.RequestedLevel < texture.LevelBytes.size()) {
+			for (GLuint level = texture.RequestedLevel; level < texture.LevelBytes.size(); level++) {
+				committed += texture.LevelBytes[level];
+			}
+		}
+		else {
+			committed += texture.Bytes;
+		}
+	}
+	return committed;
+}
+
+void TextureLoader::Evict()
+{
+	GLuint64 committed = this->GetCommittedBytes();
+	if (this->Budget == 0 || committed <= this->Budget) {
+		return;
+	}
+
+	// anything bound last frame is likely to be bound again this one; the rest go least recently used first.
+	// arrays share one texture between many objects and aren't evicted
+	std::vector<Handle> candidates;
+	for (Handle handle = 0; handle < (Handle)this->Textures.size(); handle++) {
+		const Texture& texture = this->Textures[handle];
+		if (texture.RefCount > 0 && texture.Storage == handle && texture.Target == GL_TEXTURE_2D && texture.TextureId != 0 &&
+			!texture.Loading && texture.LastUsed + 1 < this->Frame) {
+			candidates.push_back(handle);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](Handle a, Handle b) { return this->Textures[a].LastUsed < this->Textures[b].LastUsed; });
+
+	// dropping top levels first keeps everything drawable, if blurrier. the smaller texture is uploaded from the
+	// chain again and replaces this one once it's up, so the bytes are only freed then
+	for (Handle handle : candidates) {
+		Texture& texture = this->Textures[handle];
+		GLuint level = texture.FirstLevel;
+		while (committed > this->Budget && level + 1 < texture.LevelBytes.size() &&
+			std::max(texture.Width >> (level + 1), texture.Height >> (level + 1)) >= TEXTURE_EVICT_MIN_SIZE) {
+			committed -= texture.LevelBytes[level];
+			level++;
+		}
+		if (level != texture.FirstLevel) {
+			this->CacheStats.LevelsEvicted += level - texture.FirstLevel;
+			texture.RequestedLevel = level;
+			this->Request(handle);
+		}
+		if (committed <= this->Budget) {
+			return;
+		}
+	}
+
+	// still over with everything small: out entirely, in the same order
+	for (Handle handle : candidates) {
+		Texture& texture = this->Textures[handle];
+		if (texture.Loading) {
+			// losing levels above; it'll be looked at again next frame
+			continue;
+		}
+		committed -= texture.Bytes;
+		this->Unload(handle);
+		this->CacheStats.Unloads++;
+		if (committed <= this->Budget) {
+			return;
+		}
+	}
+}
+
+void TextureLoader::Stream()
+{
+	GLuint64 committed = this->GetCommittedBytes();
+	for (Handle handle = 0; handle < (Handle)this->Textures.size(); handle++) {
+		Texture& texture = this->Textures[handle];
+		// last frame's asks are this frame's footprint
+		texture.Footprint = texture.ScreenSize;
+		texture.ScreenSize = 0.0f;
+		if (texture.RefCount == 0 || texture.Storage != handle || texture.TextureId == 0) {
+			continue;
+		}
+
+		// levels that have landed fade in a little each frame, rather than all at once
+		if (texture.MinLod > 0.0f) {
+			texture.MinLod -= std::max(texture.MinLod, 1.0f) / TEXTURE_STREAM_FADE_FRAMES;
+			texture.MinLod = std::max(texture.MinLod, 0.0f);
+			glState.BindTexture(0, texture.Target, texture.TextureId);
+			glTexParameterf(texture.Target, GL_TEXTURE_MIN_LOD, texture.MinLod);
+		}
+
+		if (!texture.Streamed || texture.Loading || texture.LayersPending > 0 || texture.Footprint == 0.0f) {
+			continue;
+		}
+		GLuint levelCount = (GLuint)texture.LevelBytes.size();
+		GLuint wanted = GetLevelForFootprint(texture.Width, texture.Height, levelCount, texture.Footprint);
+		if (wanted < texture.FirstLevel) {
+			// sharper levels, as many as fit the budget; they're uploaded smallest first into a new texture that
+			// takes over as soon as it matches this one
+			GLuint64 added = 0;
+			for (GLuint level = wanted; level < texture.FirstLevel; level++) {
+				added += texture.LevelBytes[level];
+			}
+			while (this->Budget != 0 && wanted < texture.FirstLevel && committed + added > this->Budget) {
+				added -= texture.LevelBytes[wanted];
+				wanted++;
+			}
+			if (wanted == texture.FirstLevel) {
+				continue;
+			}
+			committed += added;
+			texture.RequestedLevel = wanted;
+			this->Request(handle);
+			this->CacheStats.StreamIns++;
+		}
+		else if (wanted >= texture.FirstLevel + TEXTURE_STREAM_OUT_LEVELS) {
+			// the detail isn't seen any more: stop sampling it now, and free it once a texture without it is up
+			texture.VisibleLevel = wanted;
+			texture.MinLod = 0.0f;
+			glState.BindTexture(0, texture.Target, texture.TextureId);
+			glTexParameteri(texture.Target, GL_TEXTURE_BASE_LEVEL, (GLint)(wanted - texture.FirstLevel));
+			glTexParameterf(texture.Target, GL_TEXTURE_MIN_LOD, 0.0f);
+			texture.RequestedLevel = wanted;
+			this->Request(handle);
+			this->CacheStats.StreamOuts++;
+		}
+	}
+}
+
+GLuint TextureLoader::GetLevelForFootprint(GLuint width, GLuint height, GLuint levelCount, GLfloat footprint)
+{
+	GLuint size = std::max(width, height);
+	GLuint level = 0;
+	while (level + 1 < levelCount && (GLfloat)(size >> (level + 1)) >= footprint) {
+		level++;
+	}
+	return level;
+}
+
+void TextureLoader::AllocateStorage(const Texture& texture)
+{
+	// a texture of its own every time, so a reload at fewer levels can go up while the old one is still drawn
+	glGenTextures(1, &this->Current.TextureId);
+	glState.BindTexture(0, GL_TEXTURE_2D, this->Current.TextureId);
+	GLuint firstLevel = this->Current.FirstLevel;
+	if (this->Current.File) {
+		const TextureFileHeader& header = this->Current.File->GetHeader();
+		for (GLuint level = firstLevel; level < header.LevelCount; level++) {
+			const TextureFileLevel& entry = this->Current.File->GetLevel(level);
+			glCompressedTexImage2D(GL_TEXTURE_2D, level - firstLevel, header.InternalFormat, entry.Width, entry.Height, 0, (GLsizei)entry.Bytes, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.LevelCount - 1 - firstLevel);
+	}
+	else {
+		for (GLuint level = firstLevel; level < this->Current.Mips->GetLevelCount(); level++) {
+			glTexImage2D(GL_TEXTURE_2D, level - firstLevel, GL_RGBA8, this->Current.Mips->GetWidth(level), this->Current.Mips->GetHeight(level), 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, this->Current.Mips->GetLevelCount() - 1 - firstLevel);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture.WrapType);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture.WrapType);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.FilterType);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture.FilterType);
+}
+
+bool TextureLoader::UploadStep()
+{
+	const Texture& texture = this->Textures[this->Current.Texture];
+
+	// a row of blocks covers four rows of texels; uncompressed rows cover one
+	const unsigned char* levelData;
+	int levelWidth, levelHeight, texelRowsPerRow;
+	GLsizeiptr rowBytes;
+	if (this->Current.Mips) {
+		levelData = this->Current.Mips->GetLevelData(this->Current.Level);
+		levelWidth = (int)this->Current.Mips->GetWidth(this->Current.Level);
+		levelHeight = (int)this->Current.Mips->GetHeight(this->Current.Level);
+		texelRowsPerRow = 1;
+		rowBytes = (GLsizeiptr)levelWidth * 4;
+	}
+	else {
+		const TextureFileHeader& header = this->Current.File->GetHeader();
+		const TextureFileLevel& level = this->Current.File->GetLevel(this->Current.Level);
+		levelData = this->Current.File->GetLevelData(this->Current.Level);
+		levelWidth = (int)level.Width;
+		levelHeight = (int)level.Height;
+		texelRowsPerRow = 4;
+		rowBytes = (GLsizeiptr)((levelWidth + 3) / 4) * GetBlockBytes((BlockFormat)header.Format);
+	}
+
+	int rowCount = (levelHeight + texelRowsPerRow - 1) / texelRowsPerRow;
+	int firstRow = this->Current.UploadedRows / texelRowsPerRow;
+	int rows = (int)(TEXTURE_UPLOAD_CHUNK / rowBytes);
+	rows = rows < 1 ? 1 : rows;
+	rows = rows > rowCount - firstRow ? rowCount - firstRow : rows;
+	GLsizeiptr bytes = rows * rowBytes;
+	const unsigned char* source = levelData + firstRow * rowBytes;
+	int y = this->Current.UploadedRows;
+	int height = rows * texelRowsPerRow < levelHeight - y ? rows * texelRowsPerRow : levelHeight - y;
+
+	// orphaning hands us fresh storage even if the GPU is still reading the last band out of this buffer
+	glState.BindTexture(0, texture.Target, this->Current.TextureId);
+	glState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, this->UploadBufferIds[this->NextUploadBuffer]);
+	this->NextUploadBuffer = (this->NextUploadBuffer + 1) % TEXTURE_UPLOAD_BUFFERS;
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	const GLvoid* pixels = (const GLvoid*)0;
+	if (mapped != nullptr) {
+		std::memcpy(mapped, source, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else {
+		// the driver wouldn't map it; upload straight from the chain or the mapping instead
+		glState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		pixels = source;
+	}
+
+	// levels above FirstLevel aren't in the texture, so the chain's levels shift down
+	GLint glLevel = (GLint)(this->Current.Level - this->Current.FirstLevel);
+	if (this->Current.File) {
+		GLenum internalFormat = this->Current.File->GetHeader().InternalFormat;
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, glLevel, 0, y, levelWidth, height, internalFormat, (GLsizei)bytes, pixels);
+	}
+	else if (this->Current.Layer != -1) {
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, glLevel, 0, y, this->Current.Layer, levelWidth, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	else {
+		glTexSubImage2D(GL_TEXTURE_2D, glLevel, 0, y, levelWidth, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	glState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	this->Current.UploadedRows += height;
+	if (this->Current.UploadedRows < levelHeight) {
+		return false;
+	}
+	this->Current.UploadedRows = 0;
+	return true;
+}
+
+void TextureLoader::Bind(GLuint unit, Handle texture)
+{
+	Texture& entry = this->Textures[texture];
+	if (entry.Target == GL_TEXTURE_2D_ARRAY) {
+		entry.LastUsed = this->Frame;
+		glState.BindTexture(unit, GL_TEXTURE_2D_ARRAY, entry.TextureId);
+		return;
+	}
+
+	Texture& storage = this->Textures[entry.Storage];
+	storage.LastUsed = this->Frame;
+	if (storage.TextureId == 0 && !storage.Loading && !storage.Failed) {
+		// evicted outright; the placeholder stands in until it's back
+		this->Request(entry.Storage);
+		this->CacheStats.Reloads++;
+	}
+	glState.BindTexture(unit, GL_TEXTURE_2D, storage.TextureId != 0 ? storage.TextureId : this->PlaceholderId);
+}
+
+void TextureLoader::RequestDetail(Handle texture, GLfloat screenSize)
+{
+	Texture& entry = this->Textures[this->Textures[texture].Storage];
+	entry.Streamed = GL_TRUE;
+	entry.ScreenSize = std::max(entry.ScreenSize, screenSize);
+}
+
+bool TextureLoader::IsResident(Handle texture)
+{
+	const Texture& entry = this->Textures[texture];
+	if (entry.Target == GL_TEXTURE_2D_ARRAY) {
+		return entry.LayersPending == 0;
+	}
+	return this->Textures[entry.Storage].TextureId != 0;
+}
+
+GLuint TextureLoader::GetPendingCount()
+{
+	GLuint pending = 0;
+	for (const Texture& texture : this->Textures) {
+		if (texture.RefCount > 0 && (texture.Loading || texture.LayersPending > 0)) {
+			pending++;
+		}
+	}
+	return pending;
+}
+
+GLuint TextureLoader::GetWorkerCount()
+{
+	return (GLuint)this->Workers.size();
+}
+
+void TextureLoader::SetBudget(GLuint64 bytes)
+{
+	this->Budget = bytes;
+}
+
+TextureLoader::Stats TextureLoader::GetStats()
+{
+	Stats stats = this->CacheStats;
+	stats.ResidentBytes = 0;
+	for (const Texture& texture : this->Textures) {
+		if (texture.RefCount > 0) {
+			stats.ResidentBytes += texture.Bytes;
+		}
+	}
+	stats.Budget = this->Budget;
+	return stats;
+}
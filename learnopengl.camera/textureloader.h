@@ -0,0 +1,260 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mipchain.h"
+#include "texturefile.h"
+
+// bytes copied through a pixel buffer per upload step; big images go up in bands of rows about this size
+const GLsizeiptr TEXTURE_UPLOAD_CHUNK = 1024 * 1024;
+// pixel buffers cycled between steps, so filling one never waits on the transfer out of the last
+const GLuint TEXTURE_UPLOAD_BUFFERS = 3;
+// how the workers build mip chains; they're cached in MIP_CACHE_DIR, so the cost is paid once per image
+const MipFilter TEXTURE_MIP_FILTER = MIP_FILTER_KAISER;
+// over budget, eviction drops a texture's top levels while its new top would be at least this many texels a side,
+// and only unloads it outright once everything is that small
+const GLuint TEXTURE_EVICT_MIN_SIZE = 32;
+// a streamed texture that hasn't been on screen yet starts with its top level no bigger than this
+const GLuint TEXTURE_STREAM_INITIAL_SIZE = 64;
+// streamed textures only give detail back once their footprint needs this many levels fewer, so one hovering at a
+// level boundary doesn't stream the same level in and out
+const GLuint TEXTURE_STREAM_OUT_LEVELS = 2;
+// frames a level streamed in takes to fade in through GL_TEXTURE_MIN_LOD, rather than popping
+const GLuint TEXTURE_STREAM_FADE_FRAMES = 8;
+
+// decodes image files and builds their mip chains on a pool of worker threads, then uploads them on the GL thread a
+// little at a time, through pixel buffer objects. a texture can be bound as soon as Load returns; until it's
+// resident, Bind binds a placeholder.
+// where a texture file (written by texconvert) sits next to the image, its block-compressed levels are used instead.
+// either comes from the asset bundle if it's there, the image as the chain assetcook filtered from it.
+// handles are reference counted and shared: loading a path again, or a file with the same content, gives the same
+// texture. with a budget set, the least recently bound textures lose their top levels, then go entirely, until what's
+// resident fits; a texture unloaded that way comes back the next time it's bound.
+// levels go up smallest first and a texture is drawn from as soon as its smallest is, GL_TEXTURE_BASE_LEVEL following
+// the finest level up so far. textures given a footprint with RequestDetail are streamed: they get just the levels
+// that footprint needs, sharper ones streamed in as it grows (within the budget) and dropped as it shrinks
+class TextureLoader
+{
+public:
+	typedef GLuint Handle;
+
+	struct Stats
+	{
+		// Loads answered by a texture already loaded from the same path, by one with the same content, or by neither
+		GLuint PathHits;
+		GLuint ContentHits;
+		GLuint Misses;
+		// top levels dropped, textures unloaded outright, and unloaded textures brought back by a Bind
+		GLuint LevelsEvicted;
+		GLuint Unloads;
+		GLuint Reloads;
+		// streamed textures given sharper levels, and given blurrier ones, for their footprint
+		GLuint StreamIns;
+		GLuint StreamOuts;
+		// every texture's levels, arrays included; 0 budget means unlimited
+		GLuint64 ResidentBytes;
+		GLuint64 Budget;
+	};
+
+	// workerCount 0 means one per core, less the one rendering
+	TextureLoader(GLuint workerCount = 0);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// queues path for decoding, or the .ctex beside it for mapping; once uploaded the texture has every mip level
+	// and gets wrapType and filterType. srgb says the image holds color rather than data, for filtering its mips.
+	// the same path with the same settings gives back the handle it gave last time, with one more reference
+	Handle Load(const char* path, GLenum wrapType, GLenum filterType, bool srgb = true);
+	// drops a reference from Load or CreateArray; the last one frees the texture and the handle may be reused
+	void Release(Handle texture);
+
+	// a GL_TEXTURE_2D_ARRAY of layerCount RGBA8 layers, size texels square with every mip level. images loaded into
+	// it are resized to fit, so objects with different textures share one bind, and one draw if each picks its
+	// layer; layers are grey until their image is resident
+	Handle CreateArray(GLuint size, GLuint layerCount, GLenum wrapType, GLenum filterType);
+	// queues path for the next free layer of array and returns that layer, or -1 if the array is full. texture files
+	// can't be resized, so only the image itself is read
+	GLint LoadLayer(Handle array, const char* path, bool srgb = true);
+
+	// uploads decoded images until budget seconds have passed, always making at least one step; call once a frame
+	// on the GL thread. returns how many textures became resident
+	GLuint Update(GLdouble budget);
+
+	// binds the texture to unit, or the placeholder while it's still loading (or failed to); arrays are always bound
+	void Bind(GLuint unit, Handle texture);
+	// for arrays, whether every layer loaded so far is
+	bool IsResident(Handle texture);
+	// the most pixels across the texture covers on screen this frame, for each object it's drawn on; call every frame
+	// it's drawn. once asked, a texture is streamed, and keeps the detail it has in frames nobody asks
+	void RequestDetail(Handle texture, GLfloat screenSize);
+	// textures still decoding or uploading
+	GLuint GetPendingCount();
+	GLuint GetWorkerCount();
+
+	// bytes of texture the loader may keep resident; 0, the default, for no limit
+	void SetBudget(GLuint64 bytes);
+	Stats GetStats();
+
+private:
+	struct Texture
+	{
+		std::string Path;
+		GLenum WrapType;
+		GLenum FilterType;
+		bool Srgb;
+		// GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for CreateArray's
+		GLenum Target;
+		// 0 until the first upload lands or after an unload; replaced whenever a reload lands
+		GLuint TextureId;
+		// arrays only: the array being rebuilt at RequestedLevel, which replaces TextureId once every layer is up
+		GLuint PendingId;
+		GLboolean Failed;
+		// a request is with the workers or being uploaded
+		GLboolean Loading;
+		std::chrono::steady_clock::time_point QueuedTime;
+
+		// holders of the handle; a content duplicate is also one of its storage's holders
+		GLuint RefCount;
+		// bumped whenever work in flight for the entry is abandoned, so it's dropped when it turns up
+		GLuint Generation;
+		// the entry whose texture this one shows: itself, or an earlier texture with the same content
+		Handle Storage;
+		GLuint64 ContentKey;
+
+		// 2D textures: the full chain's top size and bytes per level, which chain level is uploaded as GL level 0 and
+		// which one the request in flight starts from, the resident bytes, and the frame the texture was last bound
+		GLuint Width;
+		GLuint Height;
+		std::vector<GLuint64> LevelBytes;
+		GLuint FirstLevel;
+		GLuint RequestedLevel;
+		GLuint64 Bytes;
+		GLuint64 LastUsed;
+		// the chain level GL_TEXTURE_BASE_LEVEL points at, and GL_TEXTURE_MIN_LOD above it while sharper levels fade in
+		GLuint VisibleLevel;
+		GLfloat MinLod;
+
+		// RequestDetail has been called for it; the largest screen size asked for since the last Update, and the one
+		// before that
+		GLboolean Streamed;
+		GLfloat ScreenSize;
+		GLfloat Footprint;
+
+		// arrays only: the side of every layer, how many layers there are, and how many are taken and still loading
+		GLuint Size;
+		GLuint LayerCount;
+		GLuint LayersUsed;
+		GLuint LayersPending;
+		// what each layer was loaded from, to load it again into a rebuilt array
+		std::vector<std::string> LayerPaths;
+		std::vector<bool> LayerSrgb;
+	};
+
+	struct Job
+	{
+		Handle Texture;
+		GLuint Generation;
+		std::string Path;
+		bool Srgb;
+		// the array layer to fill and the size to resize to, or -1 and 0 for a texture of its own
+		GLint Layer;
+		GLuint Size;
+	};
+
+	// an image off a worker, and how far its upload has got: either an RGBA8 mip chain (generated, or mapped from the
+	// mip cache) or a mapped texture file, neither if loading failed
+	struct Decoded
+	{
+		Handle Texture;
+		GLuint Generation;
+		std::string Path;
+		GLint Layer;
+		// the texture (fresh for 2D ones) the levels go into, and which chain level becomes GL level 0
+		GLuint TextureId;
+		GLuint FirstLevel;
+		GLuint64 ContentKey;
+		std::shared_ptr<MipChain> Mips;
+		GLboolean MipsCached;
+		GLboolean MipsCooked;
+		std::shared_ptr<TextureFile> File;
+		int Width;
+		int Height;
+		// 2D textures take over from what was there once they're as sharp, see ShowLevel
+		GLboolean Swapped;
+		GLuint Level;
+		int UploadedRows;
+		GLdouble DecodeTime;
+	};
+
+	// touched only on the GL thread
+	std::vector<Texture> Textures;
+	// entries of released textures, reused before the list grows
+	std::vector<Handle> FreeHandles;
+	// live 2D textures by path and settings, see GetPathKey
+	std::map<std::string, Handle> ByPath;
+	GLuint64 Budget;
+	GLuint64 Frame;
+	Stats CacheStats;
+	GLuint PlaceholderId;
+	GLuint UploadBufferIds[TEXTURE_UPLOAD_BUFFERS];
+	GLuint NextUploadBuffer;
+	// the image being uploaded, if Uploading
+	Decoded Current;
+	GLboolean Uploading;
+
+	// paths waiting for a worker, and images waiting for the GL thread
+	std::mutex JobMutex;
+	std::condition_variable JobReady;
+	std::deque<Job> Jobs;
+	std::mutex DecodedMutex;
+	std::deque<Decoded> DecodedImages;
+	bool Stopping;
+	std::vector<std::thread> Workers;
+
+	// a fresh entry, or a released one with its generation moved on
+	Handle AddTexture(const Texture& texture);
+	// queues worker jobs for the entry's image (or every layer of an array) from its RequestedLevel down, into a new
+	// texture that replaces the one there
+	void Request(Handle handle);
+	// a grey array of the entry's layers, from chain level firstLevel down
+	GLuint AllocateArray(const Texture& texture, GLuint firstLevel);
+	// frees the entry's texture but keeps the entry, so a Bind can bring it back
+	void Unload(Handle handle);
+	// points the entry at a live texture with the same content and sampling, if there is one
+	bool ShareStorage(Handle handle, GLuint64 contentKey);
+	// what's resident once every request in flight lands, since those already count towards the budget
+	GLuint64 GetCommittedBytes();
+	// drops least recently used levels and textures until the resident bytes fit the budget
+	void Evict();
+	// requests levels for each streamed texture's footprint, and fades in the ones that have landed
+	void Stream();
+	// the coarsest of levelCount levels whose side still covers footprint pixels
+	static GLuint GetLevelForFootprint(GLuint width, GLuint height, GLuint levelCount, GLfloat footprint);
+	// stops uploading Current, whose entry has been released or asked for something else
+	void AbandonUpload();
+	static std::string GetPathKey(const char* path, GLenum wrapType, GLenum filterType, bool srgb);
+
+	void Work();
+	// fills in decoded's Mips from the asset bundle or the mip cache, or by decoding job's image and filtering it down
+	void DecodeMips(const Job& job, Decoded& decoded);
+	// copies the next band of rows of Current's current level; true once the level is up
+	bool UploadStep();
+	// puts a 2D texture's newly uploaded level in use, swapping the new texture in if it's time
+	void ShowLevel();
+	// counts a layer off its array's pending ones; the last of a rebuild swaps the new array in
+	void FinishLayer(Texture& texture);
+	// allocates every level of Current's texture ahead of its bands
+	void AllocateStorage(const Texture& texture);
+};
@@ -0,0 +1,13 @@
+// blends two layers of the bound texture array; shared by every fragment shader that samples them
+
+uniform sampler2DArray ourTextures;
+uniform float mixValue;
+
+// layers.x is the base, layers.y the layer laid over it at mixValue opacity. textures come premultiplied by alpha,
+// so where the overlay is transparent the base shows through untouched
+vec4 MixTextures(vec2 texCoord, vec2 layers)
+{
+	vec4 base = texture(ourTextures, vec3(texCoord, layers.x));
+	vec4 overlay = texture(ourTextures, vec3(texCoord, layers.y)) * mixValue;
+	return base * (1.0f - overlay.a) + overlay;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "glstate.h"
+#include "streambuffer.h"
+
+// std140 base alignment and size of the types we put in uniform blocks
+template <typename T> struct Std140;
+template <> struct Std140<GLfloat>		{ static const size_t Alignment = 4;	static const size_t Size = 4; };
+template <> struct Std140<GLint>		{ static const size_t Alignment = 4;	static const size_t Size = 4; };
+template <> struct Std140<GLuint>		{ static const size_t Alignment = 4;	static const size_t Size = 4; };
+template <> struct Std140<glm::vec2>	{ static const size_t Alignment = 8;	static const size_t Size = 8; };
+template <> struct Std140<glm::vec3>	{ static const size_t Alignment = 16;	static const size_t Size = 12; };
+template <> struct Std140<glm::vec4>	{ static const size_t Alignment = 16;	static const size_t Size = 16; };
+template <> struct Std140<glm::mat4>	{ static const size_t Alignment = 16;	static const size_t Size = 64; };
+
+constexpr size_t Std140AlignUp(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// where std140 places Member given the member declared before it
+template <typename Member, typename Previous>
+constexpr size_t Std140NextOffset(size_t previousOffset)
+{
+	return Std140AlignUp(previousOffset + Std140<Previous>::Size, Std140<Member>::Alignment);
+}
+
+// compile-time checks that a C++ struct matches the std140 layout of the GLSL block it mirrors.
+// list every member in declaration order: STD140_FIRST, then STD140_NEXT for each following
+// member, then STD140_END with the last one
+#define STD140_FIRST(Struct, Member) \
+	static_assert(offsetof(Struct, Member) == 0, #Struct "::" #Member " must be the first member")
+#define STD140_NEXT(Struct, Previous, Member) \
+	static_assert(offsetof(Struct, Member) == \
+		Std140NextOffset<decltype(Struct::Member), decltype(Struct::Previous)>(offsetof(Struct, Previous)), \
+		#Struct "::" #Member " is not at its std140 offset")
+#define STD140_END(Struct, Last) \
+	static_assert(sizeof(Struct) == Std140AlignUp(offsetof(Struct, Last) + Std140<decltype(Struct::Last)>::Size, 16), \
+		#Struct " is not padded to its std140 size")
+
+// one uniform buffer bound to a fixed binding point, written in a single call per update
+template <typename T>
+class UniformBuffer
+{
+public:
+	UniformBuffer(GLuint bindingPoint)
+		: BindingPoint(bindingPoint)
+	{
+		glGenBuffers(1, &this->BufferId);
+		glState.BindBuffer(GL_UNIFORM_BUFFER, this->BufferId);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, this->BufferId);
+	}
+
+	void Update(const T& data)
+	{
+		glState.BindBuffer(GL_UNIFORM_BUFFER, this->BufferId);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+		// a streamed update may have pointed the binding elsewhere
+		glBindBufferBase(GL_UNIFORM_BUFFER, this->BindingPoint, this->BufferId);
+	}
+
+	// writes the block into this frame's region of the stream instead, so the write never waits on
+	// draws still reading an older copy; falls back to our own buffer if the stream is full
+	void Update(const T& data, StreamBuffer& stream)
+	{
+		StreamBuffer::Allocation allocation = stream.Allocate(sizeof(T), StreamBuffer::GetUniformAlignment());
+		if (allocation.Pointer == nullptr) {
+			this->Update(data);
+			return;
+		}
+
+		std::memcpy(allocation.Pointer, &data, sizeof(T));
+		glBindBufferRange(GL_UNIFORM_BUFFER, this->BindingPoint, stream.GetBufferId(), allocation.Offset, sizeof(T));
+	}
+
+	GLuint GetBindingPoint()
+	{
+		return this->BindingPoint;
+	}
+
+private:
+	GLuint BufferId;
+	GLuint BindingPoint;
+};
+
+// mirrors the PerFrame block in perframe.glsl
+const char* const PER_FRAME_UNIFORM_BLOCK = "PerFrame";
+const GLuint PER_FRAME_UNIFORM_BINDING = 0;
+
+struct PerFrameUniforms
+{
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::vec3 CameraPosition;
+	GLfloat Time;
+};
+
+STD140_FIRST(PerFrameUniforms, View);
+STD140_NEXT(PerFrameUniforms, View, Projection);
+STD140_NEXT(PerFrameUniforms, Projection, CameraPosition);
+STD140_NEXT(PerFrameUniforms, CameraPosition, Time);
+STD140_END(PerFrameUniforms, Time);
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mesh.h"
+
+// what an attribute means; the value is the attribute location every shader uses for it
+enum VertexSemantic {
+	POSITION = 0,
+	COLOR = 1,
+	TEXCOORD = 2,
+	NORMAL = 3,
+	// per-instance; the model matrix takes locations 4 to 7
+	INSTANCE_MODEL = 4,
+	INSTANCE_TINT = 8,
+	INSTANCE_SPIN = 9,
+	INSTANCE_LAYERS = 10
+};
+
+// where a semantic lives in an IndexedMesh's interleaved float vertices
+struct VertexSource
+{
+	VertexSemantic Semantic;
+	GLuint Offset;
+	GLuint Components;
+};
+
+// one attribute as plain data, for code that can't see a layout's type: file formats, validation
+struct VertexAttributeDesc
+{
+	GLuint Semantic;
+	GLint Components;
+	GLenum Type;
+	GLuint Normalized;
+	GLuint Offset;
+};
+
+// float to IEEE half, round to nearest even; overflow becomes infinity
+inline GLushort FloatToHalf(GLfloat value)
+{
+	GLuint bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	GLuint sign = (bits >> 16) & 0x8000;
+	GLint exponent = (GLint)((bits >> 23) & 0xFF) - 127 + 15;
+	GLuint mantissa = bits & 0x7FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF) {
+		return (GLushort)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+	if (exponent >= 31) {
+		return (GLushort)(sign | 0x7C00);
+	}
+	if (exponent <= 0) {
+		// denormal half, or zero if it's too small for even that
+		if (exponent < -10) {
+			return (GLushort)sign;
+		}
+		mantissa |= 0x800000;
+		GLuint shift = 14 - exponent;
+		GLuint half = mantissa >> shift;
+		GLuint remainder = mantissa & ((1u << shift) - 1);
+		GLuint midpoint = 1u << (shift - 1);
+		if (remainder > midpoint || (remainder == midpoint && (half & 1))) {
+			half++;
+		}
+		return (GLushort)(sign | half);
+	}
+
+	// a carry out of the mantissa correctly bumps the exponent
+	GLuint half = sign | ((GLuint)exponent << 10) | (mantissa >> 13);
+	GLuint remainder = mantissa & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+		half++;
+	}
+	return (GLushort)half;
+}
+
+inline GLfloat ClampUnit(GLfloat value, GLfloat low)
+{
+	return value < low ? low : (value > 1.0f ? 1.0f : value);
+}
+
+// per component type: its size in bytes and how to encode floats into it.
+// missing source components take GL's defaults of (0, 0, 0, 1)
+template <GLenum Type> struct VertexComponent;
+
+template <> struct VertexComponent<GL_FLOAT>
+{
+	static const GLsizei Size = 4;
+	static void Encode(GLfloat value, unsigned char* out) { std::memcpy(out, &value, Size); }
+};
+
+template <> struct VertexComponent<GL_HALF_FLOAT>
+{
+	static const GLsizei Size = 2;
+	static void Encode(GLfloat value, unsigned char* out) { GLushort half = FloatToHalf(value); std::memcpy(out, &half, Size); }
+};
+
+// snorm16; sources must already be in [-1, 1]
+template <> struct VertexComponent<GL_SHORT>
+{
+	static const GLsizei Size = 2;
+	static void Encode(GLfloat value, unsigned char* out) { GLshort snorm = (GLshort)std::lround(ClampUnit(value, -1.0f) * 32767.0f); std::memcpy(out, &snorm, Size); }
+};
+
+// unorm16; sources must already be in [0, 1], so tiled texcoords need a float format
+template <> struct VertexComponent<GL_UNSIGNED_SHORT>
+{
+	static const GLsizei Size = 2;
+	static void Encode(GLfloat value, unsigned char* out) { GLushort unorm = (GLushort)std::lround(ClampUnit(value, 0.0f) * 65535.0f); std::memcpy(out, &unorm, Size); }
+};
+
+// unorm8
+template <> struct VertexComponent<GL_UNSIGNED_BYTE>
+{
+	static const GLsizei Size = 1;
+	static void Encode(GLfloat value, unsigned char* out) { *out = (unsigned char)std::lround(ClampUnit(value, 0.0f) * 255.0f); }
+};
+
+// one attribute of a layout. packed 10_10_10_2 normals are always four components in four bytes
+template <VertexSemantic Semantic, GLint Components, GLenum Type, GLboolean Normalized = GL_FALSE>
+struct VertexAttribute
+{
+	// every attribute starts 4-byte aligned, as drivers prefer
+	static const GLsizei Size = (Components * VertexComponent<Type>::Size + 3) / 4 * 4;
+
+	static void Apply(GLsizei stride, size_t offset, GLuint divisor)
+	{
+		glVertexAttribPointer(Semantic, Components, Type, Normalized, stride, (GLvoid*)offset);
+		glEnableVertexAttribArray(Semantic);
+		if (divisor != 0) {
+			glVertexAttribDivisor(Semantic, divisor);
+		}
+	}
+
+	static void Describe(std::vector<VertexAttributeDesc>& out, GLuint offset)
+	{
+		VertexAttributeDesc desc = { Semantic, Components, Type, Normalized, offset };
+		out.push_back(desc);
+	}
+
+	static void Pack(const GLfloat* source, const VertexSource& from, unsigned char* out)
+	{
+		std::memset(out, 0, Size);
+		for (GLint c = 0; c < Components; c++) {
+			GLfloat value = c < (GLint)from.Components ? source[from.Offset + c] : (c == 3 ? 1.0f : 0.0f);
+			VertexComponent<Type>::Encode(value, out + c * VertexComponent<Type>::Size);
+		}
+	}
+};
+
+template <VertexSemantic Semantic>
+struct VertexAttribute<Semantic, 4, GL_INT_2_10_10_10_REV, GL_TRUE>
+{
+	static const GLsizei Size = 4;
+
+	static void Apply(GLsizei stride, size_t offset, GLuint divisor)
+	{
+		glVertexAttribPointer(Semantic, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (GLvoid*)offset);
+		glEnableVertexAttribArray(Semantic);
+		if (divisor != 0) {
+			glVertexAttribDivisor(Semantic, divisor);
+		}
+	}
+
+	static void Describe(std::vector<VertexAttributeDesc>& out, GLuint offset)
+	{
+		VertexAttributeDesc desc = { Semantic, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset };
+		out.push_back(desc);
+	}
+
+	static void Pack(const GLfloat* source, const VertexSource& from, unsigned char* out)
+	{
+		GLuint packed = 0;
+		for (GLuint c = 0; c < 3; c++) {
+			GLint snorm = c < from.Components ? (GLint)std::lround(ClampUnit(source[from.Offset + c], -1.0f) * 511.0f) : 0;
+			packed |= ((GLuint)snorm & 0x3FF) << (c * 10);
+		}
+		// w is a 2-bit snorm; 1 is the only useful value for a direction
+		packed |= 1u << 30;
+		std::memcpy(out, &packed, sizeof(packed));
+	}
+};
+
+// a float mat4, one column per location starting at Semantic
+template <VertexSemantic Semantic>
+struct MatrixAttribute
+{
+	static const GLsizei Size = 16 * sizeof(GLfloat);
+
+	static void Apply(GLsizei stride, size_t offset, GLuint divisor)
+	{
+		for (GLuint column = 0; column < 4; column++) {
+			glVertexAttribPointer(Semantic + column, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + column * 4 * sizeof(GLfloat)));
+			glEnableVertexAttribArray(Semantic + column);
+			if (divisor != 0) {
+				glVertexAttribDivisor(Semantic + column, divisor);
+			}
+		}
+	}
+
+	static void Describe(std::vector<VertexAttributeDesc>& out, GLuint offset)
+	{
+		VertexAttributeDesc desc = { Semantic, 16, GL_FLOAT, GL_FALSE, offset };
+		out.push_back(desc);
+	}
+
+	static void Pack(const GLfloat* source, const VertexSource& from, unsigned char* out)
+	{
+		std::memset(out, 0, Size);
+		std::memcpy(out, source + from.Offset, (from.Components < 16 ? from.Components : 16) * sizeof(GLfloat));
+	}
+};
+
+// an interleaved vertex format; strides and offsets all come from the attribute list at compile time
+template <typename... Attributes> struct VertexLayout;
+
+template <> struct VertexLayout<>
+{
+	static const GLsizei Stride = 0;
+	static void ApplyFrom(GLsizei, size_t, GLuint) {}
+	static void DescribeFrom(std::vector<VertexAttributeDesc>&, GLuint) {}
+	static bool PackFrom(const GLfloat*, const std::vector<VertexSource>&, unsigned char*) { return true; }
+};
+
+template <typename First, typename... Rest>
+struct VertexLayout<First, Rest...>
+{
+	static const GLsizei Stride = First::Size + VertexLayout<Rest...>::Stride;
+
+	// sets up every attribute on the bound VAO, reading from the bound GL_ARRAY_BUFFER.
+	// a non-zero divisor makes them per-instance attributes instead
+	static void Apply(GLuint divisor = 0)
+	{
+		ApplyFrom(Stride, 0, divisor);
+	}
+
+	// the layout as plain data, in declaration order
+	static std::vector<VertexAttributeDesc> Describe()
+	{
+		std::vector<VertexAttributeDesc> attributes;
+		DescribeFrom(attributes, 0);
+		return attributes;
+	}
+
+	// converts an IndexedMesh's float vertices into this layout; fails if a semantic has no source
+	static bool Pack(const IndexedMesh& mesh, const std::vector<VertexSource>& sources, std::vector<unsigned char>& packed)
+	{
+		packed.resize((size_t)mesh.GetVertexCount() * Stride);
+		for (GLuint v = 0; v < mesh.GetVertexCount(); v++) {
+			if (!PackFrom(&mesh.Vertices[v * mesh.FloatsPerVertex], sources, &packed[(size_t)v * Stride])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static void ApplyFrom(GLsizei stride, size_t offset, GLuint divisor)
+	{
+		First::Apply(stride, offset, divisor);
+		VertexLayout<Rest...>::ApplyFrom(stride, offset + First::Size, divisor);
+	}
+
+	static void DescribeFrom(std::vector<VertexAttributeDesc>& out, GLuint offset)
+	{
+		First::Describe(out, offset);
+		VertexLayout<Rest...>::DescribeFrom(out, offset + First::Size);
+	}
+
+	static bool PackFrom(const GLfloat* source, const std::vector<VertexSource>& sources, unsigned char* out)
+	{
+		for (const VertexSource& from : sources) {
+			if (from.Semantic == SemanticOf((First*)nullptr)) {
+				First::Pack(source, from, out);
+				return VertexLayout<Rest...>::PackFrom(source, sources, out + First::Size);
+			}
+		}
+		return false;
+	}
+
+private:
+	template <VertexSemantic Semantic, GLint Components, GLenum Type, GLboolean Normalized>
+	static VertexSemantic SemanticOf(VertexAttribute<Semantic, Components, Type, Normalized>*) { return Semantic; }
+
+	template <VertexSemantic Semantic>
+	static VertexSemantic SemanticOf(MatrixAttribute<Semantic>*) { return Semantic; }
+};
+
+// the layouts our primitives use. the float ones match the literal vertex arrays in main.cpp;
+// the packed ones are what we actually upload
+typedef VertexLayout<
+	VertexAttribute<POSITION, 3, GL_FLOAT>,
+	VertexAttribute<COLOR, 3, GL_FLOAT>> ColoredVertex;
+
+typedef VertexLayout<
+	VertexAttribute<POSITION, 4, GL_HALF_FLOAT>,
+	VertexAttribute<TEXCOORD, 2, GL_UNSIGNED_SHORT, GL_TRUE>> PackedTexturedVertex;
+
+typedef VertexLayout<
+	VertexAttribute<POSITION, 4, GL_HALF_FLOAT>,
+	VertexAttribute<COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE>,
+	VertexAttribute<TEXCOORD, 2, GL_UNSIGNED_SHORT, GL_TRUE>> PackedColoredTexturedVertex;
+
+typedef VertexLayout<
+	VertexAttribute<POSITION, 4, GL_HALF_FLOAT>,
+	VertexAttribute<NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE>,
+	VertexAttribute<TEXCOORD, 2, GL_UNSIGNED_SHORT, GL_TRUE>> PackedLitVertex;
+
+static_assert(PackedTexturedVertex::Stride == 12, "packed textured vertices should be 12 bytes");
+static_assert(PackedColoredTexturedVertex::Stride == 16, "packed colored textured vertices should be 16 bytes");
+static_assert(PackedLitVertex::Stride == 16, "packed lit vertices should be 16 bytes");
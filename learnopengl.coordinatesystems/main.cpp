@@ -138,15 +138,15 @@ int main()
 		
 
 		// set uniform mix value
-		glUniform1f(glGetUniformLocation(shader.GetProgramId(), "mixValue"), mixValue);
+		shader.Set(UNIFORM("mixValue"), mixValue);
 
 		// setup multiple textures
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, containerTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture0"), 0);
+		shader.Set(UNIFORM("ourTexture0"), 0);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, awesomefaceTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture1"), 1);
+		shader.Set(UNIFORM("ourTexture1"), 1);
 
 		// setup cube positions
 		glm::vec3 cubePositions[] = {
@@ -170,8 +170,8 @@ int main()
 		glm::mat4 projectionTransform;
 		projectionTransform = glm::perspective(glm::radians(45.0f), (GLfloat)width/height, 0.1f, 100.0f);
 
-		glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "view"), 1, GL_FALSE, glm::value_ptr(viewTransform));
-		glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "projection"), 1, GL_FALSE, glm::value_ptr(projectionTransform));
+		shader.Set(UNIFORM("view"), viewTransform);
+		shader.Set(UNIFORM("projection"), projectionTransform);
 
 		// custom draw iteration for each position
 		glBindVertexArray(cubeAId);
@@ -185,7 +185,7 @@ int main()
 			else {
 				modelTransform = glm::rotate(modelTransform, angle, glm::vec3(1.0f, 0.3f, 0.5f));
 			}
-			glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "model"), 1, GL_FALSE, glm::value_ptr(modelTransform));
+			shader.Set(UNIFORM("model"), modelTransform);
 
 			glDrawArrays(GL_TRIANGLES, 0, 36);
 		}
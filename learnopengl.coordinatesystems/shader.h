@@ -4,8 +4,20 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <type_traits>
 
 #include <GL\glew.h>
+#include <glm/glm.hpp>
+
+// FNV-1a hash of a uniform name. constexpr, but only worked out at compile time where a constant is needed, see UNIFORM
+constexpr GLuint HashUniformName(const char* name, GLuint hash = 2166136261u)
+{
+	return *name == '\0' ? hash : HashUniformName(name + 1, (hash ^ (GLuint)(unsigned char)*name) * 16777619u);
+}
+
+// the hash of a literal uniform name as a compile-time constant, for the GLuint Set overloads
+#define UNIFORM(name) (std::integral_constant<GLuint, HashUniformName(name)>::value)
 
 class Shader
 {
@@ -18,10 +30,38 @@ public:
 
 	GLuint GetProgramId();
 
+	// typed uniform setters; the GL call is skipped when the value hasn't changed. these hash name on every call, so
+	// per-frame code passes UNIFORM("name") instead
+	void Set(const char* name, const glm::mat4& value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, const glm::vec3& value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, GLfloat value) { this->Set(HashUniformName(name), value); }
+	void Set(const char* name, GLint value) { this->Set(HashUniformName(name), value); }
+
+	void Set(GLuint nameHash, const glm::mat4& value);
+	void Set(GLuint nameHash, const glm::vec3& value);
+	void Set(GLuint nameHash, GLfloat value);
+	void Set(GLuint nameHash, GLint value);
+
+	// returns -1 if the uniform isn't active in the program
+	GLint GetUniformLocation(const char* name);
+
 private:
+	// an active uniform resolved at link time plus the last value we uploaded to it
+	struct Uniform
+	{
+		GLint Location;
+		GLenum Type;
+		GLboolean HasValue;
+		GLfloat Value[16];
+	};
+
 	GLuint ProgramId;
+	std::unordered_map<GLuint, Uniform> Uniforms;
+
 	void CreateShader(GLuint* id, const char* shader, GLenum type);
 	void CreateShaderProgram(GLuint* id, GLuint vertexShaderId, GLuint fragmentShaderId);
 	void CheckForShaderErrors(GLuint shaderId);
 	void CheckForProgramErrors(GLuint programId);
-};
\ No newline at end of file
+	void CacheUniformLocations();
+	Uniform* FindDirtyUniform(GLuint nameHash, const void* value, size_t size);
+};
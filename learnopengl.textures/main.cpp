@@ -82,15 +82,15 @@ int main()
 
 		shader.Use();
 		// set uniform mix value
-		glUniform1f(glGetUniformLocation(shader.GetProgramId(), "mixValue"), mixValue);
+		shader.Set(UNIFORM("mixValue"), mixValue);
 
 		// setup multiple textures
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, containerTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture0"), 0);
+		shader.Set(UNIFORM("ourTexture0"), 0);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, awesomefaceTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture1"), 1);
+		shader.Set(UNIFORM("ourTexture1"), 1);
 
 		DrawRect(&rectAId);
 		glUseProgram(0);
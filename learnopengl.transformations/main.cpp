@@ -87,27 +87,27 @@ int main()
 		
 
 		// set uniform mix value
-		glUniform1f(glGetUniformLocation(shader.GetProgramId(), "mixValue"), mixValue);
+		shader.Set(UNIFORM("mixValue"), mixValue);
 
 		// setup multiple textures
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, containerTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture0"), 0);
+		shader.Set(UNIFORM("ourTexture0"), 0);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, awesomefaceTexId);
-		glUniform1i(glGetUniformLocation(shader.GetProgramId(), "ourTexture1"), 1);
+		shader.Set(UNIFORM("ourTexture1"), 1);
 
 		glm::mat4 rotater;
 		glm::mat4 scaler;
 
 		rotater = glm::translate(rotater, glm::vec3(0.5f, -0.5f, 0.0f));
 		rotater = glm::rotate(rotater, (GLfloat)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.0f, 0.0f, 1.0f)); // last transform added so it's the first transform multiplied against the vector
-		glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "transform"), 1, GL_FALSE, glm::value_ptr(rotater));
+		shader.Set(UNIFORM("transform"), rotater);
 		DrawRect(&rectAId);
 		
 		scaler = glm::translate(scaler, glm::vec3(-0.5f, 0.5f, 0.0f));
 		scaler = glm::scale(scaler, glm::vec3(1.0f, abs(sin((GLfloat)glfwGetTime())), 1.0f));
-		glUniformMatrix4fv(glGetUniformLocation(shader.GetProgramId(), "transform"), 1, GL_FALSE, glm::value_ptr(scaler));
+		shader.Set(UNIFORM("transform"), scaler);
 		DrawRect(&rectAId);
 		glUseProgram(0);
 
@@ -1,5 +1,9 @@
+#include <cstring>
+
 #include "shader.h"
 
+#include <glm/gtc/type_ptr.hpp>
+
 Shader::Shader(const GLchar * vertexShaderPath, const GLchar * fragmentShaderPath)
 {
 	// I would say the constructor shouldn't have IO logic in it, it should just rely on chars
@@ -57,6 +61,9 @@ Shader::Shader(const GLchar * vertexShaderPath, const GLchar * fragmentShaderPat
 	// delete the shaders as they're linked into our program now and no longer necessary
 	glDeleteProgram(vertexShaderId);
 	glDeleteProgram(fragmentShaderId);
+
+	// 4. resolve every active uniform once so we never query the driver by name per frame
+	CacheUniformLocations();
 }
 
 void Shader::Use()
@@ -64,6 +71,49 @@ void Shader::Use()
 	glUseProgram(this->ProgramId);
 }
 
+GLuint Shader::GetProgramId()
+{
+	return this->ProgramId;
+}
+
+void Shader::Set(GLuint nameHash, const glm::mat4& value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, glm::value_ptr(value), 16 * sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniformMatrix4fv(uniform->Location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void Shader::Set(GLuint nameHash, const glm::vec3& value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, glm::value_ptr(value), 3 * sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniform3fv(uniform->Location, 1, glm::value_ptr(value));
+	}
+}
+
+void Shader::Set(GLuint nameHash, GLfloat value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, &value, sizeof(GLfloat));
+	if (uniform != nullptr) {
+		glUniform1f(uniform->Location, value);
+	}
+}
+
+void Shader::Set(GLuint nameHash, GLint value)
+{
+	Uniform* uniform = FindDirtyUniform(nameHash, &value, sizeof(GLint));
+	if (uniform != nullptr) {
+		glUniform1i(uniform->Location, value);
+	}
+}
+
+GLint Shader::GetUniformLocation(const char* name)
+{
+	auto it = this->Uniforms.find(HashUniformName(name));
+	return it == this->Uniforms.end() ? -1 : it->second.Location;
+}
+
 void Shader::CreateShader(GLuint* id, const char* shader, GLenum type)
 {
 	*id = glCreateShader(type);
@@ -102,7 +152,58 @@ void Shader::CheckForProgramErrors(GLuint programId)
 	}
 }
 
-GLuint Shader::GetProgramId()
+void Shader::CacheUniformLocations()
 {
-	return this->ProgramId;
-}
\ No newline at end of file
+	this->Uniforms.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramiv(this->ProgramId, GL_ACTIVE_UNIFORMS, &uniformCount);
+
+	for (GLint i = 0; i < uniformCount; i++) {
+		GLchar name[256];
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(this->ProgramId, i, sizeof(name), &length, &size, &type, name);
+
+		// arrays are reported as "name[0]"; key them by their bare name
+		std::string uniformName(name, length);
+		size_t bracket = uniformName.find('[');
+		if (bracket != std::string::npos) {
+			uniformName.erase(bracket);
+		}
+
+		Uniform uniform;
+		uniform.Location = glGetUniformLocation(this->ProgramId, name);
+		uniform.Type = type;
+		uniform.HasValue = GL_FALSE;
+
+		// uniforms inside blocks have no location; they're not settable this way
+		if (uniform.Location == -1) {
+			continue;
+		}
+
+		GLuint nameHash = HashUniformName(uniformName.c_str());
+		if (!this->Uniforms.insert(std::make_pair(nameHash, uniform)).second) {
+			std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << uniformName << std::endl;
+		}
+	}
+}
+
+Shader::Uniform* Shader::FindDirtyUniform(GLuint nameHash, const void* value, size_t size)
+{
+	auto it = this->Uniforms.find(nameHash);
+	if (it == this->Uniforms.end()) {
+		return nullptr;
+	}
+
+	// uniform values are per-program state, so our shadow copy stays valid across Use() calls
+	Uniform& uniform = it->second;
+	if (uniform.HasValue && std::memcmp(uniform.Value, value, size) == 0) {
+		return nullptr;
+	}
+
+	std::memcpy(uniform.Value, value, size);
+	uniform.HasValue = GL_TRUE;
+	return &uniform;
+}